@@ -0,0 +1,28 @@
+'use strict';
+// Compares `applySync` with an options object literal against a reused `ivm.CallOptions`, which
+// skips parsing the options on every call.
+// Usage: node benchmark/call-options.js [calls]
+const ivm = require('isolated-vm');
+const calls = Number(process.argv[2]) || 2e5;
+
+function bench(name, fn) {
+	for (let ii = 0; ii < 1e4; ++ii) {
+		fn();
+	}
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < calls; ++ii) {
+		fn();
+	}
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / calls).toFixed(1)}ns/call`);
+}
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const fn = context.evalSync('(function(value) { return value; })', { reference: true });
+const callOptions = new ivm.CallOptions({ arguments: { copy: true }, result: { copy: true } });
+for (let ii = 0; ii < 2; ++ii) {
+	bench('options object', () => fn.applySync(undefined, [ 1 ], { arguments: { copy: true }, result: { copy: true } }));
+	bench('CallOptions', () => fn.applySync(undefined, [ 1 ], callOptions));
+}
+isolate.dispose();
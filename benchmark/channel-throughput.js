@@ -0,0 +1,62 @@
+'use strict';
+// Compares streaming small messages from an isolate to the host with `ivm.Channel` against
+// invoking a host `Reference` for each message.
+// Usage: node benchmark/channel-throughput.js [messages]
+const ivm = require('isolated-vm');
+const messages = Number(process.argv[2]) || 1e5;
+
+async function channel() {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	const channel = new ivm.Channel({ capacity: 1024 * 1024 });
+	context.global.setSync('channel', channel);
+	const start = process.hrtime.bigint();
+	const sending = isolate.compileScriptSync(`
+		for (let ii = 0; ii < ${messages}; ++ii) {
+			while (!channel.send(ii));
+		}
+	`).run(context);
+	// Drain whatever is available and only wait when the channel is empty
+	let sum = 0;
+	for (let received = 0; received < messages;) {
+		let value;
+		while ((value = channel.tryReceive()) !== undefined) {
+			sum += value;
+			++received;
+		}
+		if (received < messages) {
+			sum += await channel.receive();
+			++received;
+		}
+	}
+	await sending;
+	const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+	isolate.dispose();
+	return elapsed;
+}
+
+async function reference() {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	let sum = 0;
+	context.global.setSync('receive', new ivm.Reference(value => { sum += value; }));
+	const start = process.hrtime.bigint();
+	await isolate.compileScriptSync(`
+		for (let ii = 0; ii < ${messages}; ++ii) {
+			receive.applyIgnored(undefined, [ ii ]);
+		}
+	`).run(context);
+	while (sum !== messages * (messages - 1) / 2) {
+		await new Promise(resolve => setImmediate(resolve));
+	}
+	const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+	isolate.dispose();
+	return elapsed;
+}
+
+(async function() {
+	for (const [ name, fn ] of [ [ 'channel', channel ], [ 'reference', reference ], [ 'channel', channel ], [ 'reference', reference ] ]) {
+		const elapsed = await fn();
+		console.log(`${name}: ${elapsed.toFixed(1)}ms, ${(elapsed * 1e3 / messages).toFixed(2)}us/message`);
+	}
+})().catch(console.error);
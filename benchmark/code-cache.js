@@ -0,0 +1,53 @@
+'use strict';
+// Compares first-request latency of a fresh isolate given no code cache, a cache produced at
+// compile time, and a cache produced with `createCachedData()` after a warmup request.
+// Usage: node benchmark/code-cache.js [functions]
+const ivm = require('isolated-vm');
+const functions = Number(process.argv[2]) || 5000;
+const iterations = 10;
+
+const code = `${Array(functions).fill().map((_, ii) =>
+	`function fn${ii}(value) { const list = [ value, ${ii} ]; return list.reduce((a, b) => a + b, 0) % 7; }`).join('\n')}
+function request() {
+	let sum = 0;
+	${Array(functions).fill().map((_, ii) => `sum += fn${ii}(${ii});`).join('\n\t')}
+	return sum;
+}`;
+
+function firstRequest(cachedData) {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	const start = process.hrtime.bigint();
+	const script = isolate.compileScriptSync(code, cachedData ? { cachedData } : {});
+	script.runSync(context);
+	context.evalSync('request()');
+	const elapsed = Number(process.hrtime.bigint() - start);
+	if (cachedData && script.cachedDataRejected) {
+		throw new Error('Cached data was rejected');
+	}
+	isolate.dispose();
+	return elapsed;
+}
+
+function bench(name, cachedData) {
+	firstRequest(cachedData);
+	let total = 0;
+	for (let ii = 0; ii < iterations; ++ii) {
+		total += firstRequest(cachedData);
+	}
+	console.log(`${name}: ${(total / iterations / 1e6).toFixed(2)}ms`);
+}
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const script = isolate.compileScriptSync(code, { produceCachedData: true });
+const compileCache = script.cachedData;
+script.runSync(context);
+context.evalSync('request()');
+const warmCache = script.createCachedDataSync();
+console.log(`cache size: compile ${compileCache.copy().byteLength}b, warm ${warmCache.copy().byteLength}b`);
+isolate.dispose();
+
+bench('no cache', undefined);
+bench('compile-time cache', compileCache);
+bench('post-warmup cache', warmCache);
@@ -0,0 +1,27 @@
+'use strict';
+// Measures how fast async results are delivered back to node when many calls finish at once.
+// Usage: node benchmark/completions.js [concurrency]
+const ivm = require('isolated-vm');
+const concurrency = Number(process.argv[2]) || 10000;
+const rounds = 20;
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const fn = context.evalSync('(value => value + 1)', { reference: true });
+
+(async function() {
+	for (let ii = 0; ii < 3; ++ii) {
+		const start = process.hrtime.bigint();
+		for (let jj = 0; jj < rounds; ++jj) {
+			const calls = [];
+			for (let kk = 0; kk < concurrency; ++kk) {
+				calls.push(fn.apply(undefined, [ kk ]));
+			}
+			await Promise.all(calls);
+		}
+		const elapsed = Number(process.hrtime.bigint() - start);
+		const total = concurrency * rounds;
+		console.log(`concurrency=${concurrency}: ${(total / elapsed * 1e9).toFixed(0)} calls/s, ${(elapsed / total).toFixed(0)}ns/call`);
+	}
+	isolate.dispose();
+})().catch(console.error);
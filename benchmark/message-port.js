@@ -0,0 +1,56 @@
+'use strict';
+// Compares pushing a stream of events into an isolate with `MessagePort` against invoking a
+// `Reference` to a handler in the isolate for each event.
+// Usage: node benchmark/message-port.js [events]
+const ivm = require('isolated-vm');
+const events = Number(process.argv[2]) || 1e5;
+
+async function messagePort() {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	const { port1, port2 } = new ivm.MessageChannel();
+	context.global.setSync('port', port2);
+	const done = new Promise(resolve => { port1.onmessage = resolve; });
+	context.evalSync(`
+		let sum = 0;
+		port.onmessage = event => {
+			sum += event.data;
+			if (event.data === ${events - 1}) {
+				port.postMessage(sum);
+			}
+		};
+	`);
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < events; ++ii) {
+		port1.postMessage(ii);
+	}
+	await done;
+	const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+	port1.close();
+	isolate.dispose();
+	return elapsed;
+}
+
+async function reference() {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	const handler = context.evalSync(`
+		let sum = 0;
+		(function(value) { sum += value; })
+	`, { reference: true });
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < events - 1; ++ii) {
+		handler.applyIgnored(undefined, [ ii ]);
+	}
+	await handler.apply(undefined, [ events - 1 ]);
+	const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+	isolate.dispose();
+	return elapsed;
+}
+
+(async function() {
+	for (const [ name, fn ] of [ [ 'messagePort', messagePort ], [ 'reference', reference ], [ 'messagePort', messagePort ], [ 'reference', reference ] ]) {
+		const elapsed = await fn();
+		console.log(`${name}: ${elapsed.toFixed(1)}ms, ${(elapsed * 1e3 / events).toFixed(2)}us/event`);
+	}
+})().catch(console.error);
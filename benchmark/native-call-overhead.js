@@ -0,0 +1,31 @@
+'use strict';
+// Measures the fixed cost of small native calls, which is mostly spent unpacking `this` and
+// arguments rather than doing any work.
+// Usage: node benchmark/native-call-overhead.js [calls]
+const ivm = require('isolated-vm');
+const calls = Number(process.argv[2]) || 2e6;
+
+function bench(name, fn) {
+	for (let ii = 0; ii < 1e5; ++ii) {
+		fn();
+	}
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < calls; ++ii) {
+		fn();
+	}
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / calls).toFixed(1)}ns/call`);
+}
+
+const isolate = new ivm.Isolate;
+const reference = new ivm.Reference({});
+const copy = new ivm.ExternalCopy(new Uint8Array(16));
+const channel = new ivm.Channel;
+for (let ii = 0; ii < 2; ++ii) {
+	bench('channel.tryReceive()', () => channel.tryReceive());
+	bench('lib.hrtime()', () => ivm.lib.hrtime());
+	bench('reference.typeof', () => reference.typeof);
+	bench('isolate.cpuTime', () => isolate.cpuTime);
+	bench('externalCopy.copy()', () => copy.copy());
+}
+isolate.dispose();
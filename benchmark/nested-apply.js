@@ -0,0 +1,33 @@
+'use strict';
+// Measures the round trip of a guest -> host -> guest call, which enters and leaves nested
+// `Executor::Lock`s and pauses the outer CPU timer on every hop.
+// Usage: node benchmark/nested-apply.js [calls]
+const ivm = require('isolated-vm');
+const calls = Number(process.argv[2]) || 2e5;
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const jail = context.global;
+jail.setSync('host', new ivm.Reference(() => 1));
+const run = context.evalSync(`(function run(calls) {
+	let sum = 0;
+	for (let ii = 0; ii < calls; ++ii) {
+		sum += host.applySync();
+	}
+	return sum;
+})`, { reference: true });
+
+function bench(name, fn) {
+	fn(calls / 10);
+	const start = process.hrtime.bigint();
+	fn(calls);
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / calls).toFixed(1)}ns/call`);
+}
+
+for (let ii = 0; ii < 2; ++ii) {
+	bench('host.applySync()', count => run.applySync(undefined, [ count ]));
+	bench('host.applySync() with timeout', count => run.applySync(undefined, [ count ], { timeout: 60e3 }));
+}
+console.log(`cpuTime: ${Number(isolate.cpuTime) / 1e6}ms, wallTime: ${Number(isolate.wallTime) / 1e6}ms`);
+isolate.dispose();
@@ -0,0 +1,39 @@
+'use strict';
+// Compares setting up a context with one awaited call per operation against recording the same
+// operations in a pipeline which runs as a single task.
+// Usage: node benchmark/pipeline.js [iterations]
+const ivm = require('isolated-vm');
+const iterations = Number(process.argv[2]) || 2000;
+const operations = 20;
+
+async function bench(name, fn) {
+	const isolate = new ivm.Isolate;
+	const context = isolate.createContextSync();
+	for (let ii = 0; ii < 100; ++ii) {
+		await fn(isolate, context);
+	}
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < iterations; ++ii) {
+		await fn(isolate, context);
+	}
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / iterations / 1e3).toFixed(1)}us/setup`);
+	isolate.dispose();
+}
+
+(async function() {
+	for (let ii = 0; ii < 2; ++ii) {
+		await bench('individual calls', async (isolate, context) => {
+			for (let jj = 0; jj < operations; ++jj) {
+				await context.global.set(`value${jj}`, jj);
+			}
+		});
+		await bench('pipeline', async (isolate, context) => {
+			const pipeline = isolate.pipeline();
+			for (let jj = 0; jj < operations; ++jj) {
+				pipeline.set(context.global, `value${jj}`, jj);
+			}
+			await pipeline.run();
+		});
+	}
+})().catch(console.error);
@@ -0,0 +1,49 @@
+'use strict';
+// Compares draining a guest generator with one `next()` call per item against `applyIterator`,
+// which moves items out in batches.
+// Usage: node benchmark/reference-iterator.js [items]
+const ivm = require('isolated-vm');
+const items = Number(process.argv[2]) || 10000;
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const range = context.evalSync(`(function*(count) {
+	for (let ii = 0; ii < count; ++ii) {
+		yield { ii, name: 'item' + ii };
+	}
+})`, { reference: true });
+const step = context.evalSync('generator => generator.next()', { reference: true });
+
+async function bench(name, fn) {
+	await fn(100);
+	const start = process.hrtime.bigint();
+	const count = await fn(items);
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / count / 1e3).toFixed(2)}us/item`);
+}
+
+(async function() {
+	for (let ii = 0; ii < 2; ++ii) {
+		await bench('next() per item', async count => {
+			const generator = await range.apply(undefined, [ count ], { result: { reference: true } });
+			let seen = 0;
+			for (;;) {
+				const result = await step.apply(undefined, [ generator.derefInto() ], { result: { copy: true } });
+				if (result.done) {
+					return seen;
+				}
+				++seen;
+			}
+		});
+		for (const batchSize of [ 1, 100, 1000 ]) {
+			await bench(`applyIterator batchSize=${batchSize}`, async count => {
+				let seen = 0;
+				for await (const value of range.applyIterator(undefined, [ count ], { batchSize })) {
+					seen += value === undefined ? 0 : 1;
+				}
+				return seen;
+			});
+		}
+	}
+	isolate.dispose();
+})().catch(console.error);
@@ -0,0 +1,44 @@
+'use strict';
+// Compares walking a chain of properties with one awaited `get` per hop against queueing every hop
+// with `getPending` and awaiting only the last one.
+// Usage: node benchmark/reference-pending.js [iterations]
+const ivm = require('isolated-vm');
+const iterations = Number(process.argv[2]) || 2000;
+const depth = 10;
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+context.evalSync(`globalThis.root = {}; for (let ii = 0, node = root; ii < ${depth}; ++ii) node = node.next = { value: ii };`);
+const root = context.global.getSync('root', { reference: true });
+
+async function bench(name, fn) {
+	for (let ii = 0; ii < 100; ++ii) {
+		await fn();
+	}
+	const start = process.hrtime.bigint();
+	for (let ii = 0; ii < iterations; ++ii) {
+		await fn();
+	}
+	const elapsed = Number(process.hrtime.bigint() - start);
+	console.log(`${name}: ${(elapsed / iterations / 1e3).toFixed(1)}us/chain`);
+}
+
+(async function() {
+	for (let ii = 0; ii < 2; ++ii) {
+		await bench('awaited get', async () => {
+			let node = root;
+			for (let jj = 0; jj < depth; ++jj) {
+				node = await node.get('next', { reference: true });
+			}
+			return node.get('value');
+		});
+		await bench('getPending', () => {
+			let node = root;
+			for (let jj = 0; jj < depth; ++jj) {
+				node = node.getPending('next');
+			}
+			return node.get('value');
+		});
+	}
+	isolate.dispose();
+})().catch(console.error);
@@ -0,0 +1,32 @@
+'use strict';
+// Measures TypedArray allocation churn inside an isolate, with and without `pooledArrayBuffers`.
+// Usage: node benchmark/typed-array-churn.js [iterations]
+const ivm = require('isolated-vm');
+const iterations = Number(process.argv[2]) || 1e6;
+
+function run(pooledArrayBuffers) {
+	const isolate = new ivm.Isolate({ memoryLimit: 128, pooledArrayBuffers });
+	const context = isolate.createContextSync();
+	const script = isolate.compileScriptSync(`{
+		let sum = 0;
+		for (let ii = 0; ii < ${iterations}; ++ii) {
+			// Sizes above v8's on-heap typed array threshold so the allocator is used
+			const array = new Uint8Array(128 + (ii & 1023));
+			array[ii & 127] = ii;
+			sum += array[0];
+		}
+		sum;
+	}`);
+	// Warmup
+	script.runSync(context);
+	const start = process.hrtime.bigint();
+	script.runSync(context);
+	const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+	isolate.dispose();
+	return elapsed;
+}
+
+for (const pooled of [ false, true, false, true ]) {
+	const elapsed = run(pooled);
+	console.log(`${pooled ? 'pooled' : 'default'}: ${elapsed.toFixed(1)}ms, ${(elapsed * 1e6 / iterations).toFixed(1)}ns/allocation`);
+}
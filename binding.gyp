@@ -75,15 +75,19 @@
 				'src/isolate/three_phase_task.cc',
 				'src/lib/thread_pool.cc',
 				'src/lib/timer.cc',
+				'src/module/call_options_handle.cc',
 				'src/module/callback.cc',
+				'src/module/channel_handle.cc',
 				'src/module/context_handle.cc',
 				'src/module/evaluation.cc',
 				'src/module/external_copy_handle.cc',
 				'src/module/isolate.cc',
 				'src/module/isolate_handle.cc',
 				'src/module/lib_handle.cc',
+				'src/module/message_port_handle.cc',
 				'src/module/module_handle.cc',
 				'src/module/native_module_handle.cc',
+				'src/module/pipeline_handle.cc',
 				'src/module/reference_handle.cc',
 				'src/module/script_handle.cc',
 				'src/module/session_handle.cc',
@@ -10,6 +10,8 @@ declare namespace IsolatedVM {
 		| Script
 		| ExternalCopy<any>
 		| Callback<any>
+		| Channel
+		| MessagePort
 		| Copy<any>
 		| Reference<any>
 		| Dereference<any>
@@ -72,12 +74,29 @@ declare namespace IsolatedVM {
 		 * feature.**
 		 *
 		 * @param warmup_script - Optional script to "warmup" the snapshot by triggering code compilation
+		 * @param options.snapshot - Optional snapshot to start from, so `scripts` are layered on top of it
 		 */
-		static createSnapshot(scripts: SnapshotScriptInfo[], warmup_script?: string): ExternalCopy<ArrayBuffer>;
+		static createSnapshot(scripts: SnapshotScriptInfo[], warmup_script?: string, options?: SnapshotOptions): ExternalCopy<ArrayBuffer>;
+
+		/**
+		 * Same as `createSnapshot` but the snapshot is created on the isolate thread pool instead of
+		 * blocking the calling thread.
+		 */
+		static createSnapshotAsync(scripts: SnapshotScriptInfo[], warmup_script?: string, options?: SnapshotOptions): Promise<ExternalCopy<ArrayBuffer>>;
 
 		compileScript(code: string, scriptInfo?: ScriptInfo): Promise<Script>;
 		compileScriptSync(code: string, scriptInfo?: ScriptInfo): Script;
 
+		/**
+		 * Compiles a script whose source arrives in chunks, for example while it is still being read
+		 * from disk. Parsing starts as soon as the first chunk is available. Strings are used as-is
+		 * and binary chunks are decoded as UTF-8.
+		 */
+		compileScriptStream(
+			source: Iterable<SourceChunk> | AsyncIterable<SourceChunk>,
+			options?: ScriptOrigin & { produceCachedData?: boolean },
+		): Promise<Script>;
+
 		compileModule(code: string, options?: CompileModuleOptions): Promise<Module>;
 		compileModuleSync(code: string, options?: CompileModuleOptions): Module;
 
@@ -86,6 +105,12 @@ declare namespace IsolatedVM {
 
 		createInspectorSession(): InspectorSession;
 
+		/**
+		 * Creates a pipeline which records operations against this isolate and runs them all as one
+		 * task.
+		 */
+		pipeline(): Pipeline;
+
 		/**
 		 * Destroys this isolate and invalidates all references obtained from it.
 		 */
@@ -107,6 +132,13 @@ declare namespace IsolatedVM {
 		getHeapStatistics(): Promise<HeapStatistics>;
 		getHeapStatisticsSync(): HeapStatistics;
 
+		/**
+		 * Changes the memory limit of a running isolate, in MB. The new limit has the same meaning as
+		 * the `memoryLimit` option. If the isolate is using more memory than the new limit even after a
+		 * full garbage collection it will be disposed.
+		 */
+		setMemoryLimit(memoryLimit: number): void;
+
 		/**
 		 * Start profiling against the isolate with a specific title
 		 * 
@@ -148,6 +180,31 @@ declare namespace IsolatedVM {
 		 */
 		snapshot?: ExternalCopy<ArrayBuffer>;
 
+		/**
+		 * Recycle ArrayBuffer memory through per-isolate free lists instead of going to the system
+		 * allocator every time. This helps code which churns through many small typed arrays. Memory
+		 * accounting against `memoryLimit` is unchanged.
+		 */
+		pooledArrayBuffers?: boolean;
+
+		/**
+		 * Directory used to cache compiled code across processes. Compiles without explicit
+		 * `cachedData` look up a cache keyed by their source, v8 version, and flags, and write one
+		 * back on a miss or rejection.
+		 */
+		codeCacheDir?: string;
+
+		/**
+		 * Limits the CPU time this isolate may use. Async tasks are delayed while the isolate has used
+		 * more than `ms` of CPU time in the last `windowMs` (default 1000), synchronous calls are never
+		 * delayed. Once `budgetMs` of CPU time has been used in total the isolate is disposed.
+		 */
+		cpuQuota?: {
+			ms?: number;
+			windowMs?: number;
+			budgetMs?: number;
+		};
+
 		/**
 		 * Callback to be invoked when a *very bad* error occurs. If this is invoked it means that v8
 		 * has lost all control over the isolate, and all resources in use are totally unrecoverable. If
@@ -159,6 +216,10 @@ declare namespace IsolatedVM {
 
 	export type ContextOptions = {
 		inspector?: boolean;
+		/**
+		 * Name of a context stored in this isolate's snapshot to create the context from
+		 */
+		snapshot?: string;
 	};
 
 	export type HeapStatistics = {
@@ -249,6 +310,14 @@ declare namespace IsolatedVM {
 		private __ivm_script: undefined;
 		private constructor();
 
+		/**
+		 * Produces cached data for this script, including every function which has been compiled
+		 * since. Calling this after a warmup run gives a cache which also skips lazy compilation.
+		 * Throws for code containing asm.js, which v8 won't cache.
+		 */
+		createCachedData(): Promise<ExternalCopy<ArrayBuffer>>;
+		createCachedDataSync(): ExternalCopy<ArrayBuffer>;
+
 		/**
 		 * Releases the reference to this script, allowing the script data to be garbage collected.
 		 * Functions and data created in the isolate by previous invocations to `script.run(...)` will
@@ -277,6 +346,13 @@ declare namespace IsolatedVM {
 		private __ivm_module: undefined;
 		private constructor();
 
+		/**
+		 * Produces cached data for this module, including every function which has been compiled
+		 * since. This fails if the module threw during evaluation.
+		 */
+		createCachedData(): Promise<ExternalCopy<ArrayBuffer>>;
+		createCachedDataSync(): ExternalCopy<ArrayBuffer>;
+
 		/**
 		 * A read-only array of all dependency specifiers the module has.
 		 */
@@ -293,18 +369,19 @@ declare namespace IsolatedVM {
 		 * @param context The context the module should use.
 		 * @param resolveCallback This callback is responsible for resolving all direct and indirect
 		 * dependencies of this module. It accepts two parameters: specifier and referrer. It must
-		 * return a Module instance or a promise which will be used to satisfy the dependency.
+		 * return a Module instance or a promise which will be used to satisfy the dependency. A
+		 * `ModuleRegistry` may be passed instead to resolve dependencies without calling into JS.
 		 */
 		instantiate(
 			context: Context,
-			resolveCallback: (
+			resolveCallback: ((
 				specifier: string,
 				referrer: Module
-			) => Module | Promise<Module>
+			) => Module | Promise<Module>) | ModuleRegistry
 		): Promise<void>;
 		instantiateSync(
 			context: Context,
-			resolveCallback: (specifier: string, referrer: Module) => Module
+			resolveCallback: ((specifier: string, referrer: Module) => Module) | ModuleRegistry
 		): void;
 
 		/**
@@ -434,6 +511,30 @@ declare namespace IsolatedVM {
 			arguments?: ArgumentsTypeBidirectional<Options, ApplyArguments<T>>,
 			options?: Options
 		): ResultTypeBidirectionalSync<Options & FallbackReference, ApplyResult<T>>;
+
+		/**
+		 * Like `applyIgnored` and `getIgnored`, but immediately return a pending `Reference` to the
+		 * result. Operations on a pending reference are queued in the isolate behind the task which
+		 * produces it, so a chain of calls costs one round trip. If that task fails then operations
+		 * on the result reject with its error. Synchronous access blocks until the result is ready,
+		 * or throws if made from inside the target isolate before then.
+		 */
+		applyPending(
+			receiver?: any,
+			arguments?: any[],
+			options?: RunOptions & { arguments?: TransferOptions }
+		): Reference<ApplyResult<T>>;
+		getPending<Key extends keyof T>(property: Key, options?: { accessors?: boolean }): Reference<T[Key]>;
+
+		/**
+		 * Invokes a function returning an iterable (or async iterable) and streams its values back
+		 * in batches of up to `batchSize` items, one task and one copy per batch.
+		 */
+		applyIterator(
+			receiver?: any,
+			arguments?: any[],
+			options?: RunOptions & { arguments?: TransferOptions; batchSize?: number }
+		): AsyncIterableIterator<any>;
 	}
 
 	/**
@@ -446,6 +547,55 @@ declare namespace IsolatedVM {
 
 	export type ReferenceApplyOptions = RunOptions & TransferOptionsBidirectional;
 
+	/**
+	 * A pipeline records a sequence of operations against one isolate and then runs them in order as
+	 * a single task. Each recording method returns a placeholder for that operation's result, which
+	 * later operations in the same pipeline can use as a target, receiver, argument, or value.
+	 */
+	export class Pipeline {
+		private constructor();
+
+		apply(target: Reference | PipelineResult, receiver?: any, args?: any[], options?: ReferenceApplyOptions): PipelineResult;
+		delete(target: Reference | PipelineResult, property: any): PipelineResult;
+		eval(context: Context, code: string, options?: ContextEvalOptions): PipelineResult;
+		get(target: Reference | PipelineResult, property: any, options?: TransferOptions & { accessors?: boolean }): PipelineResult;
+		set(target: Reference | PipelineResult, property: any, value: any, options?: TransferOptions): PipelineResult;
+
+		/**
+		 * Runs every recorded operation in order and returns the result of each one. If an operation
+		 * throws then the operations after it do not run. A pipeline can only be run once.
+		 */
+		run(): Promise<any[]>;
+		runSync(): any[];
+	}
+
+	/**
+	 * Placeholder for the result of an operation in a `Pipeline`.
+	 */
+	export class PipelineResult {
+		private constructor();
+		private __ivm_pipeline_result: undefined;
+	}
+
+	/**
+	 * Options for `apply`, `get`, `set`, `eval`, `evalClosure`, and `run` which are parsed and
+	 * validated once. An instance can be passed in place of an options object to any of these
+	 * functions. Options are read when the instance is created, so later changes to `options` have
+	 * no effect.
+	 */
+	export const CallOptions: {
+		new <Options extends CallOptionsInit>(options: Options): CallOptions<Options>;
+	};
+	// The parsed options can't be read back, but carrying them in the type lets result types be inferred
+	export type CallOptions<Options extends CallOptionsInit = CallOptionsInit> = Readonly<Options>;
+
+	export type CallOptionsInit = RunOptions & ReleaseOptions & TransferOptions & TransferOptionsBidirectional & {
+		/**
+		 * Allow `get` to invoke getters and proxies.
+		 */
+		accessors?: boolean;
+	};
+
 	/**
 	 * Instances of this class represent some value that is stored outside of any v8
 	 * isolate. This value can then be quickly copied into any isolate.
@@ -475,6 +625,13 @@ declare namespace IsolatedVM {
 		 */
 		static readonly totalExternalSize: number;
 
+		/**
+		 * Memory-maps a file, such as a snapshot or code cache blob saved by `writeFile`. Every copy of
+		 * the same file shares memory through the OS page cache. The file must not be truncated or
+		 * rewritten in place while the copy is alive.
+		 */
+		static fromFile(path: string, options?: ExternalCopyFromFileOptions): ExternalCopy<ArrayBuffer>;
+
 		/**
 		 * Internalizes the ExternalCopy data into this isolate.
 		 *
@@ -495,6 +652,12 @@ declare namespace IsolatedVM {
 		 * automatically because there's no inter-isolate dependencies.
 		 */
 		release(): void;
+
+		/**
+		 * Writes the contents of this copy to a file. Only copies of an `ArrayBuffer` can be written.
+		 * The file is replaced by a rename, so existing mappings of it from `fromFile` stay valid.
+		 */
+		writeFile(path: string): void;
 	}
 
 	/**
@@ -517,6 +680,13 @@ declare namespace IsolatedVM {
 		 * only applies to ArrayBuffer and TypedArray instances.
 		 */
 		transferOut?: boolean;
+		/**
+		 * If true the ArrayBuffer is copied once into shared memory and each `copy()` or `copyInto()`
+		 * gets a copy-on-write view of it. Many isolates can read the same data without each holding
+		 * a copy, and writes from one isolate are never seen by the others. Each view still counts its
+		 * full size against the receiving isolate's memory limit. Only applies to ArrayBuffer instances.
+		 */
+		copyOnWrite?: boolean;
 	};
 
 	export type ExternalCopyCopyOptions = ReleaseOptions & {
@@ -527,6 +697,115 @@ declare namespace IsolatedVM {
 		transferIn?: boolean;
 	};
 
+	export type ExternalCopyFromFileOptions = {
+		/**
+		 * Map the file again for each copy instead of copying the buffer. Only resident pages count
+		 * against the receiving isolate's memory limit.
+		 */
+		mmap?: boolean;
+	};
+
+	/**
+	 * A queue of messages which is shared by every isolate it is transferred to. Messages are copied
+	 * into a fixed-size ring buffer outside of any isolate, and sending never blocks or takes a lock.
+	 */
+	export class Channel {
+		private __ivm_channel: undefined;
+
+		constructor(options?: ChannelOptions);
+
+		/**
+		 * The actual size of the ring buffer in bytes.
+		 */
+		readonly capacity: number;
+
+		/**
+		 * `ArrayBuffer` messages are received as an `ArrayBuffer`, TypedArray and DataView messages are
+		 * received as a view of the same type. Any other value is copied using the structured clone
+		 * algorithm, but may not contain transferable handles or `SharedArrayBuffer` instances.
+		 *
+		 * @return False if the channel doesn't have room for this message right now.
+		 */
+		send(value: any): boolean;
+
+		/**
+		 * @return The next message, or `undefined` if the channel is empty or there are pending
+		 * `receive()` calls.
+		 */
+		tryReceive(): any;
+
+		/**
+		 * Promises are resolved in the order `receive()` was called, even across isolates.
+		 */
+		receive(): Promise<any>;
+	}
+
+	export type ChannelOptions = {
+		/**
+		 * Size of the ring buffer in bytes, rounded up to a power of two. Default is 65536.
+		 */
+		capacity?: number;
+	};
+
+	/**
+	 * A map of specifiers to compiled modules. `instantiate` resolves a module graph against it
+	 * without calling into JS, and guest `import()` resolves against it as well.
+	 */
+	export class ModuleRegistry {
+		private __ivm_module_registry: undefined;
+
+		/**
+		 * @param options.imports Import map. Keys are bare specifiers or prefixes ending in "/".
+		 */
+		constructor(options?: { imports?: Record<string, string> });
+
+		/**
+		 * Registers `module` under `name`. Relative specifiers are resolved against this name.
+		 */
+		set(name: string, module: Module): void;
+
+		delete(name: string): boolean;
+	}
+
+	/**
+	 * Creates a pair of entangled `MessagePort` instances. Each port can be transferred to any
+	 * isolate.
+	 */
+	export class MessageChannel {
+		private __ivm_message_channel: undefined;
+
+		constructor();
+
+		readonly port1: MessagePort;
+		readonly port2: MessagePort;
+	}
+
+	/**
+	 * One end of a `MessageChannel`. Messages posted to a port are queued natively until the other
+	 * port has an `onmessage` handler, and are delivered to that handler in batches.
+	 */
+	export class MessagePort {
+		private __ivm_message_port: undefined;
+		private constructor();
+
+		/**
+		 * Sends a message to the other port. Transferable values are transferred, and other values are
+		 * copied unless a different option is given in `options`.
+		 */
+		postMessage(value: any, options?: TransferOptions): void;
+
+		/**
+		 * Invoked with an object whose `data` property is the message. The handler is bound to the
+		 * isolate and context in which it was set.
+		 */
+		onmessage: ((event: { data: any }) => void) | null;
+
+		/**
+		 * Closes both ends of the channel. Queued messages are dropped.
+		 */
+		close(): void;
+	}
+
 	/**
    * Callbacks can be used to create cross-isolate references to simple functions. This can be
 	 * easier and safer than dealing with the more flexible
@@ -679,6 +958,12 @@ declare namespace IsolatedVM {
 		 * canceled. Default is no timeout.
 		 */
 		timeout?: number;
+
+		/**
+		 * Maximum amount of CPU time in milliseconds this script is allowed to use before execution is
+		 * canceled. Time spent waiting on the host does not count. Default is no timeout.
+		 */
+		cpuTimeout?: number;
 	};
 
 	/**
@@ -710,8 +995,21 @@ declare namespace IsolatedVM {
 		 */
 		code: string;
 	};
+	export type SnapshotOptions = {
+		/**
+		 * Existing snapshot which the new snapshot is derived from
+		 */
+		snapshot?: ExternalCopy<ArrayBuffer>;
+		/**
+		 * Extra named contexts, each set up by its own scripts, which can be passed to `createContext`.
+		 * These can't be combined with `snapshot`.
+		 */
+		contexts?: Record<string, SnapshotScriptInfo[]>;
+	};
 	export type ScriptInfo = CachedDataOptions & ScriptOrigin;
 
+	export type SourceChunk = string | ArrayBuffer | ArrayBufferView | ExternalCopy<string | ArrayBuffer>;
+
 	/**
 	 * Any function which moves data between isolates will accept these transfer options. By default
 	 * only *[transferable]* values may pass between isolates. Without specifying one of these options
@@ -11,7 +11,17 @@
 #include "isolate/generic/object.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <random>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace v8;
 
@@ -392,6 +402,22 @@ auto ExternalCopyArrayBuffer::CopyInto(bool transfer_in) -> Local<Value> {
 		if (!backing_store) {
 			throw RuntimeGenericError("Array buffer is invalid");
 		}
+#ifndef _WIN32
+		if (mapped_file) {
+			// Each copy gets its own private mapping, so isolates share clean pages and writes stay local.
+			// Any page may become private once written, so the whole mapping is charged.
+			auto mapped_store = mapped_file->Map();
+			size_t size = mapped_store->ByteLength();
+			if (allocator != nullptr && !allocator->Check(size)) {
+				throw RuntimeRangeError("Array buffer allocation failed");
+			}
+			auto handle = ArrayBuffer::New(Isolate::GetCurrent(), std::move(mapped_store));
+			if (allocator != nullptr) {
+				allocator->Track(handle, size);
+			}
+			return handle;
+		}
+#endif
 		auto size = backing_store->ByteLength();
 		if (allocator != nullptr && !allocator->Check(size)) {
 			// ArrayBuffer::New will crash the process if there is an allocation failure, so we check
@@ -405,6 +431,148 @@ auto ExternalCopyArrayBuffer::CopyInto(bool transfer_in) -> Local<Value> {
 	}
 }
 
+auto ExternalCopyArrayBuffer::FromFile(const std::string& path, bool map_copies) -> std::unique_ptr<ExternalCopyArrayBuffer> {
+#ifdef _WIN32
+	// No mmap here, so just read the file into memory
+	std::ifstream file{path, std::ios::binary | std::ios::ate};
+	if (!file) {
+		throw RuntimeGenericError("Failed to read `"+ path+ "`: "+ std::strerror(errno));
+	}
+	auto length = static_cast<size_t>(file.tellg());
+	auto backing_store = ArrayBuffer::NewBackingStore(
+		std::malloc(length), length,
+		[](void* data, size_t /*length*/, void* /*param*/) { std::free(data); },
+		nullptr);
+	file.seekg(0);
+	if (!file.read(static_cast<char*>(backing_store->Data()), length)) {
+		throw RuntimeGenericError("Failed to read `"+ path+ "`: "+ std::strerror(errno));
+	}
+	return std::make_unique<ExternalCopyArrayBuffer>(std::move(backing_store));
+#else
+	auto file = std::make_shared<MappedFile>(path);
+	auto copy = std::make_unique<ExternalCopyArrayBuffer>(file->Map());
+	if (map_copies) {
+		copy->mapped_file = std::move(file);
+	}
+	return copy;
+#endif
+}
+
+auto ExternalCopyArrayBuffer::CopyOnWrite(Local<ArrayBuffer> handle) -> std::unique_ptr<ExternalCopyArrayBuffer> {
+#ifdef _WIN32
+	// Nothing to share the memory with, so this is a regular copy
+	return std::make_unique<ExternalCopyArrayBuffer>(handle);
+#else
+	auto memory = std::make_shared<MappedFile>(handle->GetBackingStore()->Data(), handle->ByteLength());
+	auto copy = std::make_unique<ExternalCopyArrayBuffer>(memory->Map());
+	copy->mapped_file = std::move(memory);
+	return copy;
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * MappedFile implementation
+ */
+MappedFile::MappedFile(const std::string& path) : fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)} {
+	auto fail = [&]() {
+		auto error = RuntimeGenericError("Failed to read `"+ path+ "`: "+ std::strerror(errno));
+		if (fd != -1) {
+			close(fd);
+		}
+		return error;
+	};
+	if (fd == -1) {
+		throw fail();
+	}
+	struct stat info{};
+	if (fstat(fd, &info) == -1) {
+		throw fail();
+	}
+	length = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::MappedFile(const void* data, size_t length) : length{length} {
+#ifdef __linux__
+	fd = memfd_create("isolated-vm", MFD_CLOEXEC);
+#else
+	// Named shared memory which is unlinked right away
+	thread_local std::mt19937_64 random{std::random_device{}()};
+	auto name = "/isolated-vm-"+ std::to_string(random());
+	fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1) {
+		shm_unlink(name.c_str());
+	}
+#endif
+	auto fail = [&]() {
+		auto error = RuntimeGenericError(std::string{"Failed to allocate shared memory: "}+ std::strerror(errno));
+		if (fd != -1) {
+			close(fd);
+		}
+		return error;
+	};
+	if (fd == -1 || ftruncate(fd, static_cast<off_t>(length)) == -1) {
+		throw fail();
+	}
+	if (length != 0) {
+		void* target = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (target == MAP_FAILED) {
+			throw fail();
+		}
+		std::memcpy(target, data, length);
+		munmap(target, length);
+	}
+}
+
+MappedFile::~MappedFile() {
+	close(fd);
+}
+
+auto MappedFile::Map() const -> std::unique_ptr<BackingStore> {
+	void* data = nullptr;
+	if (length != 0) {
+		data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			throw RuntimeGenericError(std::string{"Failed to map file: "}+ std::strerror(errno));
+		}
+	}
+	return ArrayBuffer::NewBackingStore(
+		data, length,
+		[](void* data, size_t length, void* /*param*/) {
+			if (data != nullptr) {
+				munmap(data, length);
+			}
+		},
+		nullptr);
+}
+#endif
+
+void ExternalCopyArrayBuffer::WriteFile(const std::string& path) const {
+	auto backing_store = Acquire();
+	if (!backing_store) {
+		throw RuntimeGenericError("Array buffer is invalid");
+	}
+	// Written to a temporary file in the same directory and renamed over `path`. Truncating in place
+	// would pull the pages out from under any live mapping of the old file, and other processes
+	// never see a partial file this way.
+	thread_local std::mt19937_64 random{std::random_device{}()};
+	auto temporary_path = path+ "."+ std::to_string(random())+ ".tmp";
+	{
+		std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+		if (!file || !file.write(static_cast<const char*>(backing_store->Data()), backing_store->ByteLength()) || !file.flush()) {
+			auto message = std::string{"Failed to write `"}+ path+ "`: "+ std::strerror(errno);
+			file.close();
+			std::remove(temporary_path.c_str());
+			throw RuntimeGenericError(message);
+		}
+	}
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		auto message = std::string{"Failed to write `"}+ path+ "`: "+ std::strerror(errno);
+		std::remove(temporary_path.c_str());
+		throw RuntimeGenericError(message);
+	}
+}
+
 /**
  * ExternalCopySharedArrayBuffer implementation
  */
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "isolate/generic/array.h"
@@ -85,6 +86,38 @@ class ExternalCopyArrayBuffer : public ExternalCopyAnyBuffer {
 
 		static auto Transfer(v8::Local<v8::ArrayBuffer> handle) -> std::unique_ptr<ExternalCopyArrayBuffer>;
 		auto CopyInto(bool transfer_in = false) -> v8::Local<v8::Value> final;
+
+		/**
+		 * `FromFile` maps the file into memory instead of reading it, so every copy of the same file
+		 * shares pages through the page cache. The mapping is private so writes stay local. With
+		 * `map_copies` each `CopyInto` also maps the file again instead of copying the buffer.
+		 */
+		static auto FromFile(const std::string& path, bool map_copies = false) -> std::unique_ptr<ExternalCopyArrayBuffer>;
+		// Copies the buffer once into shared memory which is mapped copy-on-write into each isolate
+		static auto CopyOnWrite(v8::Local<v8::ArrayBuffer> handle) -> std::unique_ptr<ExternalCopyArrayBuffer>;
+		void WriteFile(const std::string& path) const;
+
+	private:
+		std::shared_ptr<class MappedFile> mapped_file;
+};
+
+/**
+ * Read-only file, or anonymous shared memory, which hands out private copy-on-write mappings of
+ * itself
+ */
+class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path);
+		MappedFile(const void* data, size_t length);
+		MappedFile(const MappedFile&) = delete;
+		auto operator=(const MappedFile&) -> MappedFile& = delete;
+		~MappedFile();
+
+		auto Map() const -> std::unique_ptr<v8::BackingStore>;
+
+	private:
+		int fd = -1;
+		size_t length = 0;
 };
 
 /**
@@ -18,6 +18,9 @@ class ExternalCopyString final : public ExternalCopy {
 		auto operator= (ExternalCopyString&& that) noexcept -> ExternalCopyString& = default;
 
 		explicit operator bool() const { return static_cast<bool>(value); }
+		// Latin-1 characters if `IsOneByte()`, otherwise UTF-16
+		auto GetValue() const -> const std::shared_ptr<std::vector<char>>& { return value; }
+		auto IsOneByte() const -> bool { return one_byte; }
 		auto CopyInto(bool transfer_in = false) -> v8::Local<v8::Value> final;
 
 	private:
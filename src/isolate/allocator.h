@@ -1,22 +1,72 @@
 #pragma once
 #include <v8.h>
+#include <array>
+#include <atomic>
 #include <memory>
 #include "v8_version.h"
 
 namespace ivm {
 
+/**
+ * Per-isolate free lists of small ArrayBuffer blocks, rounded up to power-of-two size classes.
+ * Buffers too large to pool are mapped directly from the OS where possible. This only recycles
+ * memory, it has no idea about memory limits. `LimitedAllocator` does the accounting.
+ *
+ * Allocations only happen on the thread which holds the isolate lock, but v8 frees buffers from its
+ * sweeper threads too. So blocks are freed onto a lock-free `incoming` stack, and the allocating
+ * thread takes the whole stack at once when its `local` list runs dry. `max_cached_bytes` bounds
+ * the incoming stacks, so at most twice that much is held onto.
+ */
+class ArrayBufferPool {
+	public:
+		explicit ArrayBufferPool(size_t max_cached_bytes) : max_cached_bytes{max_cached_bytes} {}
+		ArrayBufferPool(const ArrayBufferPool&) = delete;
+		~ArrayBufferPool();
+		auto operator=(const ArrayBufferPool&) = delete;
+
+		auto Allocate(size_t length, bool zero) -> void*;
+		void Free(void* data, size_t length);
+
+	private:
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		static constexpr size_t kMinClassShift = 6; // 64 bytes, smaller blocks are rounded up
+		static constexpr size_t kMaxClassShift = 16; // 64kb, larger blocks are not pooled
+		static constexpr size_t kClassCount = kMaxClassShift - kMinClassShift + 1;
+		static constexpr size_t kMinMappedLength = 1024 * 1024;
+
+		static auto SizeClass(size_t length) -> size_t;
+
+		// `local` is only touched by the allocating thread. The rest is kept on separate cache lines
+		// since it's written by whichever thread frees a buffer.
+		std::array<FreeBlock*, kClassCount> local{};
+		alignas(64) std::array<std::atomic<FreeBlock*>, kClassCount> incoming{};
+		alignas(64) std::atomic<size_t> incoming_bytes{0};
+		size_t max_cached_bytes;
+};
+
 class LimitedAllocator : public v8::ArrayBuffer::Allocator {
 	private:
 		class IsolateEnvironment& env;
-		size_t limit;
+		std::unique_ptr<ArrayBufferPool> pool;
+		// Used heap size as of the last GC, and a counter of GCs seen. `pressure_epoch` and
+		// `collect_epoch` record the GC epoch in which we last escalated, so each step is taken at most
+		// once until v8 has run another collection.
 		size_t v8_heap;
-		size_t next_check;
+		size_t gc_epoch = 1;
+		size_t pressure_epoch = 0;
+		size_t collect_epoch = 0;
 		int failures = 0;
 
+		auto AllocateBlock(size_t length, bool zero) -> void*;
+		void FreeBlock(void* data, size_t length);
 
 	public:
+		static void GCEpilogue(v8::Isolate* isolate, v8::GCType gc_type, v8::GCCallbackFlags gc_flags, void* data);
 		auto Check(size_t length) -> bool;
-		explicit LimitedAllocator(class IsolateEnvironment& env, size_t limit);
+		explicit LimitedAllocator(class IsolateEnvironment& env, bool pooled = false);
 		auto Allocate(size_t length) -> void* final;
 		auto AllocateUninitialized(size_t length) -> void* final;
 		void Free(void* data, size_t length) final;
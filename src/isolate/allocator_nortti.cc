@@ -1,6 +1,13 @@
 #include "allocator.h"
 #include "environment.h"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+
+#if defined __unix__ || defined __APPLE__
+#include <sys/mman.h>
+#define IVM_MMAP_ARRAY_BUFFERS 1
+#endif
 
 using namespace v8;
 
@@ -43,37 +50,160 @@ class ExternalMemoryHandle {
 
 } // anonymous namespace
 
+/**
+ * ArrayBufferPool implementation
+ */
+ArrayBufferPool::~ArrayBufferPool() {
+	for (size_t ii = 0; ii < kClassCount; ++ii) {
+		for (auto* block : { local[ii], incoming[ii].load() }) {
+			while (block != nullptr) {
+				auto* next = block->next;
+				std::free(block);
+				block = next;
+			}
+		}
+	}
+}
+
+auto ArrayBufferPool::SizeClass(size_t length) -> size_t {
+	size_t size_class = 0;
+	while ((size_t{1} << (size_class + kMinClassShift)) < length) {
+		++size_class;
+	}
+	return size_class;
+}
+
+auto ArrayBufferPool::Allocate(size_t length, bool zero) -> void* {
+	if (length > (size_t{1} << kMaxClassShift)) {
+#if IVM_MMAP_ARRAY_BUFFERS
+		if (length >= kMinMappedLength) {
+			// Fresh anonymous mappings are always zeroed, and munmap gives the memory straight back
+			void* data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return data == MAP_FAILED ? nullptr : data;
+		}
+#endif
+		return zero ? std::calloc(length, 1) : std::malloc(length);
+	}
+	auto size_class = SizeClass(length);
+	auto block_size = size_t{1} << (size_class + kMinClassShift);
+	auto*& head = local[size_class];
+	if (head == nullptr) {
+		// Take everything that's been freed since last time
+		head = incoming[size_class].exchange(nullptr, std::memory_order_acquire);
+		size_t count = 0;
+		for (auto* block = head; block != nullptr; block = block->next) {
+			++count;
+		}
+		incoming_bytes.fetch_sub(count * block_size, std::memory_order_relaxed);
+	}
+	auto* block = head;
+	if (block == nullptr) {
+		block = static_cast<FreeBlock*>(std::malloc(block_size));
+	} else {
+		head = block->next;
+	}
+	if (zero && block != nullptr) {
+		std::memset(block, 0, length);
+	}
+	return block;
+}
+
+void ArrayBufferPool::Free(void* data, size_t length) {
+	if (data == nullptr) {
+		return;
+	} else if (length > (size_t{1} << kMaxClassShift)) {
+#if IVM_MMAP_ARRAY_BUFFERS
+		if (length >= kMinMappedLength) {
+			munmap(data, length);
+			return;
+		}
+#endif
+		std::free(data);
+		return;
+	}
+	auto size_class = SizeClass(length);
+	auto block_size = size_t{1} << (size_class + kMinClassShift);
+	if (incoming_bytes.fetch_add(block_size, std::memory_order_relaxed) + block_size > max_cached_bytes) {
+		incoming_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+		std::free(data);
+		return;
+	}
+	auto& stack = incoming[size_class];
+	auto* block = static_cast<FreeBlock*>(data);
+	block->next = stack.load(std::memory_order_relaxed);
+	while (!stack.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+/**
+ * Runs after every GC, including scavenges, and refreshes the heap estimate used by `Check`. This
+ * way the common case in `Check` is just arithmetic and never has to ask v8 for heap statistics.
+ */
+void LimitedAllocator::GCEpilogue(Isolate* isolate, GCType /*gc_type*/, GCCallbackFlags /*gc_flags*/, void* data) {
+	auto* that = static_cast<LimitedAllocator*>(data);
+	HeapStatistics heap_statistics;
+	isolate->GetHeapStatistics(&heap_statistics);
+	that->v8_heap = heap_statistics.used_heap_size();
+	++that->gc_epoch;
+}
+
 /**
  * ArrayBuffer::Allocator that enforces memory limits. The v8 documentation specifically says
  * that it's unsafe to call back into v8 from this class but I took a look at
- * GetHeapStatistics() and I think it'll be ok.
+ * LowMemoryNotification() and I think it'll be ok.
+ *
+ * Escalation near the limit goes: v8's own scavenges (driven by its array buffer accounting) keep
+ * the estimate fresh, then "moderate" memory pressure once we're within 1/8th of the limit, then
+ * a blocking full GC when an allocation would go over. Each step is taken at most once per GC
+ * epoch, since repeating it before v8 has collected anything won't change the answer.
  */
 auto LimitedAllocator::Check(const size_t length) -> bool {
-	if (v8_heap + env.extra_allocated_memory + length > next_check) {
-		HeapStatistics heap_statistics;
-		Isolate* isolate = Isolate::GetCurrent();
-		isolate->GetHeapStatistics(&heap_statistics);
-		v8_heap = heap_statistics.used_heap_size();
-		if (v8_heap + env.extra_allocated_memory + length > limit + env.misc_memory_size) {
-			// This is might be dangerous but the tests pass soooo..
-			isolate->LowMemoryNotification();
-			isolate->GetHeapStatistics(&heap_statistics);
-			v8_heap = heap_statistics.used_heap_size();
-			if (v8_heap + env.extra_allocated_memory + length > limit + env.misc_memory_size) {
-				return false;
-			}
+	// `memory_limit` may be changed from another thread at any time so it's read fresh each time
+	size_t limit = env.memory_limit + env.misc_memory_size;
+	auto total = [&]() { return v8_heap + env.extra_allocated_memory + length; };
+	if (total() + limit / 8 <= limit) {
+		return true;
+	}
+	if (pressure_epoch != gc_epoch) {
+		// Ask v8 to start collecting soon. This is delivered as an interrupt, it doesn't block here.
+		pressure_epoch = gc_epoch;
+		if (env.memory_pressure < MemoryPressureLevel::kModerate) {
+			env.RequestMemoryPressureNotification(MemoryPressureLevel::kModerate, true);
 		}
-		next_check = v8_heap + env.extra_allocated_memory + length + 1024 * 1024;
 	}
-	return v8_heap + env.extra_allocated_memory + length <= limit + env.misc_memory_size;
+	if (total() <= limit) {
+		return true;
+	} else if (collect_epoch == gc_epoch) {
+		// Already did a full GC and nothing has been collected since
+		return false;
+	}
+	// This is might be dangerous but the tests pass soooo.. `GCEpilogue` updates the estimate.
+	Isolate::GetCurrent()->LowMemoryNotification();
+	collect_epoch = gc_epoch;
+	return total() <= limit;
+}
+
+LimitedAllocator::LimitedAllocator(IsolateEnvironment& env, bool pooled) :
+	env(env), pool{pooled ? std::make_unique<ArrayBufferPool>(env.memory_limit / 32) : nullptr}, v8_heap(1024 * 1024 * 4) {}
+
+auto LimitedAllocator::AllocateBlock(size_t length, bool zero) -> void* {
+	if (pool) {
+		return pool->Allocate(length, zero);
+	}
+	return zero ? std::calloc(length, 1) : std::malloc(length);
 }
 
-LimitedAllocator::LimitedAllocator(IsolateEnvironment& env, size_t limit) : env(env), limit(limit), v8_heap(1024 * 1024 * 4), next_check(1024 * 1024) {}
+void LimitedAllocator::FreeBlock(void* data, size_t length) {
+	if (pool) {
+		pool->Free(data, length);
+	} else {
+		std::free(data);
+	}
+}
 
 auto LimitedAllocator::Allocate(size_t length) -> void* {
 	if (Check(length)) {
 		env.extra_allocated_memory += length;
-		return std::calloc(length, 1);
+		return AllocateBlock(length, true);
 	} else {
 		++failures;
 		if (length <= 64) { // kMinAddedElementsCapacity * sizeof(uint32_t)
@@ -85,7 +215,7 @@ auto LimitedAllocator::Allocate(size_t length) -> void* {
 			// and will soon be freed because at the same time we terminate the isolate.
 			env.extra_allocated_memory += length;
 			env.Terminate();
-			return std::calloc(length, 1);
+			return AllocateBlock(length, true);
 		} else {
 			// The places end up here are more graceful and will throw a RangeError
 			return nullptr;
@@ -96,13 +226,13 @@ auto LimitedAllocator::Allocate(size_t length) -> void* {
 auto LimitedAllocator::AllocateUninitialized(size_t length) -> void* {
 	if (Check(length)) {
 		env.extra_allocated_memory += length;
-		return std::malloc(length);
+		return AllocateBlock(length, false);
 	} else {
 		++failures;
 		if (length <= 64) {
 			env.extra_allocated_memory += length;
 			env.Terminate();
-			return std::malloc(length);
+			return AllocateBlock(length, false);
 		} else {
 			return nullptr;
 		}
@@ -111,19 +241,30 @@ auto LimitedAllocator::AllocateUninitialized(size_t length) -> void* {
 
 void LimitedAllocator::Free(void* data, size_t length) {
 	env.extra_allocated_memory -= length;
-	next_check -= length;
-	std::free(data);
+	FreeBlock(data, length);
 }
 
 auto LimitedAllocator::Reallocate(void* data, size_t old_length, size_t new_length) -> void* {
-	auto delta = static_cast<ssize_t>(new_length) - static_cast<ssize_t>(old_length);
-	if (delta > 0) {
-		if (!Check(delta)) {
-			return nullptr;
-		}
+	if (old_length == new_length) {
+		return data;
+	} else if (new_length > old_length && !Check(new_length - old_length)) {
+		return nullptr;
+	}
+	// The default implementation goes through `AllocateUninitialized` and `Free` which would count
+	// the difference twice, and it doesn't know about the pool.
+	void* new_data = AllocateBlock(new_length, false);
+	if (new_data == nullptr) {
+		return nullptr;
+	}
+	std::memcpy(new_data, data, std::min(old_length, new_length));
+	if (new_length > old_length) {
+		std::memset(static_cast<char*>(new_data) + old_length, 0, new_length - old_length);
+		env.extra_allocated_memory += new_length - old_length;
+	} else {
+		env.extra_allocated_memory -= old_length - new_length;
 	}
-	env.extra_allocated_memory += delta;
-	return ArrayBuffer::Allocator::Reallocate(data, old_length, new_length);
+	FreeBlock(data, old_length);
+	return new_data;
 }
 
 void LimitedAllocator::AdjustAllocatedSize(ptrdiff_t length) {
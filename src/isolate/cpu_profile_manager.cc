@@ -1,15 +1,18 @@
 #include "cpu_profile_manager.h"
 #include "environment.h"
 #include <algorithm>
-#include <climits>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 #include "isolate/strings.h"
+#include "isolate/util.h"
+#include "lib/thread_pool.h"
 #include "v8-platform.h"
 #include "v8.h"
 
@@ -20,30 +23,87 @@ namespace ivm {
 /**
  * CpuProfileManagerImpl
  */
-IVMCpuProfile::IVMCpuProfile(const std::shared_ptr<v8::CpuProfile>& cpuProfile):
-	profile_thread(std::this_thread::get_id()),
+IVMCpuProfile::IVMCpuProfile(const v8::CpuProfile* cpuProfile, std::thread::id thread):
+	profile_thread(thread),
 	start_time(cpuProfile->GetStartTime()),
 	end_time(cpuProfile->GetEndTime()),
 	samples_count(cpuProfile->GetSamplesCount()) {
 
+	// handle nodes
+	FlatNodes(cpuProfile->GetTopDownRoot(), &profileNodes);
+
+	// renumber nodes by position so that merging doesn't need any lookup tables
+	std::unordered_map<unsigned int, unsigned int> ids;
+	ids.reserve(profileNodes.size());
+	for (size_t i = 0; i < profileNodes.size(); i++) {
+		ids[profileNodes[i].node_id] = static_cast<unsigned int>(i + 1);
+	}
+	for (auto& node : profileNodes) {
+		node.node_id = ids[node.node_id];
+		for (auto& child : node.children) {
+			child = ids[child];
+		}
+	}
+
 	samples.reserve(samples_count);
 	timestamps.reserve(samples_count);
 	for (int64_t i = 0; i < samples_count; i++) {
 		const int idx = static_cast<int>(i);
-		samples.push_back(cpuProfile->GetSample(idx)->GetNodeId());
+		samples.push_back(ids[cpuProfile->GetSample(idx)->GetNodeId()]);
 		timestamps.push_back(cpuProfile->GetSampleTimestamp(idx));
 	}
+}
 
-	// handle nodes
-	FlatNodes(cpuProfile->GetTopDownRoot(), &profileNodes);
+void IVMCpuProfile::Merge(const IVMCpuProfile& that) {
+	// Nodes are in pre-order so each parent is mapped before any of its children
+	std::vector<unsigned int> parents(that.profileNodes.size() + 1);
+	std::vector<unsigned int> ids(that.profileNodes.size() + 1);
+	for (const auto& node : that.profileNodes) {
+		for (auto child : node.children) {
+			parents[child] = node.node_id;
+		}
+	}
+	for (const auto& node : that.profileNodes) {
+		unsigned int id = 1;
+		if (node.node_id != 1) {
+			const size_t parent_index = ids[parents[node.node_id]] - 1;
+			id = 0;
+			for (auto child : profileNodes[parent_index].children) {
+				if (profileNodes[child - 1].call_frame == node.call_frame) {
+					id = child;
+					break;
+				}
+			}
+			if (id == 0) {
+				id = static_cast<unsigned int>(profileNodes.size() + 1);
+				profileNodes.push_back(node);
+				profileNodes.back().node_id = id;
+				profileNodes.back().hit_count = 0;
+				profileNodes.back().children.clear();
+				profileNodes[parent_index].children.push_back(id);
+			}
+		}
+		profileNodes[id - 1].hit_count += node.hit_count;
+		ids[node.node_id] = id;
+	}
+
+	samples.reserve(samples.size() + that.samples.size());
+	timestamps.reserve(timestamps.size() + that.timestamps.size());
+	for (int64_t i = 0; i < that.samples_count; i++) {
+		samples.push_back(ids[that.samples[i]]);
+		timestamps.push_back(that.timestamps[i]);
+	}
+	samples_count += that.samples_count;
+	start_time = std::min(start_time, that.start_time);
+	end_time = std::max(end_time, that.end_time);
 }
 
-auto IVMCpuProfile::GetTidValue(Isolate *iso) -> Local<Value>{
+auto IVMCpuProfile::GetTidValue(Isolate *iso) const -> Local<Value>{
 	const auto tid = std::hash<std::thread::id>{}(profile_thread);
 	return Number::New(iso, static_cast<double>(tid));
 }
 
-auto IVMCpuProfile::BuildCpuProfile(Isolate *iso) -> Local<Value> {
+auto IVMCpuProfile::BuildCpuProfile(Isolate *iso) const -> Local<Value> {
 	auto& strings = StringTable::Get();
 	auto context = iso->GetCurrentContext();
 	auto profileObject = Object::New(iso);
@@ -66,14 +126,14 @@ auto IVMCpuProfile::BuildCpuProfile(Isolate *iso) -> Local<Value> {
 
 	const size_t count = profileNodes.size();
 	for (size_t i = 0; i < count; i++) {
-		ProfileNode node = profileNodes[i];
+		const ProfileNode& node = profileNodes[i];
 		Unmaybe(nodeArr->Set(context, i, node.ToJSObject(iso)));
 	}
 
 	return profileObject;
 }
 
-auto IVMCpuProfile::ToJSObject(Isolate *iso) -> Local<Value> {
+auto IVMCpuProfile::ToJSObject(Isolate *iso) const -> Local<Value> {
 	auto& strings = StringTable::Get();
 	auto context = iso->GetCurrentContext();
 	auto result = Object::New(iso);
@@ -91,13 +151,17 @@ IVMCpuProfile::CallFrame::CallFrame(const v8::CpuProfileNode* node):
 	line_number(node->GetLineNumber()),
 	column_number(node->GetColumnNumber()) {}
 
+auto IVMCpuProfile::CallFrame::operator==(const CallFrame& that) const -> bool {
+	return script_id == that.script_id && line_number == that.line_number && column_number == that.column_number &&
+		function_name == that.function_name && url == that.url;
+}
 
-auto IVMCpuProfile::CallFrame::ToJSObject(v8::Isolate *iso) -> Local<Value> {
+auto IVMCpuProfile::CallFrame::ToJSObject(v8::Isolate *iso) const -> Local<Value> {
 	auto& strings = StringTable::Get();
 	Local<Object> callFrame = Object::New(iso);
 	const Local<Context> context = iso->GetCurrentContext();
-	Unmaybe(callFrame->Set(context, strings.functionName, String::NewFromUtf8(iso, function_name).ToLocalChecked()));
-	Unmaybe(callFrame->Set(context, strings.url, String::NewFromUtf8(iso, url).ToLocalChecked()));
+	Unmaybe(callFrame->Set(context, strings.functionName, String::NewFromUtf8(iso, function_name.c_str()).ToLocalChecked()));
+	Unmaybe(callFrame->Set(context, strings.url, String::NewFromUtf8(iso, url.c_str()).ToLocalChecked()));
 	Unmaybe(callFrame->Set(context, strings.scriptId, Number::New(iso, script_id)));
 	Unmaybe(callFrame->Set(context, strings.lineNumber, Number::New(iso, line_number)));
 	Unmaybe(callFrame->Set(context, strings.columnNumber, Number::New(iso, column_number)));
@@ -116,7 +180,7 @@ IVMCpuProfile::ProfileNode::ProfileNode(const v8::CpuProfileNode* node):
 		}
 	}
 
-auto IVMCpuProfile::ProfileNode::ToJSObject(Isolate *iso) -> Local<Value> {
+auto IVMCpuProfile::ProfileNode::ToJSObject(Isolate *iso) const -> Local<Value> {
 	auto& strings = StringTable::Get();
 	auto context = iso->GetCurrentContext();
 
@@ -125,8 +189,8 @@ auto IVMCpuProfile::ProfileNode::ToJSObject(Isolate *iso) -> Local<Value> {
 	Unmaybe(nodeObj->Set(context, strings.hitCount, Number::New(iso, hit_count)));
 	Unmaybe(nodeObj->Set(context, strings.id, Number::New(iso, node_id)));
 
-	if (strlen(bailout_reason) > 0) {
-		Unmaybe(nodeObj->Set(context, strings.bailoutReason, String::NewFromUtf8(iso, bailout_reason).ToLocalChecked()));
+	if (!bailout_reason.empty()) {
+		Unmaybe(nodeObj->Set(context, strings.bailoutReason, String::NewFromUtf8(iso, bailout_reason.c_str()).ToLocalChecked()));
 	}
 
 	const int children_count = static_cast<int>(children.size());
@@ -143,78 +207,294 @@ auto IVMCpuProfile::ProfileNode::ToJSObject(Isolate *iso) -> Local<Value> {
 	return nodeObj;
 }
 
-CpuProfileManager::CpuProfileManager() = default;
+namespace {
+
+/**
+ * Locks the isolate on a pool thread, which applies the stops queued for that thread's session
+ */
+class StopSessionTask : public Runnable {
+	public:
+		StopSessionTask(IsolateEnvironment& env, std::shared_ptr<IsolateEnvironment> ref, std::function<void()> done) :
+			env{env}, ref{std::move(ref)}, done{std::move(done)} {}
+
+		void Run() final {
+			{
+				Executor::Lock lock{env};
+			}
+			done();
+		}
+
+	private:
+		IsolateEnvironment& env;
+		// Empty while the isolate is being torn down, in which case that thread waits for `done`
+		std::shared_ptr<IsolateEnvironment> ref;
+		std::function<void()> done;
+};
+
+} // anonymous namespace
+
+CpuProfileManager::CpuProfileManager(IsolateEnvironment& env) : env{env}, isolate{env.GetIsolate()} {}
 
 void CpuProfileManager::StartProfiling(const char* title) {
 	const std::lock_guard<std::mutex> lock(mutex);
 	std::string str(title);
 	profile_titles.insert(str);
+	profiling = true;
 }
 
-auto CpuProfileManager::StopProfiling(const char* title) -> std::vector<IVMCpuProfile> {
+auto CpuProfileManager::StopProfiling(const char* title) -> unsigned {
+	std::vector<size_t> wake;
+	unsigned id = 0;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		const std::string str_title(title);
+		id = ++last_stop_id;
+		auto& profiles = stopped_profiles[id];
+		if (profile_titles.erase(str_title) == 0) {
+			return id;
+		}
+
+		auto closed = closed_profiles.find(str_title);
+		if (closed != closed_profiles.end()) {
+			profiles = std::move(closed->second);
+			closed_profiles.erase(closed);
+		}
+
+		// This thread's session is stopped now, the others on their next lock
+		wake = QueueStop(str_title, id, lock);
+		auto current = sessions.find(std::this_thread::get_id());
+		if (current != sessions.end()) {
+			ApplyStops(current->second, current->first, lock);
+		}
+		UpdateProfiling(lock);
+	}
+	WakeSessions(wake, IsolateEnvironment::GetCurrentHolder()->GetIsolate());
+	return id;
+}
+
+auto CpuProfileManager::IsStopPending(unsigned id) -> bool {
 	const std::lock_guard<std::mutex> lock(mutex);
-	const std::string str_title(title);
+	return HasStop(id);
+}
 
-	std::vector<IVMCpuProfile> currently_collected;
+void CpuProfileManager::WaitForStop(unsigned id) {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (HasStop(id)) {
+		stopped.wait(lock);
+	}
+}
 
-	if (profile_begin_ptrs.find(str_title) == profile_begin_ptrs.end()) {
+auto CpuProfileManager::TakeProfiles(unsigned id) -> std::vector<IVMCpuProfile> {
+	const std::lock_guard<std::mutex> lock(mutex);
+	std::vector<IVMCpuProfile> currently_collected;
+	auto found = stopped_profiles.find(id);
+	if (found == stopped_profiles.end()) {
 		return currently_collected;
 	}
 
-	auto iter = profile_begin_ptrs[str_title];
+	// One profile per thread
+	std::unordered_map<std::thread::id, size_t> thread_index;
+	for (auto& profile : found->second) {
+		auto result = thread_index.emplace(profile.GetThreadId(), currently_collected.size());
+		if (result.second) {
+			currently_collected.push_back(std::move(profile));
+		} else {
+			currently_collected[result.first->second].Merge(profile);
+		}
+	}
+	stopped_profiles.erase(found);
+	return currently_collected;
+}
 
-	// Iterate using an iterator
-	for (auto it = iter; it != profile_items.end(); ++it) {
-		currently_collected.push_back(*it);
+void CpuProfileManager::Attach() {
+	if (depth++ == 0 && profiling) {
+		StartSession();
 	}
+}
 
-	// remove the titles
-	profile_titles.erase(str_title);
-	// remove the profile ptr from map
-	profile_begin_ptrs.erase(str_title);
+void CpuProfileManager::Detach() {
+	if (--depth == 0 && !thread_pool_t::is_pool_thread()) {
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (Executor::IsDefaultThread()) {
+			// Nothing can wake the default thread to apply a stop, so it records each lock separately
+			// and keeps its profiler for the next one
+			auto it = sessions.find(std::this_thread::get_id());
+			if (it != sessions.end()) {
+				StopTitles(it->second, it->first, lock);
+			}
+		} else {
+			// Threads outside the pool exit after this task, and v8 can't sample a thread which is gone
+			CloseSession(lock);
+		}
+		UpdateProfiling(lock);
+	}
+}
 
-	// TODO clean up old profiles, extract private method
-	CleanProfiles();
+auto CpuProfileManager::Suspend() -> int {
+	// The session keeps running, v8 drops its samples until this thread locks the isolate again
+	return std::exchange(depth, 0);
+}
 
-	return currently_collected;
+void CpuProfileManager::Resume(int depth) {
+	this->depth = depth;
+	if (depth > 0 && profiling) {
+		StartSession();
+	}
 }
 
-auto CpuProfileManager::IsProfiling() -> bool {
-	return !profile_titles.empty();
+void CpuProfileManager::Dispose() {
+	std::vector<size_t> wake;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& title : profile_titles) {
+			auto threads = QueueStop(title, 0, lock);
+			wake.insert(wake.end(), threads.begin(), threads.end());
+		}
+		profile_titles.clear();
+		closed_profiles.clear();
+		stopped_profiles.clear();
+	}
+	// The isolate is being torn down, so these tasks can't hold a reference to it. Instead this waits
+	// until they are done with it.
+	WakeSessions(wake, {});
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto thread = std::this_thread::get_id();
+		auto is_pending = [&]() {
+			return pending_wakes > 0 || std::any_of(sessions.begin(), sessions.end(), [&](const auto& entry) {
+				return entry.first != thread && !entry.second.stops.empty();
+			});
+		};
+		while (is_pending()) {
+			stopped.wait(lock);
+		}
+	}
+
+	// Only this thread's session can still be running, locking the isolate applies its stops
+	Executor::Lock executor_lock{env};
+	const std::lock_guard<std::mutex> lock(mutex);
+	auto current = sessions.find(std::this_thread::get_id());
+	if (current != sessions.end()) {
+		ApplyStops(current->second, current->first, lock);
+	}
+	UpdateProfiling(lock);
 }
 
-auto CpuProfileManager::InjestCpuProfile(const std::shared_ptr<v8::CpuProfile>& cpuProfile) -> void {
+void CpuProfileManager::StartSession() {
+	// Applies the stops which other threads queued for this one, then starts any titles it isn't yet
+	// recording. The first lock after a title starts pays for the code map walk, after that locks on
+	// the same pool thread don't touch the profiler.
 	const std::lock_guard<std::mutex> lock(mutex);
-	profile_items.emplace_back(cpuProfile);
+	auto thread = std::this_thread::get_id();
+	auto it = sessions.find(thread);
+	if (it != sessions.end() && !it->second.stops.empty()) {
+		ApplyStops(it->second, thread, lock);
+	}
+	if (!profile_titles.empty() && (it == sessions.end() || it->second.titles.size() != profile_titles.size())) {
+		auto& session = sessions[thread];
+		if (session.profiler == nullptr) {
+			session.profiler = v8::CpuProfiler::New(isolate, v8::kDebugNaming, v8::kEagerLogging);
+			session.pool_thread = thread_pool_t::is_pool_thread();
+			session.pool_index = thread_pool_t::current_thread();
+		}
+		for (const auto& title : profile_titles) {
+			if (session.titles.insert(title).second) {
+				session.profiler->StartProfiling(v8_string(title.c_str()), true);
+			}
+		}
+	}
+	UpdateProfiling(lock);
+}
 
-	for(const std::string &title : profile_titles) {
-		if (profile_begin_ptrs.find(title) == profile_begin_ptrs.end()) {
-			profile_begin_ptrs[title] = std::prev(profile_items.end());
+void CpuProfileManager::ApplyStops(Session& session, std::thread::id thread, const std::lock_guard<std::mutex>& /*lock*/) {
+	for (const auto& stop : session.stops) {
+		v8::CpuProfile* profile = session.profiler->StopProfiling(v8_string(stop.first.c_str()));
+		if (profile != nullptr) {
+			// Stops from `Dispose` have nowhere to go
+			if (stop.second != 0) {
+				stopped_profiles[stop.second].emplace_back(profile, thread);
+			}
+			profile->Delete();
 		}
 	}
+	session.stops.clear();
+	stopped.notify_all();
 }
 
-void CpuProfileManager::CleanProfiles() {
-	if (profile_titles.empty()) {
-		profile_items.clear();
-		profile_begin_ptrs.clear();
+void CpuProfileManager::StopTitles(Session& session, std::thread::id thread, const std::lock_guard<std::mutex>& lock) {
+	ApplyStops(session, thread, lock);
+	for (const auto& title : session.titles) {
+		v8::CpuProfile* profile = session.profiler->StopProfiling(v8_string(title.c_str()));
+		if (profile != nullptr) {
+			closed_profiles[title].emplace_back(profile, thread);
+			profile->Delete();
+		}
 	}
+	session.titles.clear();
+}
 
-	int64_t min_start_time = INT_MAX;
+void CpuProfileManager::CloseSession(const std::lock_guard<std::mutex>& lock) {
+	auto it = sessions.find(std::this_thread::get_id());
+	if (it == sessions.end()) {
+		return;
+	}
+	StopTitles(it->second, it->first, lock);
+	it->second.profiler->Dispose();
+	sessions.erase(it);
+}
 
-	for (const auto& profile_item: profile_begin_ptrs) {
-		if (profile_item.second->GetStartTime() < min_start_time) {
-			min_start_time = profile_item.second->GetStartTime();
+auto CpuProfileManager::QueueStop(const std::string& title, unsigned id, const std::lock_guard<std::mutex>& /*lock*/) -> std::vector<size_t> {
+	std::vector<size_t> wake;
+	auto thread = std::this_thread::get_id();
+	for (auto& entry : sessions) {
+		auto& session = entry.second;
+		if (session.titles.erase(title) != 0) {
+			session.stops.emplace_back(title, id);
+			// Other threads are either in the pool and idle, or they will lock the isolate again when
+			// they resume
+			if (session.pool_thread && entry.first != thread) {
+				wake.push_back(session.pool_index);
+			}
 		}
 	}
+	return wake;
+}
 
-	for (auto it = profile_items.begin(); it != profile_items.end(); ) {
-		if (it->GetStartTime() < min_start_time) {
-			it = profile_items.erase(it);
-		} else {
-			++it;
+auto CpuProfileManager::HasStop(unsigned id) const -> bool {
+	return std::any_of(sessions.begin(), sessions.end(), [&](const auto& entry) {
+		const auto& stops = entry.second.stops;
+		return std::any_of(stops.begin(), stops.end(), [&](const auto& stop) { return stop.second == id; });
+	});
+}
+
+void CpuProfileManager::WakeSessions(const std::vector<size_t>& threads, const std::shared_ptr<IsolateEnvironment>& ref) {
+	for (auto thread : threads) {
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			++pending_wakes;
 		}
+		LockedScheduler::ExecuteOnPoolThread(thread, std::make_unique<StopSessionTask>(env, ref, [this]() {
+			const std::lock_guard<std::mutex> lock(mutex);
+			--pending_wakes;
+			stopped.notify_all();
+		}));
 	}
 }
 
-}
\ No newline at end of file
+void CpuProfileManager::UpdateProfiling(const std::lock_guard<std::mutex>& /*lock*/) {
+	if (profile_titles.empty()) {
+		// Nothing is recording in these, so they can be disposed from any thread
+		for (auto it = sessions.begin(); it != sessions.end(); ) {
+			if (it->second.titles.empty() && it->second.stops.empty()) {
+				it->second.profiler->Dispose();
+				it = sessions.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+	// Locks still have to attach while there are stops to apply
+	profiling = !profile_titles.empty() || !sessions.empty();
+}
+
+}
@@ -4,54 +4,64 @@
 #include <thread>
 #include <v8.h>
 
-#include "executor.h"
 #include "v8-profiler.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include <utility>
 #include <vector>
-#include <list>
 
 namespace ivm {
+class IsolateEnvironment;
 
 class IVMCpuProfile {
 	public:
-		explicit IVMCpuProfile(const std::shared_ptr<v8::CpuProfile>& cpuProfile);
+		IVMCpuProfile(const v8::CpuProfile* cpuProfile, std::thread::id thread);
 		~IVMCpuProfile() = default;
 
 		class CallFrame {
+			friend class IVMCpuProfile;
 			public:
 				explicit CallFrame(const v8::CpuProfileNode* node);
 				~CallFrame() = default;
 
-				auto ToJSObject(v8::Isolate *iso) -> v8::Local<v8::Value>;
+				auto operator==(const CallFrame& that) const -> bool;
+				auto ToJSObject(v8::Isolate *iso) const -> v8::Local<v8::Value>;
 			private:
-				const char* function_name;
-				const char* url;
+				std::string function_name;
+				std::string url;
 				int script_id;
 				int line_number;
 				int column_number;
 		};
 
 		class ProfileNode {
+			friend class IVMCpuProfile;
 			public:
 				explicit ProfileNode(const v8::CpuProfileNode* node);
 				~ProfileNode() = default;
 
-				auto ToJSObject(v8::Isolate *iso) -> v8::Local<v8::Value>;
+				auto ToJSObject(v8::Isolate *iso) const -> v8::Local<v8::Value>;
 			private:
 				unsigned int hit_count;
 				unsigned int node_id;
-				const char* bailout_reason;
+				std::string bailout_reason;
 				std::vector<unsigned int> children;
 				CallFrame call_frame;
 		};
 
 		auto GetStartTime() const -> int64_t { return start_time; }
+		auto GetThreadId() const -> std::thread::id { return profile_thread; }
 
-		auto ToJSObject(v8::Isolate *iso) -> v8::Local<v8::Value>;
+		// Folds a later profile from the same thread into this one, combining identical call paths
+		void Merge(const IVMCpuProfile& that);
+
+		auto ToJSObject(v8::Isolate *iso) const -> v8::Local<v8::Value>;
 
 
 	private:
@@ -61,11 +71,12 @@ class IVMCpuProfile {
 		int64_t samples_count;
 		std::vector<unsigned int> samples;
 		std::vector<int64_t> timestamps;
+		// Stored in pre-order with `node_id == index + 1`, so the root is always the first node
 		std::vector<ProfileNode> profileNodes;
 
-		auto GetTidValue(v8::Isolate *iso) -> v8::Local<v8::Value>;
+		auto GetTidValue(v8::Isolate *iso) const -> v8::Local<v8::Value>;
 
-		auto BuildCpuProfile(v8::Isolate *iso) -> v8::Local<v8::Value>;
+		auto BuildCpuProfile(v8::Isolate *iso) const -> v8::Local<v8::Value>;
 
 		void FlatNodes(const v8::CpuProfileNode* node, std::vector<ProfileNode>* nodes) { // NOLINT(misc-no-recursion)
 			nodes->emplace_back(node);
@@ -78,23 +89,76 @@ class IVMCpuProfile {
 
 };
 
+/**
+ * Owns one `v8::CpuProfiler` per thread which has locked the isolate while any `startCpuProfiler`
+ * title is active. v8 only samples the thread which started profiling, so each thread gets its own
+ * session. Sessions on pool threads keep running between locks, and v8 drops the samples taken while
+ * another thread holds the isolate. Other threads record each of their locks separately.
+ *
+ * A session is only ever stopped by the thread it samples. A stop from any other thread could leave
+ * a SIGPROF pending for the sampled thread, which kills the process if v8 has put back the default
+ * handler by the time it arrives. Instead the stop is queued and applied on that thread's next lock,
+ * and idle pool threads are handed a task which locks the isolate.
+ */
 class CpuProfileManager {
 	public:
-		CpuProfileManager();
+		explicit CpuProfileManager(IsolateEnvironment& env);
 		void StartProfiling(const char* title);
-		auto StopProfiling(const char* title) -> std::vector<IVMCpuProfile>;
-		auto IsProfiling() -> bool;
-		auto InjestCpuProfile(const std::shared_ptr<v8::CpuProfile>& cpuProfile) -> void;
+		// Must be called with the isolate locked. Stops `title` on this thread and queues the stop on
+		// the others, the result is an id for `WaitForStop` and `TakeProfiles`.
+		auto StopProfiling(const char* title) -> unsigned;
+		auto IsStopPending(unsigned id) -> bool;
+		// Must be called with the isolate unlocked, returns once every thread has stopped `id`
+		void WaitForStop(unsigned id);
+		auto TakeProfiles(unsigned id) -> std::vector<IVMCpuProfile>;
+		auto IsProfiling() const -> bool { return profiling; }
+
+		// Executor lock boundaries, these must be called with the isolate locked
+		void Attach();
+		void Detach();
+		auto Suspend() -> int;
+		void Resume(int depth);
+		// Must be called with the isolate unlocked
+		void Dispose();
 
 		CpuProfileManager(const CpuProfileManager&) = delete;
 		auto operator= (const CpuProfileManager) = delete;
 		~CpuProfileManager() = default;
 	private:
-		void CleanProfiles();
+		struct Session {
+			v8::CpuProfiler* profiler = nullptr;
+			std::set<std::string> titles;
+			// Titles which other threads have stopped, and the id of each stop
+			std::vector<std::pair<std::string, unsigned>> stops;
+			bool pool_thread = false;
+			size_t pool_index = 0;
+		};
+
+		void StartSession();
+		void ApplyStops(Session& session, std::thread::id thread, const std::lock_guard<std::mutex>& lock);
+		void StopTitles(Session& session, std::thread::id thread, const std::lock_guard<std::mutex>& lock);
+		void CloseSession(const std::lock_guard<std::mutex>& lock);
+		auto QueueStop(const std::string& title, unsigned id, const std::lock_guard<std::mutex>& lock) -> std::vector<size_t>;
+		// `mutex` must be held
+		auto HasStop(unsigned id) const -> bool;
+		void WakeSessions(const std::vector<size_t>& threads, const std::shared_ptr<IsolateEnvironment>& ref);
+		void UpdateProfiling(const std::lock_guard<std::mutex>& lock);
+
+		IsolateEnvironment& env;
+		v8::Isolate* isolate;
+		int depth = 0;
+		std::atomic<bool> profiling{false};
 
 		std::set<std::string> profile_titles{};
-		std::list<IVMCpuProfile> profile_items{};
-		std::unordered_map<std::string, std::list<IVMCpuProfile>::iterator> profile_begin_ptrs{};
+		std::unordered_map<std::thread::id, Session> sessions{};
+		// Profiles from sessions which have already stopped, waiting for their title to be stopped
+		std::unordered_map<std::string, std::vector<IVMCpuProfile>> closed_profiles{};
+		// Profiles for each `StopProfiling` call, waiting to be taken
+		std::unordered_map<unsigned, std::vector<IVMCpuProfile>> stopped_profiles{};
+		unsigned last_stop_id = 0;
+		// Tasks from `WakeSessions` which haven't yet released the isolate
+		size_t pending_wakes = 0;
 		std::mutex mutex;
+		std::condition_variable stopped;
 };
 }
\ No newline at end of file
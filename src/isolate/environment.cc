@@ -7,7 +7,9 @@
 #include "runnable.h"
 #include "external_copy/external_copy.h"
 #include "scheduler.h"
+#include "three_phase_task.h"
 #include "lib/suspend.h"
+#include "lib/timer.h"
 #include <algorithm>
 #include <chrono>
 #include <climits>
@@ -203,7 +205,7 @@ void IsolateEnvironment::MarkSweepCompactEpilogue(Isolate* isolate, GCType /*gc_
 			isolate->AddNearHeapLimitCallback(NearHeapLimitCallback, data);
 			HeapStatistics heap;
 			that->isolate->GetHeapStatistics(&heap);
-			if (heap.heap_size_limit() == that->initial_heap_size_limit) {
+			if (heap.heap_size_limit() == that->GetHeapSizeLimit()) {
 				that->did_adjust_heap_limit = false;
 			}
 		}
@@ -260,8 +262,85 @@ void IsolateEnvironment::CheckMemoryPressure() {
 	}
 }
 
+void IsolateEnvironment::ApplyMemoryLimit() {
+	// Restoring the heap limit resets v8's old generation limit to `memory_limit`, or the live heap
+	// size if that's larger. v8 won't raise the limit this way but `NearHeapLimitCallback` takes care
+	// of that when it's needed.
+	isolate->RemoveNearHeapLimitCallback(NearHeapLimitCallback, memory_limit);
+	isolate->AddNearHeapLimitCallback(NearHeapLimitCallback, static_cast<void*>(this));
+	did_adjust_heap_limit = true;
+	// Check the new limit as if a full GC just finished. If the isolate is over the new limit this
+	// forces a full GC, and terminates the isolate if that wasn't enough.
+	MarkSweepCompactEpilogue(isolate, GCType::kGCTypeMarkSweepCompact, GCCallbackFlags::kNoGCCallbackFlags, static_cast<void*>(this));
+}
+
+void IsolateEnvironment::SetMemoryLimit(size_t memory_limit_in_mb) {
+	memory_limit = memory_limit_in_mb * 1024 * 1024;
+	if (Executor::GetCurrentEnvironment() == this) {
+		ApplyMemoryLimit();
+		return;
+	}
+	auto holder = this->holder.lock();
+	auto ptr = holder ? holder->GetIsolate() : nullptr;
+	if (!ptr) {
+		return;
+	}
+	// Same strategy as the inspector: wake the isolate if it's idle, or interrupt it if it's busy
+	struct ApplyMemoryLimitTask : public Runnable {
+		void Run() final {
+			IsolateEnvironment::GetCurrent().ApplyMemoryLimit();
+		}
+	};
+	auto lock = scheduler->Lock();
+	lock->interrupts.push(std::make_unique<ApplyMemoryLimitTask>());
+	if (!lock->WakeIsolate(std::move(ptr))) {
+		lock->InterruptIsolate();
+	}
+}
+
+void IsolateEnvironment::SetCpuQuota(std::chrono::nanoseconds quota, std::chrono::nanoseconds window, std::chrono::nanoseconds budget) {
+	scheduler->Lock()->SetCpuQuota(quota, window);
+	has_cpu_quota = quota != std::chrono::nanoseconds{};
+	cpu_budget = budget;
+}
+
+void IsolateEnvironment::ArmCpuBudgetTimer() {
+	if (cpu_budget == std::chrono::nanoseconds{} || cpu_budget_timer_armed.exchange(true)) {
+		return;
+	}
+	// CPU time can't advance faster than wall time so this won't fire early, it's checked again in
+	// case the isolate was waiting on something.
+	auto remaining = std::max(cpu_budget - GetCpuTime(), std::chrono::nanoseconds{});
+	auto remaining_ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+	timer_t::wait_detached(static_cast<uint32_t>(remaining_ms), [holder = this->holder](void* next) {
+		auto ref = holder.lock();
+		auto env = ref ? ref->GetIsolate() : nullptr;
+		if (env) {
+			env->CheckCpuBudget();
+		}
+		timer_t::chain(next);
+	});
+}
+
+void IsolateEnvironment::CheckCpuBudget() {
+	if (GetCpuTime() >= cpu_budget) {
+		if (!terminated) {
+			hit_cpu_limit = true;
+			Terminate();
+		}
+		return;
+	}
+	cpu_budget_timer_armed = false;
+	// `ArmCpuBudgetTimer` may have been skipped by an isolate which started running while the flag
+	// was still set
+	if (executor.wall_timer.load() != nullptr) {
+		ArmCpuBudgetTimer();
+	}
+}
+
 void IsolateEnvironment::AsyncEntry() {
 	Executor::Lock lock(*this);
+	ArmCpuBudgetTimer();
 	if (!nodejs_isolate) {
 		// Set v8 stack limit on non-default isolate. This is only needed on non-default threads while
 		// on OS X because it allocates just 512kb for each pthread stack, instead of 2mb on other
@@ -290,6 +369,9 @@ void IsolateEnvironment::AsyncEntry() {
 			}
 		}
 
+		// Completions handed back to node from this group of tasks share one callback scope
+		ThreePhaseTask::CompletionBatch completion_batch{*this};
+
 		// Execute interrupt tasks
 		while (!interrupts.empty()) {
 			interrupts.front()->Run();
@@ -310,10 +392,38 @@ void IsolateEnvironment::AsyncEntry() {
 				return;
 			}
 			CheckMemoryPressure();
+			if (has_cpu_quota && YieldToCpuQuota(tasks)) {
+				return;
+			}
 		}
 	}
 }
 
+auto IsolateEnvironment::YieldToCpuQuota(std::queue<std::unique_ptr<Runnable>>& tasks) -> bool {
+	auto lock = scheduler->Lock();
+	if (tasks.empty() && lock->tasks.empty() && lock->handle_tasks.empty() && lock->interrupts.empty()) {
+		return false;
+	}
+	if (lock->CpuQuotaDelay() == std::chrono::nanoseconds{}) {
+		return false;
+	}
+	auto ref = holder.lock();
+	auto ptr = ref ? ref->GetIsolate() : nullptr;
+	if (!ptr) {
+		return false;
+	}
+	// Put the rest of this batch back in front of anything which was queued since, and let the
+	// scheduler wake this isolate again once its quota has drained
+	while (!lock->tasks.empty()) {
+		tasks.push(std::move(lock->tasks.front()));
+		lock->tasks.pop();
+	}
+	lock->tasks = std::move(tasks);
+	lock->DoneRunning();
+	lock->WakeIsolate(std::move(ptr));
+	return true;
+}
+
 template <std::queue<std::unique_ptr<Runnable>> Scheduler::*Tasks>
 void IsolateEnvironment::InterruptEntryImplementation() {
 	// Executor::Lock is already acquired
@@ -355,9 +465,9 @@ void IsolateEnvironment::IsolateCtor(Isolate* isolate, Local<Context> context) {
 	default_context.Reset(isolate, context);
 }
 
-void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length) {
+void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length, bool pooled_array_buffers) {
 	memory_limit = memory_limit_in_mb * 1024 * 1024;
-	allocator_ptr = std::make_shared<LimitedAllocator>(*this, memory_limit);
+	allocator_ptr = std::make_shared<LimitedAllocator>(*this, pooled_array_buffers);
 	snapshot_blob_ptr = std::move(snapshot_blob);
 
 	// Calculate resource constraints
@@ -393,6 +503,7 @@ void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<v8::B
 	// Add GC callbacks
 	isolate->AddGCEpilogueCallback(MarkSweepCompactEpilogue, static_cast<void*>(this), GCType::kGCTypeMarkSweepCompact);
 	isolate->AddNearHeapLimitCallback(NearHeapLimitCallback, static_cast<void*>(this));
+	isolate->AddGCEpilogueCallback(LimitedAllocator::GCEpilogue, static_cast<void*>(GetLimitedAllocator()), GCType::kGCTypeAll);
 
 	// Heap statistics crushes down lots of different memory spaces into a single number. We note the
 	// difference between the requested old space and v8's calculated heap size.
@@ -406,6 +517,14 @@ void IsolateEnvironment::IsolateCtor(size_t memory_limit_in_mb, shared_ptr<v8::B
 		Locker locker(isolate);
 		HandleScope handle_scope(isolate);
 		default_context.Reset(isolate, NewContext());
+
+		// Snapshots store the name of each extra context as isolate data at the context's index
+		if (snapshot_blob_ptr) {
+			Local<String> name;
+			for (size_t ii = 0; isolate->GetDataFromSnapshotOnce<String>(ii).ToLocal(&name); ++ii) {
+				snapshot_contexts.emplace(*String::Utf8Value{isolate, name}, ii);
+			}
+		}
 	}
 
 	// There is no asynchronous Isolate ctor so we should throw away thread specifics in case
@@ -436,6 +555,11 @@ IsolateEnvironment::~IsolateEnvironment() {
 				auto lock = scheduler->Lock();
 				return std::move(inspector_agent);
 			}();
+			// The profiler must be torn down before the isolate. Its sessions are stopped by the threads
+			// they sample, which need to lock the isolate.
+			if (cpu_profile_manager) {
+				cpu_profile_manager->Dispose();
+			}
 			// Now activate executor lock and invoke inspector agent's dtor
 			Executor::Lock lock{*this};
 			agent_ptr.reset();
@@ -488,11 +612,23 @@ auto IsolateEnvironment::NewContext() -> Local<Context> {
 	return context;
 }
 
+auto IsolateEnvironment::NewContext(const std::string& snapshot_context) -> MaybeLocal<Context> {
+	auto ii = snapshot_contexts.find(snapshot_context);
+	if (ii == snapshot_contexts.end()) {
+		return {};
+	}
+	auto context = Unmaybe(Context::FromSnapshot(isolate, ii->second, &DeserializeInternalFieldsCallback));
+	context->AllowCodeGenerationFromStrings(false);
+	return context;
+}
+
 auto IsolateEnvironment::TaskEpilogue() -> std::unique_ptr<ExternalCopy> {
 	isolate->PerformMicrotaskCheckpoint();
 	CheckMemoryPressure();
 	if (hit_memory_limit) {
 		throw FatalRuntimeError("Isolate was disposed during execution due to memory limit");
+	} else if (hit_cpu_limit) {
+		throw FatalRuntimeError("Isolate was disposed during execution due to CPU limit");
 	}
 	auto rejected_promises = std::exchange(unhandled_promise_rejections, {});
 	for (auto& handle : rejected_promises) {
@@ -522,27 +658,17 @@ auto IsolateEnvironment::GetInspectorAgent() const -> InspectorAgent* {
 
 auto IsolateEnvironment::GetCpuProfileManager() -> CpuProfileManager* {
 	if (!cpu_profile_manager) {
-		cpu_profile_manager = std::make_shared<CpuProfileManager>();
+		cpu_profile_manager = std::make_shared<CpuProfileManager>(*this);
 	}
 	return cpu_profile_manager.get();
 }
 
 auto IsolateEnvironment::GetCpuTime() -> std::chrono::nanoseconds {
-	std::lock_guard<std::mutex> lock(executor.timer_mutex);
-	std::chrono::nanoseconds time = executor.cpu_time;
-	if (executor.cpu_timer != nullptr) {
-		time += executor.cpu_timer->Delta(lock);
-	}
-	return time;
+	return executor.cpu_time.Read();
 }
 
 auto IsolateEnvironment::GetWallTime() -> std::chrono::nanoseconds {
-	std::lock_guard<std::mutex> lock(executor.timer_mutex);
-	std::chrono::nanoseconds time = executor.wall_time;
-	if (executor.wall_timer != nullptr) {
-		time += executor.wall_timer->Delta(lock);
-	}
-	return time;
+	return executor.wall_time.Read();
 }
 
 void IsolateEnvironment::Terminate() {
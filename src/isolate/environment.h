@@ -50,7 +50,7 @@ class IsolateEnvironment {
 	template <class>
 	friend class IsolateSpecific;
 	template <typename F>
-	friend auto RunWithTimeout(uint32_t timeout_ms, F&& fn) -> v8::Local<v8::Value>;
+	friend auto RunWithTimeout(uint32_t timeout_ms, uint32_t cpu_timeout_ms, F&& fn) -> v8::Local<v8::Value>;
 
 	public:
 		/**
@@ -95,14 +95,19 @@ class IsolateEnvironment {
 		std::shared_ptr<v8::ArrayBuffer::Allocator> allocator_ptr;
 		std::shared_ptr<v8::BackingStore> snapshot_blob_ptr;
 		v8::StartupData startup_data{};
+		std::unordered_map<std::string, size_t> snapshot_contexts;
 		void* timer_holder = nullptr;
-		size_t memory_limit = 0;
+		std::atomic<size_t> memory_limit = 0;
 		size_t initial_heap_size_limit = 0;
 		size_t misc_memory_size = 0;
 		std::atomic<size_t> extra_allocated_memory = 0;
 		v8::MemoryPressureLevel memory_pressure = v8::MemoryPressureLevel::kNone;
 		v8::MemoryPressureLevel last_memory_pressure = v8::MemoryPressureLevel::kNone;
 		bool hit_memory_limit = false;
+		std::atomic<bool> hit_cpu_limit{false};
+		std::atomic<bool> cpu_budget_timer_armed{false};
+		bool has_cpu_quota = false;
+		std::chrono::nanoseconds cpu_budget{};
 		bool did_adjust_heap_limit = false;
 		bool nodejs_isolate = false;
 		std::atomic<unsigned int> remotes_count{0};
@@ -119,7 +124,10 @@ class IsolateEnvironment {
 
 	public:
 		RemoteHandle<v8::Function> error_handler;
+		// Compiled code is cached here across processes if set
+		std::string code_cache_directory;
 		std::unordered_multimap<int, struct ModuleInfo*> module_handles;
+		std::vector<std::weak_ptr<class ModuleRegistry>> module_registries;
 		std::unordered_map<class NativeModule*, std::shared_ptr<NativeModule>> native_modules;
 		int terminate_depth = 0;
 		std::atomic<bool> terminated { false };
@@ -157,6 +165,26 @@ class IsolateEnvironment {
 		static void MemoryPressureInterrupt(v8::Isolate* isolate, void* data);
 		void CheckMemoryPressure();
 
+		/**
+		 * Brings v8's heap limit and memory pressure in line with `memory_limit` after it changes. Must
+		 * be run on the isolate's thread.
+		 */
+		void ApplyMemoryLimit();
+
+		/**
+		 * Starts a watchdog which disposes this isolate once it uses up `cpu_budget`. The watchdog
+		 * keeps itself alive while the isolate is running, so this is called whenever user code is
+		 * about to run.
+		 */
+		void ArmCpuBudgetTimer();
+		void CheckCpuBudget();
+
+		/**
+		 * Called between tasks in `AsyncEntry`. If this isolate is over its CPU quota the remaining
+		 * tasks are handed back to the scheduler, and this returns true.
+		 */
+		auto YieldToCpuQuota(std::queue<std::unique_ptr<Runnable>>& tasks) -> bool;
+
 		/**
 		 * Wrap an existing Isolate. This should only be called for the main node Isolate.
 		 */
@@ -165,7 +193,7 @@ class IsolateEnvironment {
 		/**
 		 * Create a new wrapped Isolate.
 		 */
-		void IsolateCtor(size_t memory_limit_in_mb, std::shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length);
+		void IsolateCtor(size_t memory_limit_in_mb, std::shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length, bool pooled_array_buffers);
 
 	public:
 		/**
@@ -188,11 +216,11 @@ class IsolateEnvironment {
 			return holder;
 		}
 
-		static auto New(size_t memory_limit_in_mb, std::shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length) -> std::shared_ptr<IsolateHolder> {
+		static auto New(size_t memory_limit_in_mb, std::shared_ptr<v8::BackingStore> snapshot_blob, size_t snapshot_length, bool pooled_array_buffers = false) -> std::shared_ptr<IsolateHolder> {
 			auto env = std::make_shared<IsolateEnvironment>(static_cast<UvScheduler&>(*Executor::GetDefaultEnvironment().scheduler));
 			auto holder = std::make_shared<IsolateHolder>(env);
 			env->holder = holder;
-			env->IsolateCtor(memory_limit_in_mb, std::move(snapshot_blob), snapshot_length);
+			env->IsolateCtor(memory_limit_in_mb, std::move(snapshot_blob), snapshot_length, pooled_array_buffers);
 			return holder;
 		}
 
@@ -248,6 +276,12 @@ class IsolateEnvironment {
 		 */
 		auto NewContext() -> v8::Local<v8::Context>;
 
+		/**
+		 * Creates a new context from one of the named contexts in this isolate's snapshot. Returns an
+		 * empty handle if the snapshot has no context by that name.
+		 */
+		auto NewContext(const std::string& snapshot_context) -> v8::MaybeLocal<v8::Context>;
+
 		/**
 		 * Called by Scheduler when there is work to be done in this isolate.
 		 */
@@ -271,12 +305,25 @@ class IsolateEnvironment {
 		auto GetLimitedAllocator() const -> class LimitedAllocator*;
 
 		/**
-		 * Get the initial v8 heap_size_limit when the isolate was created.
+		 * Get the v8 heap_size_limit which corresponds to the current memory limit.
 		 */
-		auto GetInitialHeapSizeLimit() const -> size_t {
-			return initial_heap_size_limit;
+		auto GetHeapSizeLimit() const -> size_t {
+			return memory_limit + misc_memory_size;
 		}
 
+		/**
+		 * Changes the memory limit of a running isolate. This can be called from any thread, the new
+		 * limit is applied to v8's heap the next time the isolate runs or is interrupted.
+		 */
+		void SetMemoryLimit(size_t memory_limit_in_mb);
+
+		/**
+		 * Sets the `cpuQuota` isolate options. Async work is delayed while the isolate is over
+		 * `quota` per `window`, and the isolate is disposed once it has used `budget` in total. 0
+		 * disables either limit.
+		 */
+		void SetCpuQuota(std::chrono::nanoseconds quota, std::chrono::nanoseconds window, std::chrono::nanoseconds budget);
+
 		/**
 		 * Enables the inspector for this isolate.
 		 */
@@ -301,6 +348,13 @@ class IsolateEnvironment {
 			return hit_memory_limit;
 		}
 
+		/**
+		 * Check CPU budget flag
+		 */
+		auto DidHitCpuLimit() const -> bool {
+			return hit_cpu_limit;
+		}
+
 		/**
 		 * Not to be confused with v8's `ExternalAllocatedMemory`. This counts up how much memory this
 		 * isolate is holding onto outside of v8's heap, even if that memory is shared amongst other
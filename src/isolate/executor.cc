@@ -7,6 +7,10 @@
 #include <cstddef>
 #include <cstdio>
 
+#if USE_CLOCK_THREAD_CPUTIME_ID
+#include <pthread.h>
+#endif
+
 namespace ivm {
 
 /**
@@ -42,53 +46,114 @@ thread_local Executor* Executor::current_executor = nullptr;
 thread_local Executor::CpuTimer* Executor::cpu_timer_thread = nullptr;
 
 /**
- * CpuTimer implementation
+ * TimeCounter implementation
  */
-Executor::CpuTimer::CpuTimer(Executor& executor) :
-		executor{executor}, last{cpu_timer_thread}, time{Now()}
+void Executor::TimeCounter::Start(std::chrono::nanoseconds now, ClockId clock) {
+	Write(total.load(std::memory_order_relaxed), now.count(), clock, true);
+}
+
+void Executor::TimeCounter::Stop(std::chrono::nanoseconds elapsed) {
+	Write(total.load(std::memory_order_relaxed) + elapsed.count(), 0, {}, false);
+}
+
+auto Executor::TimeCounter::Read() const -> std::chrono::nanoseconds {
+	uint32_t begin;
+	std::chrono::nanoseconds time;
+	do {
+		begin = sequence.load(std::memory_order_acquire);
+		time = std::chrono::nanoseconds{total.load(std::memory_order_relaxed)};
+		if (running.load(std::memory_order_relaxed)) {
+			// The clock may belong to a thread which has since moved on, in which case the sequence will
+			// have changed as well and this is thrown away
+			time += Now(clock.load(std::memory_order_relaxed)) - std::chrono::nanoseconds{started.load(std::memory_order_relaxed)};
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((begin & 1) != 0 || begin != sequence.load(std::memory_order_relaxed));
+	return time;
+}
+
+void Executor::TimeCounter::Write(int64_t total_value, int64_t started_value, ClockId clock_value, bool running_value) {
+	// There is only one writer so the sequence doesn't need a read-modify-write
+	const uint32_t begin = sequence.load(std::memory_order_relaxed);
+	sequence.store(begin + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	total.store(total_value, std::memory_order_relaxed);
+	started.store(started_value, std::memory_order_relaxed);
+	clock.store(clock_value, std::memory_order_relaxed);
+	running.store(running_value, std::memory_order_relaxed);
+	sequence.store(begin + 2, std::memory_order_release);
+}
+
 #if USE_CLOCK_THREAD_CPUTIME_ID
-		, steady_time{std::chrono::steady_clock::now()}
+auto Executor::TimeCounter::Now(ClockId clock) -> std::chrono::nanoseconds {
+	timespec ts{};
+	if (clock_gettime(clock, &ts) != 0) {
+		return {};
+	}
+	return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+auto Executor::TimeCounter::SteadyClock() -> ClockId {
+	return CLOCK_MONOTONIC;
+}
+#else
+auto Executor::TimeCounter::Now(ClockId /*clock*/) -> std::chrono::nanoseconds {
+	return std::chrono::steady_clock::now().time_since_epoch();
+}
+
+auto Executor::TimeCounter::SteadyClock() -> ClockId {
+	return 0;
+}
 #endif
-{
+
+/**
+ * CpuTimer implementation
+ */
+Executor::CpuTimer::CpuTimer(Executor& executor) : executor{executor}, last{cpu_timer_thread} {
 	cpu_timer_thread = this;
-	std::lock_guard<std::mutex> lock{executor.timer_mutex};
-	assert(executor.cpu_timer == nullptr);
-	executor.cpu_timer = this;
+	Start();
 }
 
 Executor::CpuTimer::~CpuTimer() {
 	cpu_timer_thread = last;
-	std::lock_guard<std::mutex> lock{executor.timer_mutex};
-	executor.cpu_time += Now() - time;
+	executor.cpu_time.Stop(Now() - time);
 	assert(executor.cpu_timer == this);
 	executor.cpu_timer = nullptr;
 }
 
-auto Executor::CpuTimer::Delta(const std::lock_guard<std::mutex>& /*lock*/) const -> std::chrono::nanoseconds {
-#if USE_CLOCK_THREAD_CPUTIME_ID
-	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - steady_time);
-#else
-	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now() - time);
-#endif
-}
-
 void Executor::CpuTimer::Pause() {
-	std::lock_guard<std::mutex> lock{executor.timer_mutex};
-	executor.cpu_time += Now() - time;
+	executor.cpu_time.Stop(Now() - time);
 	assert(executor.cpu_timer == this);
 	executor.cpu_timer = nullptr;
-	timer_t::pause(executor.env.timer_holder);
+	// `timer_holder` only changes under the isolate lock, which is held here. Without an armed
+	// timeout there's nothing to pause, so skip the global timer mutex.
+	if (executor.env.timer_holder != nullptr) {
+		timer_t::pause(executor.env.timer_holder);
+	}
 }
 
 void Executor::CpuTimer::Resume() {
-	std::lock_guard<std::mutex> lock{executor.timer_mutex};
+	Start();
+	if (executor.env.timer_holder != nullptr) {
+		timer_t::resume(executor.env.timer_holder);
+	}
+}
+
+void Executor::CpuTimer::Start() {
 	time = Now();
+	// Readers on other threads measure the period in progress against this thread's CPU clock
 #if USE_CLOCK_THREAD_CPUTIME_ID
-	steady_time = std::chrono::steady_clock::now();
+	thread_local const clockid_t thread_clock = []() {
+		clockid_t clock = CLOCK_THREAD_CPUTIME_ID;
+		pthread_getcpuclockid(pthread_self(), &clock);
+		return clock;
+	}();
+	executor.cpu_time.Start(time.time_since_epoch(), thread_clock);
+#else
+	executor.cpu_time.Start(time.time_since_epoch(), TimeCounter::SteadyClock());
 #endif
 	assert(executor.cpu_timer == nullptr);
 	executor.cpu_timer = this;
-	timer_t::resume(executor.env.timer_holder);
 }
 
 #if USE_CLOCK_THREAD_CPUTIME_ID
@@ -115,10 +180,10 @@ Executor::WallTimer::WallTimer(Executor& executor) :
 		cpu_timer->Pause();
 	}
 	// Maybe start wall timer
-	if (executor.wall_timer == nullptr) {
-		std::lock_guard<std::mutex> lock{executor.timer_mutex};
-		executor.wall_timer = this;
+	WallTimer* expected = nullptr;
+	if (executor.wall_timer.compare_exchange_strong(expected, this, std::memory_order_acquire, std::memory_order_relaxed)) {
 		time = std::chrono::steady_clock::now();
+		executor.wall_time.Start(time.time_since_epoch(), TimeCounter::SteadyClock());
 	}
 }
 
@@ -128,17 +193,12 @@ Executor::WallTimer::~WallTimer() {
 		cpu_timer->Resume();
 	}
 	// Maybe update wall time
-	if (executor.wall_timer == this) {
-		std::lock_guard<std::mutex> lock{executor.timer_mutex};
-		executor.wall_timer = nullptr;
-		executor.wall_time += std::chrono::steady_clock::now() - time;
+	if (executor.wall_timer.load(std::memory_order_relaxed) == this) {
+		executor.wall_time.Stop(std::chrono::steady_clock::now() - time);
+		executor.wall_timer.store(nullptr, std::memory_order_release);
 	}
 }
 
-auto Executor::WallTimer::Delta(const std::lock_guard<std::mutex>& /*lock*/) const -> std::chrono::nanoseconds {
-	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time);
-}
-
 /**
  * Scope ctor
  */
@@ -153,29 +213,24 @@ Executor::Scope::~Scope() {
 }
 
 Executor::Profiler::Profiler(IsolateEnvironment& env) {
-	environment = &env;
-	executor = &env.executor;
-	isolate = env.isolate;
-	profiler = nullptr;
-
-	if (env.GetCpuProfileManager()->IsProfiling()) {
-		profiler = v8::CpuProfiler::New(isolate, v8::kDebugNaming, v8::kEagerLogging);
-		const v8::Local<v8::String> title = v8::String::NewFromUtf8(isolate, "isolated-vm").ToLocalChecked();
-		profiler->StartProfiling(title, true);
+	auto* cpu_profile_manager = env.GetCpuProfileManager();
+	if (cpu_profile_manager->IsProfiling()) {
+		manager = cpu_profile_manager;
+		manager->Attach();
 	}
 }
 
 Executor::Profiler::~Profiler() {
-	if (profiler == nullptr) {
-		return;
+	if (manager != nullptr) {
+		manager->Detach();
 	}
+}
+
+Executor::ProfilerPause::ProfilerPause(IsolateEnvironment& env) :
+	manager{env.GetCpuProfileManager()}, depth{manager->Suspend()} {}
 
-	auto DeleterLambda =[](v8::CpuProfile *profile){
-		profile->Delete();
-	};
-	const v8::Local<v8::String> title = v8::String::NewFromUtf8(isolate, "isolated-vm").ToLocalChecked();
-	const std::shared_ptr<v8::CpuProfile> profile{profiler->StopProfiling(title),DeleterLambda};
-	environment->GetCpuProfileManager()->InjestCpuProfile(profile);
+Executor::ProfilerPause::~ProfilerPause() {
+	manager->Resume(depth);
 }
 
 /**
@@ -193,6 +248,7 @@ Executor::Lock::Lock(IsolateEnvironment& env) :
 /**
  * Unlock implementation
  */
-Executor::Unlock::Unlock(IsolateEnvironment& env) : pause_scope{env.executor.cpu_timer}, unlocker{env.isolate} {}
+Executor::Unlock::Unlock(IsolateEnvironment& env) :
+	pause_scope{env.executor.cpu_timer}, profiler_pause{env}, unlocker{env.isolate} {}
 
 } // namespace ivm
@@ -1,12 +1,18 @@
 #pragma once
 #include <v8.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <thread>
 #include "holder.h"
-#include "v8-profiler.h"
+
+#if USE_CLOCK_THREAD_CPUTIME_ID
+#include <time.h>
+#endif
 
 namespace ivm {
+class CpuProfileManager;
 class InspectorAgent;
 class IsolateEnvironment;
 class Scheduler;
@@ -30,6 +36,33 @@ class Executor { // "En taro adun"
 		static auto MayRunInlineTasks(IsolateEnvironment& env) -> bool;
 
 	private:
+		// Running total of time which is written by one thread at a time and may be read from any
+		// thread. Readers retry until they see the total and start time from the same write.
+		class TimeCounter {
+			public:
+#if USE_CLOCK_THREAD_CPUTIME_ID
+				using ClockId = clockid_t;
+#else
+				// Only `steady_clock` is used on other platforms
+				using ClockId = int;
+#endif
+				// `now` was read from `clock`, which readers also use to measure the period in progress
+				void Start(std::chrono::nanoseconds now, ClockId clock);
+				void Stop(std::chrono::nanoseconds elapsed);
+				auto Read() const -> std::chrono::nanoseconds;
+				static auto Now(ClockId clock) -> std::chrono::nanoseconds;
+				static auto SteadyClock() -> ClockId;
+
+			private:
+				void Write(int64_t total, int64_t started, ClockId clock, bool running);
+
+				std::atomic<uint32_t> sequence{0};
+				std::atomic<int64_t> total{0};
+				std::atomic<int64_t> started{0};
+				std::atomic<ClockId> clock{};
+				std::atomic<bool> running{false};
+		};
+
 		class CpuTimer {
 			public:
 				explicit CpuTimer(Executor& executor);
@@ -38,18 +71,16 @@ class Executor { // "En taro adun"
 				auto operator= (const CpuTimer&) = delete;
 
 				using TimePoint = std::chrono::time_point<std::chrono::steady_clock, std::chrono::nanoseconds>;
-				auto Delta(const std::lock_guard<std::mutex>& /*lock*/) const -> std::chrono::nanoseconds;
 				void Pause();
 				void Resume();
 				static auto Now() -> TimePoint;
 
 			private:
+				void Start();
+
 				Executor& executor;
 				CpuTimer* last;
 				TimePoint time;
-#if USE_CLOCK_THREAD_CPUTIME_ID
-				std::chrono::time_point<std::chrono::steady_clock> steady_time;
-#endif
 		};
 
 		// WallTimer is also responsible for pausing the current CpuTimer before we attempt to
@@ -61,8 +92,6 @@ class Executor { // "En taro adun"
 				~WallTimer();
 				auto operator= (const WallTimer&) = delete;
 
-				auto Delta(const std::lock_guard<std::mutex>& /*lock*/) const -> std::chrono::nanoseconds;
-
 			private:
 				Executor& executor;
 				CpuTimer* cpu_timer;
@@ -107,6 +136,7 @@ class Executor { // "En taro adun"
 				Executor* last;
 		};
 
+		// Keeps a CPU profiler session running on this thread while any profiler title is active
 		class Profiler {
 			public:
 				explicit Profiler(IsolateEnvironment& env);
@@ -114,10 +144,19 @@ class Executor { // "En taro adun"
 				~Profiler();
 				auto operator= (const Profiler&) = delete;
 			private:
-				IsolateEnvironment* environment;
-				Executor* executor;
-				v8::CpuProfiler* profiler;
-				v8::Isolate* isolate;
+				CpuProfileManager* manager = nullptr;
+		};
+
+		// Resets the lock depth while the isolate is unlocked, since another thread may pick it up
+		class ProfilerPause {
+			public:
+				explicit ProfilerPause(IsolateEnvironment& env);
+				ProfilerPause(const ProfilerPause&) = delete;
+				~ProfilerPause();
+				auto operator= (const ProfilerPause&) = delete;
+			private:
+				CpuProfileManager* manager;
+				int depth;
 		};
 
 		// Locks this environment for execution. Implies `Scope` as well.
@@ -149,6 +188,7 @@ class Executor { // "En taro adun"
 
 			private:
 				PauseScope pause_scope;
+				ProfilerPause profiler_pause;
 				v8::Unlocker unlocker;
 		};
 
@@ -157,12 +197,13 @@ class Executor { // "En taro adun"
 		Executor& default_executor;
 		std::thread::id default_thread;
 		Lock* current_lock = nullptr;
+		// Only touched by the thread holding the isolate lock
 		CpuTimer* cpu_timer = nullptr;
-		WallTimer* wall_timer = nullptr;
+		// Owned by whichever thread got here first, which may not be holding the isolate lock yet
+		std::atomic<WallTimer*> wall_timer{nullptr};
 		int depth = 0;
-		std::mutex timer_mutex;
-		std::chrono::nanoseconds cpu_time{};
-		std::chrono::nanoseconds wall_time{};
+		TimeCounter cpu_time;
+		TimeCounter wall_time;
 
 		static thread_local CpuTimer* cpu_timer_thread;
 		static thread_local Executor* current_executor;
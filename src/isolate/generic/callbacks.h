@@ -173,6 +173,13 @@ struct MemberAccessorHolder {
 	const MemberSetterHolder setter;
 };
 
+// Accessor properties backed by regular functions
+struct MemberPropertyHolder {
+	constexpr MemberPropertyHolder(MemberFunctionHolder getter, MemberFunctionHolder setter) : getter{getter}, setter{setter} {}
+	const MemberFunctionHolder getter;
+	const MemberFunctionHolder setter;
+};
+
 // Static getters and setters
 struct StaticGetterHolder : FreeFunctionHolder {
 	using FreeFunctionHolder::FreeFunctionHolder;
@@ -258,6 +265,16 @@ struct MemberAccessor<GetterSignature, Getter, std::nullptr_t, nullptr> : detail
 		using UnboundGetter = detail::unbind_member_function<GetterSignature>;
 };
 
+// Native accessors become read-only once the prototype is frozen, so settable properties on frozen
+// classes need to be real accessor properties.
+template <class GetterSignature, GetterSignature Getter, class SetterSignature, SetterSignature Setter>
+struct MemberProperty : detail::MemberPropertyHolder {
+	constexpr MemberProperty() : MemberPropertyHolder{
+		MemberFunction<GetterSignature, Getter>{},
+		MemberFunction<SetterSignature, Setter>{}
+	} {}
+};
+
 template <
 	class GetterSignature, GetterSignature Getter,
 	class SetterSignature = std::nullptr_t, SetterSignature Setter = nullptr
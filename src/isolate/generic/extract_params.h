@@ -53,6 +53,10 @@ struct RequiredArguments<Index> {
     constexpr static size_t value = 0;
 };
 
+// `this` in member functions, which v8 has already checked against the class's `v8::Signature`
+template <class Type>
+struct CheckedReceiver {};
+
 // Extracts parameters from various v8 call signatures
 template <int Index>
 inline auto ExtractParamImpl(const v8::FunctionCallbackInfo<v8::Value>& info) -> v8::Local<v8::Value> {
@@ -103,7 +107,8 @@ class ParamExtractor {
 			constexpr int AdjustedIndex = Index == 0 ? Offset : (std::max(-1, Offset) + Index);
 			ii = AdjustedIndex;
 			v8::Local<v8::Value> value = Extract<AdjustedIndex>(seq);
-			return HandleCast<Type>(value, std::get<sizeof...(Args) - 1>(args));
+			using IsReceiver = std::integral_constant<bool, AdjustedIndex == -1 && std::is_lvalue_reference<Type>::value>;
+			return Cast<Type>(value, std::get<sizeof...(Args) - 1>(args), IsReceiver{});
 		}
 
 		[[noreturn]] void Caught(const ParamIncorrect& ex) {
@@ -119,6 +124,16 @@ class ParamExtractor {
 			return detail::CalleeName(std::get<sizeof...(Args) - 1>(args));
 		}
 
+		template <class Type>
+		static inline auto Cast(v8::Local<v8::Value> value, HandleCastArguments arguments, std::false_type /*receiver*/) -> Type {
+			return HandleCast<Type>(value, arguments);
+		}
+
+		template <class Type>
+		static inline auto Cast(v8::Local<v8::Value> value, HandleCastArguments arguments, std::true_type /*receiver*/) -> Type {
+			return HandleCastImpl(value, arguments, HandleCastTag<CheckedReceiver<Type>>{});
+		}
+
 		template <int Index, size_t ...Indices>
 		inline auto Extract(std::index_sequence<Indices...> /*indices*/) {
 			return ExtractParamImpl<Index>(std::get<Indices>(args)...);
@@ -19,4 +19,8 @@ void PlatformDelegate::UnregisterIsolate(v8::Isolate* isolate) {
 	delegate.node_platform->UnregisterIsolate(isolate);
 }
 
+void PlatformDelegate::CallOnWorkerThread(std::unique_ptr<v8::Task> task) {
+	delegate.node_platform->CallOnWorkerThread(std::move(task));
+}
+
 } // namespace ivm
@@ -39,6 +39,8 @@ class PlatformDelegate {
 		static void InitializeDelegate();
 		static void RegisterIsolate(v8::Isolate* isolate, node::IsolatePlatformDelegate* isolate_delegate);
 		static void UnregisterIsolate(v8::Isolate* isolate);
+		// Runs a task on node's worker threads, which don't hold any isolate lock
+		static void CallOnWorkerThread(std::unique_ptr<v8::Task> task);
 
 		node::MultiIsolatePlatform* node_platform = nullptr;
 };
@@ -60,78 +60,90 @@ class TimeoutRunner final : public Runnable {
 };
 
 /**
- * Run some v8 thing with a timeout. Also throws error if memory limit is hit.
+ * Run some v8 thing with a timeout. `timeout_ms` is wall time, `cpu_timeout_ms` is CPU time spent in
+ * this isolate. Also throws error if memory limit is hit.
  */
 template <typename F>
-auto RunWithTimeout(uint32_t timeout_ms, F&& fn) -> v8::Local<v8::Value> {
+auto RunWithTimeout(uint32_t timeout_ms, uint32_t cpu_timeout_ms, F&& fn) -> v8::Local<v8::Value> {
 	IsolateEnvironment& isolate = IsolateEnvironment::GetCurrent();
 	thread_suspend_handle thread_suspend{};
 	bool is_default_thread = Executor::IsDefaultThread();
 	bool did_terminate = false;
 	TimeoutRunner::State state;
 	v8::MaybeLocal<v8::Value> result;
+	isolate.ArmCpuBudgetTimer();
 	{
-		std::unique_ptr<timer_t> timer_ptr;
-		if (timeout_ms != 0) {
-			timer_ptr = std::make_unique<timer_t>(timeout_ms, &isolate.timer_holder, [&](void* next) {
-				auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+		auto on_timeout = [&](void* next) {
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
 
-				{
-					std::lock_guard<std::mutex> lock{state.mutex};
-					if (state.did_finish) {
-						// Timer triggered as the function was finishing, bail early
-						timer_t::chain(next);
-						return;
-					}
-					// Set up interrupt
-					state.did_timeout = true;
-					auto timeout_runner = std::make_unique<TimeoutRunner>(state);
-					if (is_default_thread) {
-						// In this case this is a pure sync function. We should not cancel any async waits.
-						auto lock = isolate.scheduler->Lock();
-						lock->sync_interrupts.push(std::move(timeout_runner));
-						lock->InterruptSyncIsolate();
-					} else {
-						{
-							auto lock = isolate.scheduler->Lock();
-							lock->CancelAsync();
-							lock->interrupts.push(std::move(timeout_runner));
-							lock->InterruptIsolate();
-						}
-					}
+			{
+				std::lock_guard<std::mutex> lock{state.mutex};
+				if (state.did_finish || state.did_timeout) {
+					// Timer triggered as the function was finishing, or the other timer already fired
+					timer_t::chain(next);
+					return;
 				}
-				timer_t::chain(next);
-
-				// Wait for TimeoutRunner release (either it ran, or was cancelled)
-				{
-					std::unique_lock<std::mutex> lock{state.mutex};
-					if (isolate.error_handler) {
-						if (!state.cv.wait_until(lock, deadline, [&] { return state.did_release || state.did_finish; })) {
-							assert(RaiseCatastrophicError(isolate.error_handler, "Script failed to terminate"));
-							thread_suspend.suspend();
-							return;
-						}
-					} else {
-						state.cv.wait(lock, [&] { return state.did_release || state.did_finish; });
-					}
-					if (state.did_finish) {
-						return;
+				// Set up interrupt
+				state.did_timeout = true;
+				auto timeout_runner = std::make_unique<TimeoutRunner>(state);
+				if (is_default_thread) {
+					// In this case this is a pure sync function. We should not cancel any async waits.
+					auto lock = isolate.scheduler->Lock();
+					lock->sync_interrupts.push(std::move(timeout_runner));
+					lock->InterruptSyncIsolate();
+				} else {
+					{
+						auto lock = isolate.scheduler->Lock();
+						lock->CancelAsync();
+						lock->interrupts.push(std::move(timeout_runner));
+						lock->InterruptIsolate();
 					}
 				}
+			}
+			timer_t::chain(next);
 
-				// Wait for `fn()` to return
-				while (true) {
-					std::lock_guard<std::mutex> lock{state.mutex};
-					if (state.did_finish) {
-						return;
-					} else if (isolate.error_handler && deadline > std::chrono::steady_clock::now()) {
+			// Wait for TimeoutRunner release (either it ran, or was cancelled)
+			{
+				std::unique_lock<std::mutex> lock{state.mutex};
+				if (isolate.error_handler) {
+					if (!state.cv.wait_until(lock, deadline, [&] { return state.did_release || state.did_finish; })) {
 						assert(RaiseCatastrophicError(isolate.error_handler, "Script failed to terminate"));
 						thread_suspend.suspend();
 						return;
 					}
-					// Aggressively terminate the isolate because sometimes v8 just doesn't get the hint
-					isolate->TerminateExecution();
+				} else {
+					state.cv.wait(lock, [&] { return state.did_release || state.did_finish; });
+				}
+				if (state.did_finish) {
+					return;
+				}
+			}
+
+			// Wait for `fn()` to return
+			while (true) {
+				std::lock_guard<std::mutex> lock{state.mutex};
+				if (state.did_finish) {
+					return;
+				} else if (isolate.error_handler && deadline > std::chrono::steady_clock::now()) {
+					assert(RaiseCatastrophicError(isolate.error_handler, "Script failed to terminate"));
+					thread_suspend.suspend();
+					return;
 				}
+				// Aggressively terminate the isolate because sometimes v8 just doesn't get the hint
+				isolate->TerminateExecution();
+			}
+		};
+		std::unique_ptr<timer_t> timer_ptr;
+		std::unique_ptr<timer_t> cpu_timer_ptr;
+		if (timeout_ms != 0) {
+			timer_ptr = std::make_unique<timer_t>(timeout_ms, &isolate.timer_holder, on_timeout);
+		}
+		if (cpu_timeout_ms != 0) {
+			// This isolate's CPU time can't get ahead of wall time, so the timer only ever comes due
+			// early. When it does it's pushed back by however much CPU time is left.
+			auto cpu_deadline = isolate.GetCpuTime() + std::chrono::milliseconds{cpu_timeout_ms};
+			cpu_timer_ptr = std::make_unique<timer_t>(cpu_timeout_ms, nullptr, on_timeout, [&isolate, cpu_deadline]() {
+				return std::chrono::steady_clock::duration{std::max(cpu_deadline - isolate.GetCpuTime(), std::chrono::nanoseconds{})};
 			});
 		}
 
@@ -157,6 +169,8 @@ auto RunWithTimeout(uint32_t timeout_ms, F&& fn) -> v8::Local<v8::Value> {
 	}
 	if (isolate.DidHitMemoryLimit()) {
 		throw FatalRuntimeError("Isolate was disposed during execution due to memory limit");
+	} else if (isolate.DidHitCpuLimit()) {
+		throw FatalRuntimeError("Isolate was disposed during execution due to CPU limit");
 	} else if (isolate.terminated) {
 		throw FatalRuntimeError("Isolate was disposed during execution");
 	} else if (did_terminate) {
@@ -2,6 +2,8 @@
 #include "executor.h"
 #include "node_wrapper.h"
 #include "scheduler.h"
+#include "lib/timer.h"
+#include <algorithm>
 #include <memory>
 #include <v8.h>
 #include <utility>
@@ -42,19 +44,81 @@ void Scheduler::InterruptSyncIsolate() {
 
 auto Scheduler::WakeIsolate(std::shared_ptr<IsolateEnvironment> isolate_ptr) -> bool {
 	if (status == Status::Waiting) {
-		status = Status::Running;
 		// Move shared reference to this scheduler to ensure the IsolateEnvironment won't be deleted
 		// before a thread picks up this work.
 		assert(!env_ref);
 		env_ref = std::move(isolate_ptr);
 		IncrementUvRef();
-		SendWake();
+		auto delay = CpuQuotaDelay();
+		if (delay > std::chrono::nanoseconds{}) {
+			DelayWake(delay);
+		} else {
+			status = Status::Running;
+			SendWake();
+		}
+		return true;
+	} else if (status == Status::Delayed) {
+		// Interrupts don't wait for the quota
+		if (!interrupts.empty()) {
+			status = Status::Running;
+			SendWake();
+		}
 		return true;
 	} else {
 		return false;
 	}
 }
 
+void Scheduler::DelayWake(std::chrono::nanoseconds delay) {
+	// Over quota, so don't take up a pool thread until it has drained. `env_ref` keeps the isolate
+	// alive in the meantime.
+	status = Status::Delayed;
+	auto generation = ++delay_generation;
+	auto delay_ms = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+	timer_t::wait_detached(static_cast<uint32_t>(delay_ms), [weak_env = std::weak_ptr<IsolateEnvironment>{env_ref}, generation](void* next) {
+		auto env = weak_env.lock();
+		if (env) {
+			env->GetScheduler().Lock()->EndDelay(generation);
+		}
+		timer_t::chain(next);
+	});
+}
+
+void Scheduler::EndDelay(unsigned generation) {
+	if (status == Status::Delayed && generation == delay_generation) {
+		status = Status::Running;
+		SendWake();
+	}
+}
+
+void Scheduler::SetCpuQuota(std::chrono::nanoseconds quota, std::chrono::nanoseconds window) {
+	cpu_quota = quota;
+	cpu_quota_window = window;
+	cpu_quota_usage = {};
+	cpu_quota_last_cpu_time = env.GetCpuTime();
+	cpu_quota_last_update = std::chrono::steady_clock::now();
+}
+
+auto Scheduler::CpuQuotaDelay() -> std::chrono::nanoseconds {
+	if (cpu_quota == std::chrono::nanoseconds{} || env.terminated) {
+		return {};
+	}
+	auto now = std::chrono::steady_clock::now();
+	auto cpu_time = env.GetCpuTime();
+	const double rate = static_cast<double>(cpu_quota.count()) / static_cast<double>(cpu_quota_window.count());
+	std::chrono::nanoseconds drained{static_cast<int64_t>(static_cast<double>((now - cpu_quota_last_update).count()) * rate)};
+	cpu_quota_usage = std::min(
+		std::max(cpu_quota_usage - drained, std::chrono::nanoseconds{}) + (cpu_time - cpu_quota_last_cpu_time),
+		cpu_quota * 2
+	);
+	cpu_quota_last_cpu_time = cpu_time;
+	cpu_quota_last_update = now;
+	if (cpu_quota_usage <= cpu_quota) {
+		return {};
+	}
+	return std::chrono::nanoseconds{static_cast<int64_t>(static_cast<double>((cpu_quota_usage - cpu_quota).count()) / rate)};
+}
+
 auto LockedScheduler::GetForegroundTaskRunner() -> std::shared_ptr<v8::TaskRunner> {
 	return env.GetTaskRunner();
 }
@@ -62,15 +126,43 @@ auto LockedScheduler::GetForegroundTaskRunner() -> std::shared_ptr<v8::TaskRunne
 void LockedScheduler::DecrementUvRefForIsolate(const std::shared_ptr<IsolateHolder>& holder) {
 	auto ref = holder->GetIsolate();
 	if (ref) {
-		ref->scheduler->DecrementUvRef();
+		DecrementUvRefForIsolate(*ref);
 	}
 }
 
 void LockedScheduler::IncrementUvRefForIsolate(const std::shared_ptr<IsolateHolder>& holder) {
 	auto ref = holder->GetIsolate();
 	if (ref) {
-		ref->scheduler->IncrementUvRef();
+		IncrementUvRefForIsolate(*ref);
+	}
+}
+
+void LockedScheduler::DecrementUvRefForIsolate(IsolateEnvironment& env) {
+	env.scheduler->DecrementUvRef();
+}
+
+void LockedScheduler::IncrementUvRefForIsolate(IsolateEnvironment& env) {
+	env.scheduler->IncrementUvRef();
+}
+
+void LockedScheduler::ExecuteInThreadPool(std::unique_ptr<Runnable> task) {
+	thread_pool_t::affinity_t affinity;
+	thread_pool.exec(affinity, [](bool /*pool_thread*/, void* param) {
+		std::unique_ptr<Runnable> task{static_cast<Runnable*>(param)};
+		task->Run();
+	}, task.release());
+}
+
+auto LockedScheduler::ExecuteOnPoolThread(size_t thread, std::unique_ptr<Runnable> task) -> bool {
+	auto* param = task.release();
+	bool queued = thread_pool.exec_on(thread, [](bool /*pool_thread*/, void* param) {
+		std::unique_ptr<Runnable> task{static_cast<Runnable*>(param)};
+		task->Run();
+	}, param);
+	if (!queued) {
+		delete param;
 	}
+	return queued;
 }
 
 IsolatedScheduler::IsolatedScheduler(IsolateEnvironment& env, UvScheduler& default_scheduler) :
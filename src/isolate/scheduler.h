@@ -5,6 +5,7 @@
 #include "lib/thread_pool.h"
 #include <uv.h>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -46,8 +47,13 @@ class Scheduler {
 		void InterruptIsolate();
 		// Interrupts an isolate running in the default thread
 		void InterruptSyncIsolate();
-		// Returns true if a wake was scheduled, false if the isolate is already running.
+		// Returns true if a wake was scheduled, false if the isolate is already running. A wake may be
+		// held back by the CPU quota, unless there are interrupts to run.
 		auto WakeIsolate(std::shared_ptr<IsolateEnvironment> isolate_ptr) -> bool;
+		// Limits this isolate to `quota` CPU time over any `window` of wall time. 0 disables.
+		void SetCpuQuota(std::chrono::nanoseconds quota, std::chrono::nanoseconds window);
+		// Returns how long this isolate should wait before it runs again to stay within its quota
+		auto CpuQuotaDelay() -> std::chrono::nanoseconds;
 
 		// Scheduler::AsyncWait will pause the current thread until woken up by another thread
 		class AsyncWait {
@@ -91,10 +97,23 @@ class Scheduler {
 		virtual void IncrementUvRef() = 0;
 		virtual void DecrementUvRef() = 0;
 		virtual void SendWake() = 0;
+		// Wakes the isolate after `delay`, unless something else woke it first
+		void DelayWake(std::chrono::nanoseconds delay);
+		void EndDelay(unsigned generation);
 
-		enum class Status { Waiting, Running };
+		// `Delayed` isolates have work queued up but are waiting on their CPU quota
+		enum class Status { Waiting, Delayed, Running };
 		AsyncWait* async_wait = nullptr;
 		Status status = Status::Waiting;
+		unsigned delay_generation = 0;
+
+		// CPU usage drains at `quota / window`, up to 2 quotas are held so a tenant is never held back
+		// for more than one window
+		std::chrono::nanoseconds cpu_quota{};
+		std::chrono::nanoseconds cpu_quota_window{};
+		std::chrono::nanoseconds cpu_quota_usage{};
+		std::chrono::nanoseconds cpu_quota_last_cpu_time{};
+		std::chrono::steady_clock::time_point cpu_quota_last_update;
 };
 
 class LockedScheduler : protected Scheduler, public node::IsolatePlatformDelegate {
@@ -128,6 +147,13 @@ class LockedScheduler : protected Scheduler, public node::IsolatePlatformDelegat
 		// Used to ref/unref the uv handle from C++ API
 		static void DecrementUvRefForIsolate(const std::shared_ptr<IsolateHolder>& holder);
 		static void IncrementUvRefForIsolate(const std::shared_ptr<IsolateHolder>& holder);
+		static void DecrementUvRefForIsolate(IsolateEnvironment& env);
+		static void IncrementUvRefForIsolate(IsolateEnvironment& env);
+
+		// Runs a task which doesn't belong to any isolate on the isolate thread pool
+		static void ExecuteInThreadPool(std::unique_ptr<Runnable> task);
+		// Runs a task on one particular pool thread, returns false if that thread is gone
+		static auto ExecuteOnPoolThread(size_t thread, std::unique_ptr<Runnable> task) -> bool;
 };
 
 class IsolatedScheduler final : public LockedScheduler {
@@ -47,19 +47,30 @@ class StringTable {
 		String accessors{"accessors"};
 		String arguments{"arguments"};
 		String async{"async"};
+		String batchSize{"batchSize"};
 		String boolean{"boolean"};
+		String budgetMs{"budgetMs"};
+		String capacity{"capacity"};
 		String cachedData{"cachedData"};
 		String cachedDataRejected{"cachedDataRejected"};
 		String code{"code"};
+		String codeCacheDir{"codeCacheDir"};
 		// String codeGenerationError{"Code generation from large string was denied"};
 		String colonSpace{": "};
 		String columnOffset{"columnOffset"};
+		String contexts{"contexts"};
 		String copy{"copy"};
+		String copyOnWrite{"copyOnWrite"};
+		String cpuQuota{"cpuQuota"};
+		String cpuTimeout{"cpuTimeout"};
+		String data{"data"};
+		String done{"done"};
 		String externalCopy{"externalCopy"};
 		String filename{"filename"};
 		String function{"function"};
 		String global{"global"};
 		String ignored{"ignored"};
+		String imports{"imports"};
 		String inspector{"inspector"};
 		String isolateIsDisposed{"Isolate is disposed"};
 		String isolatedVm{"isolated-vm"};
@@ -67,11 +78,15 @@ class StringTable {
 		String lineOffset{"lineOffset"};
 		String message{"message"};
 		String meta{"meta"};
+		String mmap{"mmap"};
+		String ms{"ms"};
 		String name{"name"};
+		String next{"next"};
 		String null{"null"};
 		String number{"number"};
 		String object{"object"};
 		String onCatastrophicError{"onCatastrophicError"};
+		String pooledArrayBuffers{"pooledArrayBuffers"};
 		String produceCachedData{"produceCachedData"};
 		String promise{"promise"};
 		String reference{"reference"};
@@ -86,6 +101,8 @@ class StringTable {
 		String transferOut{"transferOut"};
 		String undefined{"undefined"};
 		String unsafeInherit{"unsafeInherit"};
+		String value{"value"};
+		String windowMs{"windowMs"};
 
 		String does_zap_garbage{"does_zap_garbage"};
 		String externally_allocated_size{"externally_allocated_size"};
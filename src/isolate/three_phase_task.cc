@@ -1,6 +1,7 @@
 #include "three_phase_task.h"
 #include "external_copy/external_copy.h"
 #include <cstring>
+#include <utility>
 
 using namespace v8;
 using std::unique_ptr;
@@ -25,16 +26,20 @@ ThreePhaseTask::CalleeInfo::CalleeInfo(CalleeInfo&& that) noexcept :
 		remotes{std::move(that.remotes)}, async{std::exchange(that.async, {0, 0})} {}
 
 ThreePhaseTask::CalleeInfo::~CalleeInfo() {
-	auto& env = IsolateEnvironment::GetCurrent();
+	// Moved-from instances may be destroyed on a pool thread with no current environment, so check
+	// `async` first
 	node::async_context tmp{0, 0};
-	if (env.IsDefault() && std::memcmp(&async, &tmp, sizeof(node::async_context)) != 0) {
-		node::EmitAsyncDestroy(env.GetIsolate(), async);
+	if (std::memcmp(&async, &tmp, sizeof(node::async_context)) != 0) {
+		auto& env = IsolateEnvironment::GetCurrent();
+		if (env.IsDefault()) {
+			node::EmitAsyncDestroy(env.GetIsolate(), async);
+		}
 	}
 }
 
 /**
  * Wrapper around node's version of the same class which does nothing if this isn't the node
- * isolate.
+ * isolate, or if the task is part of a `CompletionBatch` which already has a scope open.
  *
  * nb: CallbackScope sets up a v8::TryCatch so if you need to catch an exception do this *before*
  * the v8::TryCatch.
@@ -42,14 +47,124 @@ ThreePhaseTask::CalleeInfo::~CalleeInfo() {
 struct CallbackScope {
 	unique_ptr<node::CallbackScope> scope;
 
-	CallbackScope(node::async_context async, Local<Object> resource) {
+	CallbackScope(node::async_context async, Local<Object> resource, bool batched) {
 		auto& env = IsolateEnvironment::GetCurrent();
-		if (env.IsDefault()) {
+		if (env.IsDefault() && !batched) {
 			scope = std::make_unique<node::CallbackScope>(env.GetIsolate(), resource, async);
 		}
 	}
 };
 
+/**
+ * QueuedValue implementation
+ */
+namespace {
+thread_local QueuedValue::Collector* current_collector = nullptr;
+}
+
+QueuedValue::Collector::Collector(std::vector<std::shared_ptr<QueuedValue>>& values) :
+	values{values}, previous{std::exchange(current_collector, this)} {}
+
+QueuedValue::Collector::~Collector() {
+	current_collector = previous;
+}
+
+void QueuedValue::Use(std::shared_ptr<QueuedValue> value) {
+	if (current_collector != nullptr) {
+		current_collector->values.push_back(std::move(value));
+	}
+}
+
+/**
+ * CompletionBatch implementation
+ */
+namespace {
+thread_local ThreePhaseTask::CompletionBatch* current_batch = nullptr;
+}
+
+struct ThreePhaseTask::CompletionBatch::Scope {
+	Context::Scope context_scope;
+	node::CallbackScope callback_scope;
+
+	Scope(Isolate* isolate, Local<Context> context) :
+		context_scope{context},
+		callback_scope{isolate, Object::New(isolate), node::async_context{0, 0}} {}
+};
+
+ThreePhaseTask::CompletionBatch::CompletionBatch(IsolateEnvironment& env) :
+	env{env.IsDefault() ? &env : nullptr},
+	previous{std::exchange(current_batch, this)} {}
+
+ThreePhaseTask::CompletionBatch::~CompletionBatch() {
+	current_batch = previous;
+	// Closing the outermost callback scope drains the tick queue and microtasks
+	scope.reset();
+}
+
+auto ThreePhaseTask::CompletionBatch::Join() -> bool {
+	auto& env = IsolateEnvironment::GetCurrent();
+	if (current_batch == nullptr || current_batch->env != &env) {
+		return false;
+	}
+	if (!current_batch->scope) {
+		current_batch->scope = std::make_unique<Scope>(env.GetIsolate(), env.DefaultContext());
+	}
+	return true;
+}
+
+/**
+ * BackgroundRunner implementation
+ */
+struct ThreePhaseTask::BackgroundRunner final : public v8::Task {
+	unique_ptr<Phase2Runner> runner;
+	std::shared_ptr<IsolateHolder> holder;
+	std::shared_ptr<IsolateHolder> caller_holder;
+	std::shared_ptr<IsolateEnvironment> env;
+
+	// Invoked from the isolate's thread while it is running, so the uv loop is already ref'd and this
+	// ref can be taken off the default thread
+	BackgroundRunner(
+		unique_ptr<Phase2Runner> runner,
+		std::shared_ptr<IsolateHolder> holder,
+		std::shared_ptr<IsolateEnvironment> env
+	) :
+			runner{std::move(runner)},
+			holder{std::move(holder)},
+			caller_holder{this->runner->info.remotes.GetSharedIsolateHolder()},
+			env{std::move(env)} {
+		LockedScheduler::IncrementUvRefForIsolate(*this->env);
+	}
+
+	BackgroundRunner(const BackgroundRunner&) = delete;
+	auto operator=(const BackgroundRunner&) -> BackgroundRunner& = delete;
+
+	~BackgroundRunner() final {
+		// Releasing the last uv ref from a pool thread races with the loop shutting down, so the ref
+		// is handed to a task in the calling isolate and released when that task is destroyed
+		struct ReleaseUvRef : public Runnable {
+			std::shared_ptr<IsolateEnvironment> env;
+
+			explicit ReleaseUvRef(std::shared_ptr<IsolateEnvironment> env) : env{std::move(env)} {}
+			ReleaseUvRef(const ReleaseUvRef&) = delete;
+			auto operator=(const ReleaseUvRef&) -> ReleaseUvRef& = delete;
+			~ReleaseUvRef() final {
+				LockedScheduler::DecrementUvRefForIsolate(*env);
+			}
+
+			void Run() final {}
+		};
+		caller_holder->ScheduleTask(std::make_unique<ReleaseUvRef>(std::move(env)), false, true);
+	}
+
+	void Run() final {
+		runner->self->Phase2Background();
+		runner->resume = true;
+		// If the isolate was disposed in the meantime the runner is dropped here, which rejects the
+		// promise
+		holder->ScheduleTask(std::move(runner), false, true);
+	}
+};
+
 /**
  * Phase2Runner implementation
  */
@@ -77,15 +192,18 @@ ThreePhaseTask::Phase2Runner::~Phase2Runner() {
 			void Run() final {
 				// Revive our persistent handles
 				Isolate* isolate = Isolate::GetCurrent();
+				bool batched = CompletionBatch::Join();
 				auto context_local = info.remotes.Deref<1>();
 				Context::Scope context_scope(context_local);
 				auto promise_local = info.remotes.Deref<0>();
-				CallbackScope callback_scope(info.async, promise_local);
+				CallbackScope callback_scope(info.async, promise_local, batched);
 				// Throw from promise
 				Local<Object> error = Exception::Error(StringTable::Get().isolateIsDisposed).As<Object>();
 				StackTraceHolder::AttachStack(error, info.remotes.Deref<2>());
 				Unmaybe(promise_local->Reject(context_local, error));
-				isolate->PerformMicrotaskCheckpoint();
+				if (!batched) {
+					isolate->PerformMicrotaskCheckpoint();
+				}
 			}
 		};
 		// Schedule a throw task back in first isolate
@@ -119,10 +237,11 @@ void ThreePhaseTask::Phase2Runner::Run() {
 		void Run() final {
 			// Revive our persistent handles
 			Isolate* isolate = Isolate::GetCurrent();
+			bool batched = CompletionBatch::Join();
 			auto context_local = info.remotes.Deref<1>();
 			Context::Scope context_scope(context_local);
 			auto promise_local = info.remotes.Deref<0>();
-			CallbackScope callback_scope(info.async, promise_local);
+			CallbackScope callback_scope(info.async, promise_local, batched);
 			Local<Value> rejection;
 			if (error) {
 				rejection = error->CopyInto();
@@ -134,7 +253,9 @@ void ThreePhaseTask::Phase2Runner::Run() {
 			}
 			// If Reject fails then I think that's bad..
 			Unmaybe(promise_local->Reject(context_local, rejection));
+			if (!batched) {
 				isolate->PerformMicrotaskCheckpoint();
+			}
 		}
 	};
 
@@ -152,10 +273,11 @@ void ThreePhaseTask::Phase2Runner::Run() {
 
 		void Run() final {
 			Isolate* isolate = Isolate::GetCurrent();
+			bool batched = CompletionBatch::Join();
 			auto context_local = info.remotes.Deref<1>();
 			Context::Scope context_scope(context_local);
 			auto promise_local = info.remotes.Deref<0>();
-			CallbackScope callback_scope(info.async, promise_local);
+			CallbackScope callback_scope(info.async, promise_local, batched);
 			FunctorRunners::RunCatchValue([&]() {
 				// Final callback
 				Unmaybe(promise_local->Resolve(context_local, self->Phase3()));
@@ -166,7 +288,9 @@ void ThreePhaseTask::Phase2Runner::Run() {
 				}
 				Unmaybe(promise_local->Reject(context_local, error));
 			});
-			isolate->PerformMicrotaskCheckpoint();
+			if (!batched) {
+				isolate->PerformMicrotaskCheckpoint();
+			}
 		}
 	};
 
@@ -178,7 +302,24 @@ void ThreePhaseTask::Phase2Runner::Run() {
 	};
 	FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent().DefaultContext(), [&]() {
 		// Continue the task
-		self->Phase2();
+		if (resume) {
+			self->Phase2Resume();
+		} else {
+			self->Phase2();
+			if (self->HasBackgroundWork()) {
+				auto holder = IsolateEnvironment::GetCurrentHolder();
+				auto env = holder->GetIsolate();
+				if (!env) {
+					throw RuntimeGenericError("Isolate is disposed");
+				}
+				// Streamed sources block on the host's iterator, so this can't go to v8's platform workers
+				LockedScheduler::ExecuteInThreadPool(std::make_unique<BackgroundRunner>(
+					std::make_unique<Phase2Runner>(std::move(self), std::move(info)),
+					std::move(holder), std::move(env)
+				));
+				return;
+			}
+		}
 		auto epilogue_error = IsolateEnvironment::GetCurrent().TaskEpilogue();
 		if (epilogue_error) {
 			schedule_error(std::move(epilogue_error));
@@ -7,9 +7,45 @@
 #include "stack_trace.h"
 #include "util.h"
 #include <memory>
+#include <vector>
 
 namespace ivm {
 
+/**
+ * A value which a task queued in an isolate will produce. Async tasks are queued behind whatever
+ * they use, but sync tasks skip the queue, so they wait for these before they lock the isolate.
+ */
+class QueuedValue {
+	public:
+		/**
+		 * Collects the values used by phase 1 of a task while it's alive on this thread
+		 */
+		class Collector {
+			public:
+				explicit Collector(std::vector<std::shared_ptr<QueuedValue>>& values);
+				Collector(const Collector&) = delete;
+				~Collector();
+				auto operator= (const Collector&) -> Collector& = delete;
+
+			private:
+				friend QueuedValue;
+				std::vector<std::shared_ptr<QueuedValue>>& values;
+				Collector* previous;
+		};
+
+		QueuedValue() = default;
+		QueuedValue(const QueuedValue&) = delete;
+		virtual ~QueuedValue() = default;
+		auto operator= (const QueuedValue&) -> QueuedValue& = delete;
+
+		// Blocks the calling thread until the producing task is done with this value
+		virtual void Wait() = 0;
+
+		// Invoked during phase 1 by anything which will read this value in phase 2
+		static void Use(std::shared_ptr<QueuedValue> value);
+};
+
+
 /**
  * Most operations in this library can be decomposed into three phases.
  *
@@ -56,6 +92,8 @@ class ThreePhaseTask {
 			std::unique_ptr<ThreePhaseTask> self;
 			CalleeInfo info;
 			bool did_run = false;
+			// `Phase2Background()` has finished, so continue with `Phase2Resume()`
+			bool resume = false;
 
 			Phase2Runner(
 				std::unique_ptr<ThreePhaseTask> self,
@@ -67,6 +105,12 @@ class ThreePhaseTask {
 			void Run() final;
 		};
 
+		/**
+		 * Runs `Phase2Background()` on the isolate thread pool and then hands the Phase2Runner back
+		 * to the isolate
+		 */
+		struct BackgroundRunner;
+
 		/**
 		 * Class which manages running async phase 2 in ignored mode (ie no phase 3)
 		 */
@@ -79,6 +123,29 @@ class ThreePhaseTask {
 		auto RunSync(IsolateHolder& second_isolate, bool allow_async) -> v8::Local<v8::Value>;
 
 	public:
+		/**
+		 * While one of these is alive, phase 3 tasks which run in the node isolate share a single
+		 * callback scope. The tick queue and microtasks are drained once when the batch ends instead
+		 * of after every completion.
+		 */
+		class CompletionBatch {
+			public:
+				explicit CompletionBatch(IsolateEnvironment& env);
+				CompletionBatch(const CompletionBatch&) = delete;
+				~CompletionBatch();
+				auto operator= (const CompletionBatch&) -> CompletionBatch& = delete;
+
+				// Returns true if the current task belongs to a batch, false if it must drain microtasks
+				// itself
+				static auto Join() -> bool;
+
+			private:
+				struct Scope;
+				IsolateEnvironment* env;
+				CompletionBatch* previous;
+				std::unique_ptr<Scope> scope;
+		};
+
 		ThreePhaseTask() = default;
 		ThreePhaseTask(const ThreePhaseTask&) = delete;
 		auto operator= (const ThreePhaseTask&) -> ThreePhaseTask& = delete;
@@ -90,6 +157,13 @@ class ThreePhaseTask {
 			return false;
 		}
 
+		// Fully asynchronous tasks may split phase 2 around work which doesn't need the isolate. If
+		// this returns true after `Phase2()` then `Phase2Background()` is invoked on a pool thread
+		// with no isolate locked, followed by `Phase2Resume()` back in the isolate. It may block.
+		virtual auto HasBackgroundWork() -> bool { return false; }
+		virtual void Phase2Background() {}
+		virtual void Phase2Resume() {}
+
 		virtual auto Phase3() -> v8::Local<v8::Value> = 0;
 
 		template <int async, typename T, typename ...Args>
@@ -126,8 +200,15 @@ class ThreePhaseTask {
 				);
 				return v8::Undefined(v8::Isolate::GetCurrent());
 			} else {
-				// Execute synchronously
+				// Execute synchronously. This skips the isolate's queue, so values produced by tasks which
+				// are still queued are waited for here.
+				std::vector<std::shared_ptr<QueuedValue>> dependencies;
+				auto collector = std::make_unique<QueuedValue::Collector>(dependencies);
 				T self(std::forward<Args>(args)...);
+				collector.reset();
+				for (auto& dependency : dependencies) {
+					dependency->Wait();
+				}
 				return self.RunSync(second_isolate, async == 4);
 			}
 		}
@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ivm {
+
+/**
+ * Minimal SHA-256, used for content addressed caches where a collision would mean running the wrong
+ * code. It isn't fast, but it only runs once per compile.
+ */
+class sha256_t {
+	public:
+		using digest_t = std::array<uint8_t, 32>;
+
+		void update(const void* data, size_t length) {
+			const auto* bytes = static_cast<const uint8_t*>(data);
+			total += length;
+			while (length > 0) {
+				size_t count = std::min(length, block.size() - used);
+				std::memcpy(block.data() + used, bytes, count);
+				used += count;
+				bytes += count;
+				length -= count;
+				if (used == block.size()) {
+					compress();
+					used = 0;
+				}
+			}
+		}
+
+		auto finish() -> digest_t {
+			uint64_t bits = total * 8;
+			uint8_t pad = 0x80;
+			update(&pad, 1);
+			pad = 0;
+			while (used != 56) {
+				update(&pad, 1);
+			}
+			for (int ii = 7; ii >= 0; --ii) {
+				block[used++] = static_cast<uint8_t>(bits >> (ii * 8));
+			}
+			compress();
+			digest_t digest;
+			for (size_t ii = 0; ii < 8; ++ii) {
+				for (size_t jj = 0; jj < 4; ++jj) {
+					digest[ii * 4 + jj] = static_cast<uint8_t>(state[ii] >> (24 - jj * 8));
+				}
+			}
+			return digest;
+		}
+
+	private:
+		static auto rotate(uint32_t value, int bits) -> uint32_t {
+			return (value >> bits) | (value << (32 - bits));
+		}
+
+		void compress() {
+			static constexpr uint32_t k[64] = {
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+			};
+			uint32_t w[64];
+			for (size_t ii = 0; ii < 16; ++ii) {
+				w[ii] =
+					static_cast<uint32_t>(block[ii * 4]) << 24 | static_cast<uint32_t>(block[ii * 4 + 1]) << 16 |
+					static_cast<uint32_t>(block[ii * 4 + 2]) << 8 | static_cast<uint32_t>(block[ii * 4 + 3]);
+			}
+			for (size_t ii = 16; ii < 64; ++ii) {
+				uint32_t s0 = rotate(w[ii - 15], 7) ^ rotate(w[ii - 15], 18) ^ (w[ii - 15] >> 3);
+				uint32_t s1 = rotate(w[ii - 2], 17) ^ rotate(w[ii - 2], 19) ^ (w[ii - 2] >> 10);
+				w[ii] = w[ii - 16] + s0 + w[ii - 7] + s1;
+			}
+			auto s = state;
+			for (size_t ii = 0; ii < 64; ++ii) {
+				uint32_t t1 = s[7] + (rotate(s[4], 6) ^ rotate(s[4], 11) ^ rotate(s[4], 25)) +
+					((s[4] & s[5]) ^ (~s[4] & s[6])) + k[ii] + w[ii];
+				uint32_t t2 = (rotate(s[0], 2) ^ rotate(s[0], 13) ^ rotate(s[0], 22)) +
+					((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+				s = { t1 + t2, s[0], s[1], s[2], s[3] + t1, s[4], s[5], s[6] };
+			}
+			for (size_t ii = 0; ii < 8; ++ii) {
+				state[ii] += s[ii];
+			}
+		}
+
+		std::array<uint32_t, 8> state = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+		};
+		std::array<uint8_t, 64> block{};
+		size_t used = 0;
+		uint64_t total = 0;
+};
+
+} // namespace ivm
@@ -3,6 +3,19 @@
 
 namespace ivm {
 
+namespace {
+thread_local bool pool_thread = false;
+thread_local size_t pool_thread_index = 0;
+}
+
+auto thread_pool_t::is_pool_thread() -> bool {
+	return pool_thread;
+}
+
+auto thread_pool_t::current_thread() -> size_t {
+	return pool_thread_index;
+}
+
 void thread_pool_t::exec(affinity_t& affinity, entry_t* entry, void* param) {
 	std::lock_guard<std::mutex> lock{mutex};
 
@@ -57,6 +70,16 @@ void thread_pool_t::exec(affinity_t& affinity, entry_t* entry, void* param) {
 	thread_data[thread].cv.notify_one();
 }
 
+auto thread_pool_t::exec_on(size_t thread, entry_t* entry, void* param) -> bool {
+	std::lock_guard<std::mutex> lock{mutex};
+	if (thread >= thread_data.size() || thread_data[thread].should_exit) {
+		return false;
+	}
+	thread_data[thread].pinned.emplace_back(entry, param);
+	thread_data[thread].cv.notify_one();
+	return true;
+}
+
 void thread_pool_t::resize(size_t size) {
 	std::unique_lock<std::mutex> lock{mutex};
 	desired_size = size;
@@ -76,10 +99,20 @@ void thread_pool_t::resize(size_t size) {
 auto thread_pool_t::new_thread(std::lock_guard<std::mutex>& /*lock*/) -> size_t {
   thread_data.emplace_back();
 	auto& data = thread_data.back();
-  data.thread = std::thread{[this, &data]() {
+	size_t index = thread_data.size() - 1;
+  data.thread = std::thread{[this, &data, index]() {
+    pool_thread = true;
+    pool_thread_index = index;
     std::unique_lock<std::mutex> lock{mutex};
-    while (!data.should_exit) {
-      if (data.entry == nullptr) {
+    while (!data.should_exit || !data.pinned.empty()) {
+      if (!data.pinned.empty()) {
+        // Pinned work goes first, it may be waited on by whatever `exec` handed this thread
+        auto pinned = data.pinned.front();
+        data.pinned.pop_front();
+        lock.unlock();
+        pinned.first(true, pinned.second);
+        lock.lock();
+      } else if (data.entry == nullptr) {
         data.cv.wait(lock);
       } else {
         entry_t* entry = data.entry;
@@ -92,7 +125,7 @@ auto thread_pool_t::new_thread(std::lock_guard<std::mutex>& /*lock*/) -> size_t
       }
     }
   }};
-	return thread_data.size() - 1;
+	return index;
 }
 
 } // namespace ivm
@@ -5,6 +5,7 @@
 #include <mutex>
 #include <thread>
 #include <unordered_set>
+#include <utility>
 
 namespace ivm {
 
@@ -23,7 +24,14 @@ class thread_pool_t {
 		auto operator= (const thread_pool_t&) = delete;
 
 		void exec(affinity_t& affinity, entry_t* entry, void* param);
+		// Runs `entry` on the pool thread `thread` before it takes any other work, once its current
+		// task is done. Returns false if that thread is gone.
+		auto exec_on(size_t thread, entry_t* entry, void* param) -> bool;
 		void resize(size_t size);
+		// True on threads which stay around for more work after their task finishes
+		static auto is_pool_thread() -> bool;
+		// Index of the calling pool thread, for `exec_on`
+		static auto current_thread() -> size_t;
 
 	private:
 		auto new_thread(std::lock_guard<std::mutex>& /*lock*/) -> size_t;
@@ -33,6 +41,7 @@ class thread_pool_t {
 			std::condition_variable cv;
 			entry_t* entry = nullptr;
 			void* param = nullptr;
+			std::deque<std::pair<entry_t*, void*>> pinned;
 			bool should_exit = false;
 		};
 
@@ -19,21 +19,28 @@ struct timer_data_t {
 		std::chrono::steady_clock::time_point timeout,
 		void** holder,
 		timer_t::callback_t callback,
+		timer_t::postpone_t postpone,
 		const std::lock_guard<std::mutex>& /*lock*/
-	) : callback{std::move(callback)}, holder{holder}, timeout{timeout} {
+	) : callback{std::move(callback)}, postpone{std::move(postpone)}, holder{holder}, timeout{timeout} {
 		if (holder != nullptr) {
 			last_holder_value = std::exchange(*holder, static_cast<void*>(this));
 		}
 	}
 
 	auto adjust() -> bool {
-		if (paused_duration == std::chrono::steady_clock::duration{}) {
-			return false;
-		} else {
+		if (paused_duration != std::chrono::steady_clock::duration{}) {
 			timeout += paused_duration;
 			paused_duration = {};
 			return true;
 		}
+		if (postpone) {
+			auto duration = postpone();
+			if (duration > std::chrono::steady_clock::duration{}) {
+				timeout = std::chrono::steady_clock::now() + duration;
+				return true;
+			}
+		}
+		return false;
 	}
 
 	auto is_paused() const -> bool {
@@ -56,6 +63,7 @@ struct timer_data_t {
 	};
 
 	timer_t::callback_t callback;
+	timer_t::postpone_t postpone;
 	void** holder = nullptr;
 	void* last_holder_value;
 	std::chrono::steady_clock::time_point timeout;
@@ -173,11 +181,11 @@ struct timer_thread_t {
 /**
  * timer_t implementation
  */
-timer_t::timer_t(uint32_t ms, void** holder, const callback_t& callback) {
+timer_t::timer_t(uint32_t ms, void** holder, const callback_t& callback, postpone_t postpone) {
 	std::lock_guard<std::mutex> lock{global_shared_state->mutex};
 	data = std::make_shared<timer_data_t>(
 		std::chrono::steady_clock::now() + std::chrono::milliseconds{ms},
-		holder, callback,
+		holder, callback, std::move(postpone),
 		lock
 	);
 	timer_thread_t::start_or_join_timer(data, lock);
@@ -226,7 +234,7 @@ void timer_t::wait_detached(uint32_t ms, const callback_t& callback) {
 	std::lock_guard<std::mutex> lock{global_shared_state->mutex};
 	timer_thread_t::start_or_join_timer(std::make_shared<timer_data_t>(
 		std::chrono::steady_clock::now() + std::chrono::milliseconds{ms},
-		nullptr, callback, lock
+		nullptr, callback, timer_t::postpone_t{}, lock
 	), lock);
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <chrono>
 #include <memory>
 #include <functional>
 
@@ -13,9 +14,12 @@ struct timer_data_t;
 class timer_t {
 	public:
 		using callback_t = std::function<void(void*)>;
+		// Invoked on the timer thread when the timer comes due, returns how much longer to wait or 0
+		// to run the callback now. The timer mutex is held, so this must not block.
+		using postpone_t = std::function<std::chrono::steady_clock::duration()>;
 
 		// Runs a callback unless the `timer_t` destructor is called.
-		timer_t(uint32_t ms, void** holder, const callback_t& callback);
+		timer_t(uint32_t ms, void** holder, const callback_t& callback, postpone_t postpone = {});
 		timer_t(uint32_t ms, const callback_t& callback) : timer_t{ms, nullptr, callback} {}
 		timer_t(const timer_t&) = delete;
 		~timer_t();
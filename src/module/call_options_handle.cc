@@ -0,0 +1,35 @@
+#include "call_options_handle.h"
+
+using namespace v8;
+
+namespace ivm {
+
+/**
+ * CallOptionsHandle implementation
+ */
+CallOptionsHandle::CallOptionsHandle(Local<Object> options) :
+	transfer_options{options},
+	arguments_transfer_options{ReadOption<MaybeLocal<Object>>(options, StringTable::Get().arguments, {})},
+	result_transfer_options{ReadOption<MaybeLocal<Object>>(options, StringTable::Get().result, {})},
+	timeout{static_cast<uint32_t>(ReadOption<int32_t>(options, StringTable::Get().timeout, 0))},
+	cpu_timeout{static_cast<uint32_t>(ReadOption<int32_t>(options, StringTable::Get().cpuTimeout, 0))},
+	accessors{ReadOption<bool>(options, StringTable::Get().accessors, false)},
+	release{ReadOption<bool>(options, StringTable::Get().release, false)} {}
+
+auto CallOptionsHandle::Definition() -> Local<FunctionTemplate> {
+	return MakeClass("CallOptions", ConstructorFunction<decltype(&New), &New>{});
+}
+
+auto CallOptionsHandle::New(Local<Object> options) -> std::unique_ptr<CallOptionsHandle> {
+	return std::make_unique<CallOptionsHandle>(options);
+}
+
+auto CallOptionsHandle::Find(MaybeLocal<Object> maybe_options) -> const CallOptionsHandle* {
+	Local<Object> options;
+	if (maybe_options.ToLocal(&options)) {
+		return ClassHandle::Unwrap<CallOptionsHandle>(options);
+	}
+	return nullptr;
+}
+
+} // namespace ivm
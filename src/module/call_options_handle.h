@@ -0,0 +1,32 @@
+#pragma once
+#include "isolate/class_handle.h"
+#include "transferable.h"
+#include <v8.h>
+#include <memory>
+
+namespace ivm {
+
+/**
+ * Options for `apply`, `get`, `set`, `eval`, `evalClosure`, and `run` which are parsed and
+ * validated once, and can then be passed in place of an options object on every call.
+ */
+class CallOptionsHandle final : public ClassHandle {
+	public:
+		explicit CallOptionsHandle(v8::Local<v8::Object> options);
+
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+		static auto New(v8::Local<v8::Object> options) -> std::unique_ptr<CallOptionsHandle>;
+		// Returns the parsed options if `maybe_options` is a `CallOptions` instance
+		static auto Find(v8::MaybeLocal<v8::Object> maybe_options) -> const CallOptionsHandle*;
+
+		// Top-level `copy`, `externalCopy`, `reference`, and `promise`
+		TransferOptions transfer_options;
+		TransferOptions arguments_transfer_options;
+		TransferOptions result_transfer_options;
+		uint32_t timeout = 0;
+		uint32_t cpu_timeout = 0;
+		bool accessors = false;
+		bool release = false;
+};
+
+} // namespace ivm
@@ -0,0 +1,409 @@
+#include "channel_handle.h"
+#include "external_copy/serializer.h"
+#include "isolate/allocator.h"
+#include "isolate/environment.h"
+#include "isolate/functor_runners.h"
+#include "isolate/node_wrapper.h"
+#include <cstring>
+#include <vector>
+
+using namespace v8;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace ivm {
+
+namespace {
+
+enum class ViewType : uint8_t {
+	Uint8Array, Uint8ClampedArray, Int8Array, Uint16Array, Int16Array, Uint32Array, Int32Array,
+	Float32Array, Float64Array, BigInt64Array, BigUint64Array, DataView,
+};
+
+auto GetViewType(Local<ArrayBufferView> view) -> ViewType {
+	if (view->IsUint8Array()) {
+		return ViewType::Uint8Array;
+	} else if (view->IsUint8ClampedArray()) {
+		return ViewType::Uint8ClampedArray;
+	} else if (view->IsInt8Array()) {
+		return ViewType::Int8Array;
+	} else if (view->IsUint16Array()) {
+		return ViewType::Uint16Array;
+	} else if (view->IsInt16Array()) {
+		return ViewType::Int16Array;
+	} else if (view->IsUint32Array()) {
+		return ViewType::Uint32Array;
+	} else if (view->IsInt32Array()) {
+		return ViewType::Int32Array;
+	} else if (view->IsFloat32Array()) {
+		return ViewType::Float32Array;
+	} else if (view->IsFloat64Array()) {
+		return ViewType::Float64Array;
+	} else if (view->IsBigInt64Array()) {
+		return ViewType::BigInt64Array;
+	} else if (view->IsBigUint64Array()) {
+		return ViewType::BigUint64Array;
+	} else if (view->IsDataView()) {
+		return ViewType::DataView;
+	}
+	throw RuntimeTypeError("Unsupported ArrayBufferView type");
+}
+
+auto NewView(ViewType type, Local<ArrayBuffer> buffer) -> Local<Value> {
+	auto length = buffer->ByteLength();
+	switch (type) {
+		case ViewType::Uint8Array: return Uint8Array::New(buffer, 0, length);
+		case ViewType::Uint8ClampedArray: return Uint8ClampedArray::New(buffer, 0, length);
+		case ViewType::Int8Array: return Int8Array::New(buffer, 0, length);
+		case ViewType::Uint16Array: return Uint16Array::New(buffer, 0, length / 2);
+		case ViewType::Int16Array: return Int16Array::New(buffer, 0, length / 2);
+		case ViewType::Uint32Array: return Uint32Array::New(buffer, 0, length / 4);
+		case ViewType::Int32Array: return Int32Array::New(buffer, 0, length / 4);
+		case ViewType::Float32Array: return Float32Array::New(buffer, 0, length / 4);
+		case ViewType::Float64Array: return Float64Array::New(buffer, 0, length / 8);
+		case ViewType::BigInt64Array: return BigInt64Array::New(buffer, 0, length / 8);
+		case ViewType::BigUint64Array: return BigUint64Array::New(buffer, 0, length / 8);
+		case ViewType::DataView: return DataView::New(buffer, 0, length);
+	}
+	throw RuntimeTypeError("Corrupt channel message");
+}
+
+} // anonymous namespace
+
+/**
+ * Channel implementation
+ */
+Channel::Channel(size_t capacity) :
+	capacity{capacity},
+	data{std::make_unique<uint8_t[]>(capacity)},
+	headers{std::make_unique<std::atomic<uint32_t>[]>(capacity >> 3)} {}
+
+auto Channel::Send(Kind kind, const void* bytes, size_t length, const uint8_t* prefix) -> bool {
+	// Reserve space. A stale `head` only makes the channel look more full than it is.
+	auto size = RecordSize(length);
+	auto position = tail.load(std::memory_order_relaxed);
+	do {
+		if (position + size - head.load(std::memory_order_acquire) > capacity) {
+			return false;
+		}
+	} while (!tail.compare_exchange_weak(position, position + size, std::memory_order_relaxed));
+
+	// Copy the payload, which may wrap around the end of the ring, and then publish the header
+	auto skip = prefix == nullptr ? 0 : 1;
+	if (prefix != nullptr) {
+		data[position & (capacity - 1)] = *prefix;
+	}
+	auto offset = (position + skip) & (capacity - 1);
+	auto first = std::min(length - skip, capacity - offset);
+	std::memcpy(data.get() + offset, bytes, first);
+	std::memcpy(data.get(), static_cast<const uint8_t*>(bytes) + first, length - skip - first);
+	Header(position).store(static_cast<uint32_t>(length << 2) | static_cast<uint32_t>(kind), std::memory_order_release);
+
+	// Only wake a receiver if one is waiting on an empty channel. Pairs with the fence in `ArmWake`.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed) && waiting.exchange(false)) {
+		std::unique_lock<std::mutex> lock{mutex};
+		WakeWaiter(lock);
+	}
+	return true;
+}
+
+auto Channel::Peek(Kind& kind, size_t& length) -> bool {
+	auto header = Header(head.load(std::memory_order_relaxed)).load(std::memory_order_acquire);
+	if (header == 0) {
+		return false;
+	}
+	kind = static_cast<Kind>(header & 3);
+	length = header >> 2;
+	return true;
+}
+
+void Channel::CopyOut(void* bytes, size_t length, size_t skip) {
+	auto offset = (head.load(std::memory_order_relaxed) + skip) & (capacity - 1);
+	auto first = std::min(length, capacity - offset);
+	std::memcpy(bytes, data.get() + offset, first);
+	std::memcpy(static_cast<uint8_t*>(bytes) + first, data.get(), length - first);
+}
+
+void Channel::Pop(size_t length) {
+	auto position = head.load(std::memory_order_relaxed);
+	Header(position).store(0, std::memory_order_relaxed);
+	head.store(position + RecordSize(length), std::memory_order_release);
+}
+
+void Channel::ArmWake(std::unique_lock<std::mutex>& lock) {
+	if (waiters.empty()) {
+		return;
+	}
+	// Pairs with the fence in `Send`. Either the sender sees `waiting` or we see its message.
+	waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	Kind kind;
+	size_t length;
+	if (Peek(kind, length) && waiting.exchange(false)) {
+		WakeWaiter(lock);
+	}
+}
+
+void Channel::WakeWaiter(std::unique_lock<std::mutex>& lock) {
+	while (!waiters.empty()) {
+		auto holder = waiters.front().remotes.GetSharedIsolateHolder();
+		if (holder->GetIsolate()) {
+			lock.unlock();
+			ChannelHandle::ScheduleDrain(holder, shared_from_this());
+			return;
+		}
+		// This receiver's isolate was disposed
+		waiters.pop_front();
+	}
+}
+
+/**
+ * Runs in the receiving isolate after a message arrives for the first pending `receive()`
+ */
+class ChannelHandle::DrainTask : public Runnable {
+	public:
+		explicit DrainTask(shared_ptr<Channel> channel) : channel{std::move(channel)} {}
+		void Run() final { ChannelHandle::Drain(*channel); }
+
+	private:
+		shared_ptr<Channel> channel;
+};
+
+/**
+ * ChannelHandle implementation
+ */
+auto ChannelHandle::ChannelTransferable::TransferIn() -> Local<Value> {
+	return ClassHandle::NewInstance<ChannelHandle>(channel);
+}
+
+ChannelHandle::ChannelHandle(shared_ptr<Channel> channel) : channel{std::move(channel)} {
+	Isolate::GetCurrent()->AdjustAmountOfExternalAllocatedMemory(this->channel->Capacity());
+}
+
+ChannelHandle::~ChannelHandle() {
+	Isolate::GetCurrent()->AdjustAmountOfExternalAllocatedMemory(-static_cast<int64_t>(channel->Capacity()));
+}
+
+auto ChannelHandle::Definition() -> Local<FunctionTemplate> {
+	return Inherit<TransferableHandle>(MakeClass(
+		"Channel", ConstructorFunction<decltype(&New), &New>{},
+		"capacity", MemberAccessor<decltype(&ChannelHandle::CapacityGetter), &ChannelHandle::CapacityGetter>{},
+		"receive", MemberFunction<decltype(&ChannelHandle::Receive), &ChannelHandle::Receive>{},
+		"send", MemberFunction<decltype(&ChannelHandle::Send), &ChannelHandle::Send>{},
+		"tryReceive", MemberFunction<decltype(&ChannelHandle::TryReceive), &ChannelHandle::TryReceive>{}
+	));
+}
+
+auto ChannelHandle::New(MaybeLocal<Object> maybe_options) -> unique_ptr<ChannelHandle> {
+	auto capacity = ReadOption<double>(maybe_options, StringTable::Get().capacity, 64 * 1024);
+	if (!(capacity > 0) || capacity > (1 << 30)) {
+		throw RuntimeRangeError("`capacity` must be between 1 and 1073741824");
+	}
+	// Round up to a power of two so positions can be masked
+	size_t rounded = 64;
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	return std::make_unique<ChannelHandle>(std::make_shared<Channel>(rounded));
+}
+
+auto ChannelHandle::TransferOut() -> unique_ptr<Transferable> {
+	return std::make_unique<ChannelTransferable>(channel);
+}
+
+/**
+ * Reads the message at the head of the channel into the current isolate. The message is consumed
+ * even if this fails, otherwise a bad message would block the channel forever.
+ */
+auto ChannelHandle::ReadMessage(Channel& channel) -> Local<Value> {
+	auto* isolate = Isolate::GetCurrent();
+	Channel::Kind kind;
+	size_t length;
+	channel.Peek(kind, length);
+	if (kind == Channel::Kind::Serialized) {
+		std::vector<uint8_t> buffer(length);
+		channel.CopyOut(buffer.data(), length);
+		channel.Pop(length);
+		auto context = isolate->GetCurrentContext();
+		std::deque<unique_ptr<Transferable>> transferables;
+		std::deque<uint32_t> array_buffer_view_indexes;
+		std::deque<CompiledWasmModule> wasm_modules;
+		detail::DeserializerDelegate delegate{transferables, array_buffer_view_indexes, wasm_modules};
+		ValueDeserializer deserializer{isolate, buffer.data(), length, &delegate};
+		delegate.SetDeserializer(&deserializer);
+		auto* allocator = IsolateEnvironment::GetCurrent().GetLimitedAllocator();
+		int failures = allocator == nullptr ? 0 : allocator->GetFailureCount();
+		Unmaybe(deserializer.ReadHeader(context));
+		Local<Value> value;
+		if (!deserializer.ReadValue(context).ToLocal(&value)) {
+			if (allocator != nullptr && allocator->GetFailureCount() != failures) {
+				throw RuntimeRangeError("Array buffer allocation failed");
+			}
+			throw RuntimeError();
+		}
+		return value;
+	} else {
+		uint8_t view_type = 0;
+		size_t skip = 0;
+		if (kind == Channel::Kind::View) {
+			channel.CopyOut(&view_type, 1);
+			skip = 1;
+		}
+		auto byte_length = length - skip;
+		auto* allocator = IsolateEnvironment::GetCurrent().GetLimitedAllocator();
+		if (allocator != nullptr && !allocator->Check(byte_length)) {
+			// ArrayBuffer::New will crash the process if there is an allocation failure
+			channel.Pop(length);
+			throw RuntimeRangeError("Array buffer allocation failed");
+		}
+		auto array_buffer = ArrayBuffer::New(isolate, byte_length);
+		channel.CopyOut(array_buffer->GetBackingStore()->Data(), byte_length, skip);
+		channel.Pop(length);
+		if (kind == Channel::Kind::View) {
+			return NewView(static_cast<ViewType>(view_type), array_buffer);
+		}
+		return array_buffer;
+	}
+}
+
+void ChannelHandle::ScheduleDrain(const shared_ptr<IsolateHolder>& holder, shared_ptr<Channel> channel) {
+	holder->ScheduleTask(std::make_unique<DrainTask>(std::move(channel)), false, true);
+}
+
+/**
+ * Resolves pending `receive()` promises which belong to the current isolate, in order, for as long
+ * as there are messages available.
+ */
+void ChannelHandle::Drain(Channel& channel) {
+	struct Result {
+		Channel::Waiter waiter;
+		Local<Value> value;
+		bool rejected;
+	};
+	auto* isolate = Isolate::GetCurrent();
+	auto* holder = IsolateEnvironment::GetCurrentHolder().get();
+	std::vector<Result> results;
+	{
+		std::unique_lock<std::mutex> lock{channel.mutex};
+		Channel::Kind kind;
+		size_t length;
+		while (
+			!channel.waiters.empty() &&
+			channel.waiters.front().remotes.GetIsolateHolder() == holder &&
+			channel.Peek(kind, length)
+		) {
+			auto waiter = std::move(channel.waiters.front());
+			channel.waiters.pop_front();
+			Context::Scope context_scope{waiter.remotes.Deref<1>()};
+			Local<Value> value;
+			bool rejected = false;
+			FunctorRunners::RunCatchValue([&]() {
+				value = ReadMessage(channel);
+			}, [&](Local<Value> error) {
+				value = error;
+				rejected = true;
+			});
+			results.push_back(Result{std::move(waiter), value, rejected});
+		}
+		channel.ArmWake(lock);
+	}
+
+	for (auto& result : results) {
+		auto context = result.waiter.remotes.Deref<1>();
+		Context::Scope context_scope{context};
+		auto resolver = result.waiter.remotes.Deref<0>();
+		unique_ptr<node::CallbackScope> callback_scope;
+		if (IsolateEnvironment::GetCurrent().IsDefault()) {
+			callback_scope = std::make_unique<node::CallbackScope>(isolate, resolver, node::async_context{0, 0});
+		}
+		if (result.rejected) {
+			Unmaybe(resolver->Reject(context, result.value));
+		} else {
+			Unmaybe(resolver->Resolve(context, result.value));
+		}
+	}
+	isolate->PerformMicrotaskCheckpoint();
+}
+
+/**
+ * JS API functions
+ */
+auto ChannelHandle::Send(Local<Value> value) -> Local<Value> {
+	auto* isolate = Isolate::GetCurrent();
+	auto send = [&](Channel::Kind kind, const void* bytes, size_t length) {
+		if (length > channel->Capacity() - 8) {
+			throw RuntimeRangeError("Message is larger than the channel's capacity");
+		}
+		return Boolean::New(isolate, channel->Send(kind, bytes, length));
+	};
+
+	if (value->IsArrayBuffer()) {
+		auto array_buffer = value.As<ArrayBuffer>();
+		return send(Channel::Kind::ArrayBuffer, array_buffer->Data(), array_buffer->ByteLength());
+	} else if (value->IsArrayBufferView()) {
+		auto view = value.As<ArrayBufferView>();
+		auto* bytes = static_cast<uint8_t*>(view->Buffer()->Data()) + view->ByteOffset();
+		auto view_type = static_cast<uint8_t>(GetViewType(view));
+		if (view->ByteLength() + 1 > channel->Capacity() - 8) {
+			throw RuntimeRangeError("Message is larger than the channel's capacity");
+		}
+		return Boolean::New(isolate, channel->Send(Channel::Kind::View, bytes, view->ByteLength() + 1, &view_type));
+	}
+
+	// Anything else is serialized. Only plain data can be sent, since the ring holds bytes.
+	auto context = isolate->GetCurrentContext();
+	std::deque<unique_ptr<Transferable>> transferables;
+	std::deque<uint32_t> array_buffer_view_indexes;
+	std::deque<CompiledWasmModule> wasm_modules;
+	detail::SerializerDelegate delegate{transferables, array_buffer_view_indexes, wasm_modules};
+	ValueSerializer serializer{isolate, &delegate};
+	delegate.SetSerializer(&serializer);
+	serializer.WriteHeader();
+	Unmaybe(serializer.WriteValue(context, value));
+	auto serialized = serializer.Release();
+	unique_ptr<uint8_t, decltype(std::free)*> buffer{serialized.first, std::free};
+	if (!transferables.empty() || !wasm_modules.empty()) {
+		throw RuntimeTypeError("Channel messages cannot contain transferable handles, SharedArrayBuffer, or WebAssembly.Module");
+	}
+	return send(Channel::Kind::Serialized, buffer.get(), serialized.second);
+}
+
+auto ChannelHandle::TryReceive() -> Local<Value> {
+	std::lock_guard<std::mutex> lock{channel->mutex};
+	Channel::Kind kind;
+	size_t length;
+	// Messages are delivered to pending `receive()` calls first
+	if (channel->waiters.empty() && channel->Peek(kind, length)) {
+		return ReadMessage(*channel);
+	}
+	return Undefined(Isolate::GetCurrent());
+}
+
+auto ChannelHandle::Receive() -> Local<Value> {
+	auto context = Isolate::GetCurrent()->GetCurrentContext();
+	auto resolver = Unmaybe(Promise::Resolver::New(context));
+	std::unique_lock<std::mutex> lock{channel->mutex};
+	Channel::Kind kind;
+	size_t length;
+	if (channel->waiters.empty() && channel->Peek(kind, length)) {
+		// Fast path, a message is already waiting
+		FunctorRunners::RunCatchValue([&]() {
+			auto value = ReadMessage(*channel);
+			lock.unlock();
+			Unmaybe(resolver->Resolve(context, value));
+		}, [&](Local<Value> error) {
+			Unmaybe(resolver->Reject(context, error));
+		});
+	} else {
+		channel->waiters.push_back(Channel::Waiter{RemoteTuple<Promise::Resolver, Context>{resolver, context}});
+		channel->ArmWake(lock);
+	}
+	return resolver->GetPromise();
+}
+
+auto ChannelHandle::CapacityGetter() -> Local<Value> {
+	return Number::New(Isolate::GetCurrent(), static_cast<double>(channel->Capacity()));
+}
+
+} // namespace ivm
@@ -0,0 +1,98 @@
+#pragma once
+#include "isolate/remote_handle.h"
+#include "transferable.h"
+#include <v8.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace ivm {
+
+/**
+ * Multi-producer, single-consumer byte ring shared by every handle to a channel. Producers reserve
+ * space with a CAS on `tail` and publish a record by storing its header last, so `Send` never takes
+ * a lock. Receivers are serialized by `mutex`, which also guards the pending `receive()` promises.
+ */
+class Channel : public std::enable_shared_from_this<Channel> {
+	friend class ChannelHandle;
+	public:
+		// `View` payloads begin with one byte which records the type of the view
+		enum class Kind : uint32_t { ArrayBuffer = 1, View = 2, Serialized = 3 };
+
+		explicit Channel(size_t capacity);
+		Channel(const Channel&) = delete;
+		auto operator=(const Channel&) = delete;
+		~Channel() = default;
+
+		auto Capacity() const -> size_t { return capacity; }
+		// Returns false if there isn't room for this message right now. `prefix` is written in front of
+		// `data` and counts towards `length`.
+		auto Send(Kind kind, const void* data, size_t length, const uint8_t* prefix = nullptr) -> bool;
+
+	private:
+		struct Waiter {
+			RemoteTuple<v8::Promise::Resolver, v8::Context> remotes;
+		};
+
+		static auto RecordSize(size_t length) -> size_t { return length == 0 ? 8 : (length + 7) & ~size_t{7}; }
+		auto Header(uint64_t position) -> std::atomic<uint32_t>& { return headers[(position & (capacity - 1)) >> 3]; }
+
+		// Consumer interface, `mutex` must be held
+		auto Peek(Kind& kind, size_t& length) -> bool;
+		void CopyOut(void* data, size_t length, size_t skip = 0);
+		void Pop(size_t length);
+		void ArmWake(std::unique_lock<std::mutex>& lock);
+		void WakeWaiter(std::unique_lock<std::mutex>& lock);
+
+		const size_t capacity;
+		std::unique_ptr<uint8_t[]> data;
+		std::unique_ptr<std::atomic<uint32_t>[]> headers;
+		alignas(64) std::atomic<uint64_t> tail{0};
+		alignas(64) std::atomic<uint64_t> head{0};
+		alignas(64) std::atomic<bool> waiting{false};
+		std::mutex mutex;
+		std::deque<Waiter> waiters;
+};
+
+/**
+ * JS handle to a `Channel`. Every isolate which receives a transferred channel shares the same ring.
+ */
+class ChannelHandle final : public TransferableHandle {
+	private:
+		class ChannelTransferable : public Transferable {
+			public:
+				explicit ChannelTransferable(std::shared_ptr<Channel> channel) : channel{std::move(channel)} {}
+				auto TransferIn() -> v8::Local<v8::Value> final;
+
+			private:
+				std::shared_ptr<Channel> channel;
+		};
+
+		friend class Channel;
+		class DrainTask;
+
+		std::shared_ptr<Channel> channel;
+
+		static auto ReadMessage(Channel& channel) -> v8::Local<v8::Value>;
+		static void ScheduleDrain(const std::shared_ptr<IsolateHolder>& holder, std::shared_ptr<Channel> channel);
+		static void Drain(Channel& channel);
+
+	public:
+		explicit ChannelHandle(std::shared_ptr<Channel> channel);
+		ChannelHandle(const ChannelHandle&) = delete;
+		auto operator=(const ChannelHandle&) -> ChannelHandle& = delete;
+		~ChannelHandle() final;
+
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+		static auto New(v8::MaybeLocal<v8::Object> maybe_options) -> std::unique_ptr<ChannelHandle>;
+		auto TransferOut() -> std::unique_ptr<Transferable> final;
+
+		auto Send(v8::Local<v8::Value> value) -> v8::Local<v8::Value>;
+		auto TryReceive() -> v8::Local<v8::Value>;
+		auto Receive() -> v8::Local<v8::Value>;
+		auto CapacityGetter() -> v8::Local<v8::Value>;
+};
+
+} // namespace ivm
@@ -1,6 +1,7 @@
 #include "isolate/run_with_timeout.h"
 #include "isolate/three_phase_task.h"
 #include "module/evaluation.h"
+#include "call_options_handle.h"
 #include "context_handle.h"
 #include "reference_handle.h"
 #include "transferable.h"
@@ -112,7 +113,13 @@ class EvalRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			if (!this->context) {
 				throw RuntimeGenericError("Context is released");
 			}
-			timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, timeout_ms);
+			if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+				timeout_ms = static_cast<int32_t>(call_options->timeout);
+				cpu_timeout_ms = static_cast<int32_t>(call_options->cpu_timeout);
+			} else {
+				timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, timeout_ms);
+				cpu_timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().cpuTimeout, cpu_timeout_ms);
+			}
 		}
 
 		void Phase2() final {
@@ -127,7 +134,7 @@ class EvalRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			});
 
 			// Execute script and transfer out
-			Local<Value> script_result = RunWithTimeout(timeout_ms, [&]() {
+			Local<Value> script_result = RunWithTimeout(timeout_ms, cpu_timeout_ms, [&]() {
 				return script->Run(context);
 			});
 			result = OptionalTransferOut(script_result, transfer_options);
@@ -143,6 +150,7 @@ class EvalRunner : public CodeCompilerHolder, public ThreePhaseTask {
 		RemoteHandle<Context> context;
 		std::unique_ptr<Transferable> result;
 		int32_t timeout_ms = 0;
+		int32_t cpu_timeout_ms = 0;
 };
 
 template <int Async>
@@ -162,11 +170,19 @@ class EvalClosureRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			MaybeLocal<Object> maybe_options
 		) :
 				CodeCompilerHolder{code, maybe_options},
-				transfer_options{ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().result, {})},
+				transfer_options{[&]() {
+					const auto* call_options = CallOptionsHandle::Find(maybe_options);
+					return call_options == nullptr ?
+						TransferOptions{ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().result, {})} :
+						call_options->result_transfer_options;
+				}()},
 				argv{[&]() {
 					// Transfer arguments out of isolate
 					std::vector<std::unique_ptr<Transferable>> argv;
-					TransferOptions transfer_options{ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().arguments, {})};
+					const auto* call_options = CallOptionsHandle::Find(maybe_options);
+					auto transfer_options = call_options == nullptr ?
+						TransferOptions{ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().arguments, {})} :
+						call_options->arguments_transfer_options;
 					ArrayRange arguments;
 					if (maybe_arguments.To(&arguments)) {
 						argv.reserve(std::distance(arguments.begin(), arguments.end()));
@@ -180,7 +196,13 @@ class EvalClosureRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			if (!this->context) {
 				throw RuntimeGenericError("Context is released");
 			}
-			timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, timeout_ms);
+			if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+				timeout_ms = static_cast<int32_t>(call_options->timeout);
+				cpu_timeout_ms = static_cast<int32_t>(call_options->cpu_timeout);
+			} else {
+				timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, timeout_ms);
+				cpu_timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().cpuTimeout, cpu_timeout_ms);
+			}
 		}
 
 		void Phase2() final {
@@ -216,7 +238,7 @@ class EvalClosureRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			}
 
 			// Execute script and transfer out
-			Local<Value> script_result = RunWithTimeout(timeout_ms, [&]() {
+			Local<Value> script_result = RunWithTimeout(timeout_ms, cpu_timeout_ms, [&]() {
 				return function->Call(
 					context, context->Global(),
 					argv_transferred.size(), argv_transferred.empty() ? nullptr : &argv_transferred[0]);
@@ -235,6 +257,7 @@ class EvalClosureRunner : public CodeCompilerHolder, public ThreePhaseTask {
 		RemoteHandle<Context> context;
 		std::unique_ptr<Transferable> result;
 		int32_t timeout_ms = 0;
+		int32_t cpu_timeout_ms = 0;
 };
 
 template <int Async>
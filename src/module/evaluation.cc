@@ -1,10 +1,241 @@
 #include "isolate/class_handle.h"
+#include "isolate/environment.h"
 #include "isolate/generic/read_option.h"
+#include "isolate/remote_handle.h"
+#include "lib/sha256.h"
 #include "external_copy_handle.h"
 #include "evaluation.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 using namespace v8;
 namespace ivm {
+namespace {
+
+/**
+ * Feeds an already copied string to v8's streaming compiler. v8 takes ownership of each chunk.
+ */
+class StringSourceStream final : public ScriptCompiler::ExternalSourceStream {
+	public:
+		explicit StringSourceStream(std::shared_ptr<std::vector<char>> value) : value{std::move(value)} {}
+
+		auto GetMoreData(const uint8_t** src) -> size_t final {
+			size_t length = std::min(kChunkSize, value->size() - offset);
+			if (length == 0) {
+				return 0;
+			}
+			auto* chunk = new uint8_t[length];
+			std::memcpy(chunk, value->data() + offset, length);
+			offset += length;
+			*src = chunk;
+			return length;
+		}
+
+	private:
+		// Even, so UTF-16 code units are never split
+		static constexpr size_t kChunkSize = 64 * 1024;
+		std::shared_ptr<std::vector<char>> value;
+		size_t offset = 0;
+};
+
+/**
+ * Feeds chunks which the host has pushed into a `SourceChunkQueue` to v8's streaming compiler.
+ */
+class ChunkQueueSourceStream final : public ScriptCompiler::ExternalSourceStream {
+	public:
+		explicit ChunkQueueSourceStream(std::shared_ptr<SourceChunkQueue> queue) : queue{std::move(queue)} {}
+
+		auto GetMoreData(const uint8_t** src) -> size_t final {
+			return queue->Pop(src);
+		}
+
+	private:
+		std::shared_ptr<SourceChunkQueue> queue;
+};
+
+/**
+ * Walks a sync or async iterable of source chunks in the default isolate and pushes them into a
+ * `SourceChunkQueue`. Each step waits on a promise, so this object is kept alive by the pending
+ * reaction until the iterator is exhausted.
+ */
+class SourceStreamPump final : public ClassHandle {
+	public:
+		SourceStreamPump(Local<Object> iterator, Local<Function> next, std::weak_ptr<SourceChunkQueue> queue) :
+			iterator{iterator}, next{next}, queue{std::move(queue)} {}
+
+		SourceStreamPump(const SourceStreamPump&) = delete;
+		auto operator=(const SourceStreamPump&) = delete;
+
+		~SourceStreamPump() final {
+			Close(std::make_unique<ExternalCopyError>(ExternalCopyError::ErrorType::Error, "Source stream was abandoned"));
+		}
+
+		static auto Definition() -> Local<FunctionTemplate> {
+			return MakeClass("SourceStreamPump", nullptr);
+		}
+
+		static void Start(Local<Object> source_iterable, std::weak_ptr<SourceChunkQueue> queue) {
+			auto* isolate = Isolate::GetCurrent();
+			auto context = isolate->GetCurrentContext();
+			auto method = Unmaybe(source_iterable->Get(context, Symbol::GetAsyncIterator(isolate)));
+			if (!method->IsFunction()) {
+				method = Unmaybe(source_iterable->Get(context, Symbol::GetIterator(isolate)));
+				if (!method->IsFunction()) {
+					throw RuntimeTypeError("`source` must be an iterable or async iterable");
+				}
+			}
+			auto iterator = Unmaybe(method.As<Function>()->Call(context, source_iterable, 0, nullptr));
+			if (!iterator->IsObject()) {
+				throw RuntimeTypeError("Result of the source iterator is not an object");
+			}
+			auto next = Unmaybe(iterator.As<Object>()->Get(context, StringTable::Get().next));
+			if (!next->IsFunction()) {
+				throw RuntimeTypeError("Source iterator has no `next` method");
+			}
+			auto handle = ClassHandle::NewInstance<SourceStreamPump>(iterator.As<Object>(), next.As<Function>(), std::move(queue));
+			ClassHandle::Unwrap<SourceStreamPump>(handle)->Next();
+		}
+
+	private:
+		void Next() {
+			if (queue.expired()) {
+				// The compiler went away, nothing left to do
+				Close({});
+				return;
+			}
+			auto* isolate = Isolate::GetCurrent();
+			auto context = isolate->GetCurrentContext();
+			FunctorRunners::RunCatchExternal(context, [&]() {
+				auto result = Unmaybe(next.Deref()->Call(context, iterator.Deref(), 0, nullptr));
+				// Resolve via Promise.resolve() so sync and async iterators are handled the same way
+				auto resolver = Unmaybe(Promise::Resolver::New(context));
+				auto handle = This();
+				Unmaybe(resolver->GetPromise()->Then(context,
+					Unmaybe(Function::New(context, FreeFunctionWithData<decltype(&Resolved), &Resolved>{}.callback, handle)),
+					Unmaybe(Function::New(context, FreeFunctionWithData<decltype(&Rejected), &Rejected>{}.callback, handle))
+				));
+				Unmaybe(resolver->Resolve(context, result));
+			}, [&](std::unique_ptr<ExternalCopy> error) {
+				Close(std::move(error));
+			});
+		}
+
+		static void Resolved(SourceStreamPump& that, Local<Value> result) {
+			auto context = Isolate::GetCurrent()->GetCurrentContext();
+			FunctorRunners::RunCatchExternal(context, [&]() {
+				if (!result->IsObject()) {
+					throw RuntimeTypeError("Source iterator result is not an object");
+				}
+				auto result_object = result.As<Object>();
+				if (Unmaybe(result_object->Get(context, StringTable::Get().done))->BooleanValue(Isolate::GetCurrent())) {
+					that.Close({});
+					return;
+				}
+				that.Push(Unmaybe(result_object->Get(context, StringTable::Get().value)));
+				that.Next();
+			}, [&](std::unique_ptr<ExternalCopy> error) {
+				that.Close(std::move(error));
+			});
+		}
+
+		static void Rejected(SourceStreamPump& that, Local<Value> error) {
+			that.Close(ExternalCopy::CopyThrownValue(error));
+		}
+
+		void Push(Local<Value> chunk) {
+			auto* isolate = Isolate::GetCurrent();
+			std::unique_ptr<uint8_t[]> data;
+			size_t length = 0;
+			if (chunk->IsObject()) {
+				auto* copy_handle = ClassHandle::Unwrap<ExternalCopyHandle>(chunk.As<Object>());
+				if (copy_handle != nullptr) {
+					chunk = copy_handle->GetValue()->CopyIntoCheckHeap();
+				}
+			}
+			if (chunk->IsString()) {
+				auto string = chunk.As<String>();
+				length = string->Utf8Length(isolate);
+				data = std::make_unique<uint8_t[]>(length);
+				string->WriteUtf8(isolate, reinterpret_cast<char*>(data.get()), length, nullptr, String::NO_NULL_TERMINATION);
+			} else if (chunk->IsArrayBufferView()) {
+				auto view = chunk.As<ArrayBufferView>();
+				length = view->ByteLength();
+				data = std::make_unique<uint8_t[]>(length);
+				view->CopyContents(data.get(), length);
+			} else if (chunk->IsArrayBuffer()) {
+				auto backing_store = chunk.As<ArrayBuffer>()->GetBackingStore();
+				length = backing_store->ByteLength();
+				data = std::make_unique<uint8_t[]>(length);
+				std::memcpy(data.get(), backing_store->Data(), length);
+			} else {
+				throw RuntimeTypeError("Source chunks must be strings, buffers, or ExternalCopy instances");
+			}
+			// An empty chunk would signal the end of the stream to v8
+			if (length != 0) {
+				auto ref = queue.lock();
+				if (ref) {
+					ref->Push(std::move(data), length);
+				}
+			}
+		}
+
+		void Close(std::unique_ptr<ExternalCopy> error) {
+			if (!closed) {
+				closed = true;
+				auto ref = queue.lock();
+				if (ref) {
+					ref->Close(std::move(error));
+				}
+			}
+		}
+
+		RemoteHandle<Object> iterator;
+		RemoteHandle<Function> next;
+		std::weak_ptr<SourceChunkQueue> queue;
+		bool closed = false;
+};
+
+} // anonymous namespace
+
+/**
+ * SourceChunkQueue implementation
+ */
+void SourceChunkQueue::Push(std::unique_ptr<uint8_t[]> chunk, size_t length) {
+	auto lock = state.write();
+	if (!lock->closed) {
+		lock->chunks.emplace_back(std::move(chunk), length);
+		state.notify_one();
+	}
+}
+
+void SourceChunkQueue::Close(std::unique_ptr<ExternalCopy> error) {
+	auto lock = state.write();
+	if (!lock->closed) {
+		lock->closed = true;
+		lock->error = std::move(error);
+		state.notify_one();
+	}
+}
+
+auto SourceChunkQueue::Pop(const uint8_t** chunk) -> size_t {
+	auto lock = state.write<true>();
+	while (lock->chunks.empty() && !lock->closed) {
+		lock.wait();
+	}
+	if (lock->chunks.empty() || lock->error) {
+		return 0;
+	}
+	auto [ data, length ] = std::move(lock->chunks.front());
+	lock->chunks.pop_front();
+	received.insert(received.end(), data.get(), data.get() + length);
+	*chunk = data.release();
+	return length;
+}
+
+auto SourceChunkQueue::TakeError() -> std::unique_ptr<ExternalCopy> {
+	return std::move(state.write()->error);
+}
 
 /**
  * ScriptOriginHolder implementation
@@ -37,10 +268,13 @@ ScriptOriginHolder::operator ScriptOrigin() const {
 /**
  * CodeCompilerHolder implementation
  */
-CodeCompilerHolder::CodeCompilerHolder(Local<String> code_handle, MaybeLocal<Object> maybe_options, bool is_module) :
+CodeCompilerHolder::CodeCompilerHolder(
+	Local<String> code_handle, MaybeLocal<Object> maybe_options, bool is_module, bool allow_streaming
+) :
 		script_origin_holder{maybe_options, is_module},
 		code_string{ExternalCopyString{code_handle}},
-		produce_cached_data{ReadOption<bool>(maybe_options, StringTable::Get().produceCachedData, {})} {
+		produce_cached_data{ReadOption<bool>(maybe_options, StringTable::Get().produceCachedData, {})},
+		allow_streaming{allow_streaming} {
 	// Read `cachedData`
 	auto maybe_cached_data = ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().cachedData, {});
 	Local<Object> cached_data;
@@ -60,6 +294,19 @@ CodeCompilerHolder::CodeCompilerHolder(Local<String> code_handle, MaybeLocal<Obj
 	}
 }
 
+CodeCompilerHolder::CodeCompilerHolder(
+	Local<Object> source_iterable, MaybeLocal<Object> maybe_options, bool is_module
+) :
+		script_origin_holder{maybe_options, is_module},
+		source_chunks{std::make_shared<SourceChunkQueue>()},
+		produce_cached_data{ReadOption<bool>(maybe_options, StringTable::Get().produceCachedData, {})},
+		allow_streaming{true} {
+	if (!ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().cachedData, {}).IsEmpty()) {
+		throw RuntimeTypeError("`cachedData` is not supported for streamed sources");
+	}
+	SourceStreamPump::Start(source_iterable, source_chunks);
+}
+
 auto CodeCompilerHolder::GetCachedData() const -> std::unique_ptr<ScriptCompiler::CachedData> {
 	if (cached_data_in) {
 		return std::make_unique<ScriptCompiler::CachedData>(reinterpret_cast<const uint8_t*>(cached_data_in->Data()), cached_data_in_size);
@@ -77,7 +324,23 @@ auto CodeCompilerHolder::GetSource() -> std::unique_ptr<ScriptCompiler::Source>
 
 auto CodeCompilerHolder::GetSourceString() -> v8::Local<v8::String> {
 	if (code_string_handle.IsEmpty()) {
-		code_string_handle = code_string.CopyIntoCheckHeap().As<String>();
+		if (source_chunks) {
+			// Errors from the host's iterator take precedence over whatever v8 made of a partial source
+			auto error = source_chunks->TakeError();
+			if (error) {
+				Isolate::GetCurrent()->ThrowException(error->CopyInto());
+				throw RuntimeError();
+			}
+			const auto& received = source_chunks->GetReceived();
+			if (received.size() > static_cast<size_t>(String::kMaxLength)) {
+				throw RuntimeRangeError("Source is too large");
+			}
+			code_string_handle = Unmaybe(String::NewFromUtf8(
+				Isolate::GetCurrent(), received.data(), NewStringType::kNormal, static_cast<int>(received.size())
+			));
+		} else {
+			code_string_handle = code_string.CopyIntoCheckHeap().As<String>();
+		}
 	}
 	return code_string_handle;
 }
@@ -85,16 +348,113 @@ auto CodeCompilerHolder::GetSourceString() -> v8::Local<v8::String> {
 void CodeCompilerHolder::ResetSource() {
 	cached_data_in.reset();
 	code_string = {};
+	source_chunks.reset();
+	streaming_task.reset();
+	streamed_source.reset();
+	streaming_env.reset();
+}
+
+auto CodeCompilerHolder::ShouldStream() const -> bool {
+	// Consuming a code cache is already cheap
+	return source_chunks || (allow_streaming && !supplied_cached_data && code_string.Size() >= kStreamingThreshold);
+}
+
+auto CodeCompilerHolder::StartStreaming(ScriptType type) -> bool {
+	// Keeps the isolate alive until the streamed source is released. It is only missing if the isolate
+	// is being disposed, in which case the regular compile path will bail out.
+	streaming_env = IsolateEnvironment::GetCurrentHolder()->GetIsolate();
+	if (!streaming_env) {
+		if (source_chunks) {
+			throw RuntimeGenericError("Isolate is disposed");
+		}
+		return false;
+	}
+	if (source_chunks) {
+		streamed_source = std::make_unique<ScriptCompiler::StreamedSource>(
+			std::make_unique<ChunkQueueSourceStream>(source_chunks),
+			ScriptCompiler::StreamedSource::UTF8
+		);
+	} else {
+		streamed_source = std::make_unique<ScriptCompiler::StreamedSource>(
+			std::make_unique<StringSourceStream>(code_string.GetValue()),
+			code_string.IsOneByte() ? ScriptCompiler::StreamedSource::ONE_BYTE : ScriptCompiler::StreamedSource::TWO_BYTE
+		);
+	}
+	streaming_task.reset(ScriptCompiler::StartStreaming(Isolate::GetCurrent(), streamed_source.get(), type));
+	return true;
+}
+
+void CodeCompilerHolder::RunStreaming() {
+	streaming_task->Run();
+	streaming_task.reset();
+}
+
+void CodeCompilerHolder::LoadCodeCache() {
+	const auto& directory = IsolateEnvironment::GetCurrent().code_cache_directory;
+	if (directory.empty() || supplied_cached_data || source_chunks) {
+		return;
+	}
+	code_cache_path = directory + "/" + GetCodeCacheKey();
+	try {
+		cached_data_in = ExternalCopyArrayBuffer::FromFile(code_cache_path)->Acquire();
+	} catch (const RuntimeError& /*error*/) {
+		// Not cached yet
+		return;
+	}
+	cached_data_in_size = cached_data_in->ByteLength();
+	supplied_cached_data = true;
+}
+
+auto CodeCompilerHolder::GetCodeCacheKey() const -> std::string {
+	// v8 only checks the source length when consuming a cache, so the key has to identify the source
+	// exactly. v8's version tag covers both the v8 version and the flags that affect code caches.
+	sha256_t hash;
+	const auto& value = *code_string.GetValue();
+	hash.update(value.data(), value.size());
+	std::string key;
+	for (auto byte : hash.finish()) {
+		char hex[3];
+		std::snprintf(hex, sizeof(hex), "%02x", byte);
+		key += hex;
+	}
+	char suffix[32];
+	std::snprintf(
+		suffix, sizeof(suffix), "-%08x-%c%c.cache",
+		ScriptCompiler::CachedDataVersionTag(),
+		code_string.IsOneByte() ? '1' : '2',
+		script_origin_holder.IsModule() ? 'm' : 's'
+	);
+	return key+ suffix;
+}
+
+void CodeCompilerHolder::WriteCodeCache(const ExternalCopyArrayBuffer& cached_data) const {
+	// `WriteFile` renames a temporary file into place so other processes never see a partial cache.
+	// Failures are ignored because the cache is only an optimization.
+	try {
+		cached_data.WriteFile(code_cache_path);
+	} catch (const RuntimeError& /*error*/) {}
 }
 
 void CodeCompilerHolder::SaveCachedData(ScriptCompiler::CachedData* cached_data) {
 	if (cached_data != nullptr) {
-		cached_data_out = std::make_shared<ExternalCopyArrayBuffer>((void*)cached_data->data, cached_data->length);
-		cached_data->buffer_policy = ScriptCompiler::CachedData::BufferNotOwned;
-		delete cached_data;
+		auto copy = CachedDataToExternalCopy(cached_data);
+		if (!code_cache_path.empty()) {
+			// A rejected cache is replaced here as well
+			WriteCodeCache(*copy);
+		}
+		if (produce_cached_data) {
+			cached_data_out = std::move(copy);
+		}
 	}
 }
 
+auto CachedDataToExternalCopy(ScriptCompiler::CachedData* cached_data) -> std::shared_ptr<ExternalCopyArrayBuffer> {
+	auto copy = std::make_shared<ExternalCopyArrayBuffer>((void*)cached_data->data, cached_data->length);
+	cached_data->buffer_policy = ScriptCompiler::CachedData::BufferNotOwned;
+	delete cached_data;
+	return copy;
+}
+
 void CodeCompilerHolder::WriteCompileResults(Local<Object> handle) {
 	Isolate* isolate = Isolate::GetCurrent();
 	Local<Context> context = isolate->GetCurrentContext();
@@ -3,11 +3,15 @@
 #include "isolate/generic/handle_cast.h"
 #include "external_copy/external_copy.h"
 #include "external_copy/string.h"
+#include "lib/lockable.h"
 #include <v8.h>
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ivm {
+class IsolateEnvironment;
 
 /**
  * Parses script origin information from an option object and returns a non-v8 holder for the
@@ -18,6 +22,7 @@ class ScriptOriginHolder {
 	public:
 		explicit ScriptOriginHolder(v8::MaybeLocal<v8::Object> maybe_options, bool is_module = false);
 		explicit operator v8::ScriptOrigin() const;
+		auto IsModule() const { return is_module; }
 
 	private:
 		std::string filename = "<isolated-vm>";
@@ -26,6 +31,32 @@ class ScriptOriginHolder {
 		bool is_module;
 };
 
+/**
+ * UTF-8 source code which is handed to v8's streaming compiler a chunk at a time as the host reads
+ * it. Chunks are pushed from the default isolate and popped from a thread pool thread, which
+ * blocks until more input arrives or the stream is closed.
+ */
+class SourceChunkQueue {
+	public:
+		void Push(std::unique_ptr<uint8_t[]> chunk, size_t length);
+		void Close(std::unique_ptr<ExternalCopy> error = {});
+		auto Pop(const uint8_t** chunk) -> size_t;
+
+		// Only valid once `Pop` has returned 0
+		auto GetReceived() const -> const std::vector<char>& { return received; }
+		auto TakeError() -> std::unique_ptr<ExternalCopy>;
+
+	private:
+		struct State {
+			std::deque<std::pair<std::unique_ptr<uint8_t[]>, size_t>> chunks;
+			std::unique_ptr<ExternalCopy> error;
+			bool closed = false;
+		};
+		lockable_t<State, false, true> state;
+		// v8 takes ownership of each chunk but still needs the whole source to finalize the compile
+		std::vector<char> received;
+};
+
 /**
  * Parser and holder for all common v8 compilation information like code string, cached data, script
  * origin, etc.
@@ -33,30 +64,64 @@ class ScriptOriginHolder {
 class CodeCompilerHolder {
 	public:
 		CodeCompilerHolder(
-			v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options, bool is_module = false);
+			v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options,
+			bool is_module = false, bool allow_streaming = false);
+		// Source is read from a sync or async iterable of chunks and always streamed
+		CodeCompilerHolder(
+			v8::Local<v8::Object> source_iterable, v8::MaybeLocal<v8::Object> maybe_options, bool is_module = false);
 		auto DidSupplyCachedData() const { return supplied_cached_data; }
+		auto GetScriptOrigin() const -> v8::ScriptOrigin { return v8::ScriptOrigin{script_origin_holder}; }
 		auto GetSource() -> std::unique_ptr<v8::ScriptCompiler::Source>;
 		auto GetSourceString() -> v8::Local<v8::String>;
+		auto GetStreamedSource() const { return streamed_source.get(); }
+		// Consults the isolate's `codeCacheDir`, if any. Invoked in the isolate before compiling.
+		void LoadCodeCache();
 		void ResetSource();
 		void SaveCachedData(v8::ScriptCompiler::CachedData* cached_data);
 		void SetCachedDataRejected(bool rejected) { cached_data_rejected = rejected; }
-		auto ShouldProduceCachedData() const { return produce_cached_data && (!supplied_cached_data || cached_data_rejected); }
+		auto ShouldProduceCachedData() const {
+			return (produce_cached_data || !code_cache_path.empty()) && (!supplied_cached_data || cached_data_rejected);
+		}
 		void WriteCompileResults(v8::Local<v8::Object> handle);
 
+		// Large sources can be parsed and compiled off-thread. `StartStreaming` is invoked in the
+		// isolate, `RunStreaming` on any thread without the isolate locked, and then the result is
+		// finalized in the isolate by passing `GetStreamedSource()` to the compiler.
+		auto ShouldStream() const -> bool;
+		auto StartStreaming(v8::ScriptType type) -> bool;
+		void RunStreaming();
+
 	private:
 		auto GetCachedData() const -> std::unique_ptr<v8::ScriptCompiler::CachedData>;
+		auto GetCodeCacheKey() const -> std::string;
+		void WriteCodeCache(const ExternalCopyArrayBuffer& cached_data) const;
+
+		// Sources smaller than this aren't worth the extra trip through the thread pool
+		static constexpr int kStreamingThreshold = 64 * 1024;
 
 		ScriptOriginHolder script_origin_holder;
 		ExternalCopyString code_string;
+		std::shared_ptr<SourceChunkQueue> source_chunks;
+		// v8's streaming data refers back to the isolate, so it is kept alive until that is released
+		std::shared_ptr<IsolateEnvironment> streaming_env;
+		std::unique_ptr<v8::ScriptCompiler::StreamedSource> streamed_source;
+		std::unique_ptr<v8::ScriptCompiler::ScriptStreamingTask> streaming_task;
 		std::shared_ptr<ExternalCopyArrayBuffer> cached_data_out;
 		std::shared_ptr<v8::BackingStore> cached_data_in;
+		std::string code_cache_path;
 		mutable v8::Local<v8::String> code_string_handle;
 		size_t cached_data_in_size = 0;
 		bool cached_data_rejected = false;
 		bool produce_cached_data = false;
 		bool supplied_cached_data = false;
+		bool allow_streaming = false;
 };
 
+/**
+ * Takes ownership of cached data returned by v8 and wraps it in an ExternalCopy for the host.
+ */
+auto CachedDataToExternalCopy(v8::ScriptCompiler::CachedData* cached_data) -> std::shared_ptr<ExternalCopyArrayBuffer>;
+
 /**
  * Run a lambda which invokes the v8 compiler and annotate the exception with source / line number
  * if it throws.
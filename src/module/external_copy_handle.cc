@@ -31,9 +31,11 @@ auto ExternalCopyHandle::Definition() -> Local<FunctionTemplate> {
 	return Inherit<TransferableHandle>(MakeClass(
 		"ExternalCopy", ConstructorFunction<decltype(&New), &New>{},
 		"totalExternalSize", StaticAccessor<decltype(&ExternalCopyHandle::TotalExternalSizeGetter), &ExternalCopyHandle::TotalExternalSizeGetter>{},
+		"fromFile", FreeFunction<decltype(&ExternalCopyHandle::FromFile), &ExternalCopyHandle::FromFile>{},
 		"copy", MemberFunction<decltype(&ExternalCopyHandle::Copy), &ExternalCopyHandle::Copy>{},
 		"copyInto", MemberFunction<decltype(&ExternalCopyHandle::CopyInto), &ExternalCopyHandle::CopyInto>{},
-		"release", MemberFunction<decltype(&ExternalCopyHandle::Release), &ExternalCopyHandle::Release>{}
+		"release", MemberFunction<decltype(&ExternalCopyHandle::Release), &ExternalCopyHandle::Release>{},
+		"writeFile", MemberFunction<decltype(&ExternalCopyHandle::WriteFile), &ExternalCopyHandle::WriteFile>{}
 	));
 }
 
@@ -44,10 +46,18 @@ auto ExternalCopyHandle::TransferOut() -> unique_ptr<Transferable> {
 auto ExternalCopyHandle::New(Local<Value> value, MaybeLocal<Object> maybe_options) -> unique_ptr<ExternalCopyHandle> {
 	Local<Object> options;
 	bool transfer_out = false;
+	bool copy_on_write = false;
 	ArrayRange transfer_list;
 	if (maybe_options.ToLocal(&options)) {
 		transfer_out = ReadOption<bool>(options, StringTable::Get().transferOut, false);
 		transfer_list = ReadOption<ArrayRange>(options, StringTable::Get().transferList, {});
+		copy_on_write = ReadOption<bool>(options, StringTable::Get().copyOnWrite, false);
+	}
+	if (copy_on_write) {
+		if (!value->IsArrayBuffer()) {
+			throw RuntimeTypeError("`copyOnWrite` requires an ArrayBuffer");
+		}
+		return std::make_unique<ExternalCopyHandle>(shared_ptr<ExternalCopy>(ExternalCopyArrayBuffer::CopyOnWrite(value.As<ArrayBuffer>())));
 	}
 	return std::make_unique<ExternalCopyHandle>(shared_ptr<ExternalCopy>(ExternalCopy::Copy(value, transfer_out, transfer_list)));
 }
@@ -65,6 +75,11 @@ auto ExternalCopyHandle::TotalExternalSizeGetter() -> Local<Value> {
 	return Number::New(Isolate::GetCurrent(), ExternalCopy::TotalExternalSize());
 }
 
+auto ExternalCopyHandle::FromFile(std::string path, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	bool map_copies = ReadOption<bool>(maybe_options, StringTable::Get().mmap, false);
+	return ClassHandle::NewInstance<ExternalCopyHandle>(shared_ptr<ExternalCopy>(ExternalCopyArrayBuffer::FromFile(path, map_copies)));
+}
+
 auto ExternalCopyHandle::Copy(MaybeLocal<Object> maybe_options) -> Local<Value> {
 	CheckDisposed();
 	bool release = ReadOption<bool>(maybe_options, StringTable::Get().release, false);
@@ -94,6 +109,16 @@ auto ExternalCopyHandle::Release() -> Local<Value> {
 	return Undefined(Isolate::GetCurrent());
 }
 
+auto ExternalCopyHandle::WriteFile(std::string path) -> Local<Value> {
+	CheckDisposed();
+	auto* array_buffer = dynamic_cast<ExternalCopyArrayBuffer*>(value.get());
+	if (array_buffer == nullptr) {
+		throw RuntimeTypeError("Only copies of an ArrayBuffer can be written to a file");
+	}
+	array_buffer->WriteFile(path);
+	return Undefined(Isolate::GetCurrent());
+}
+
 /**
  * ExternalCopyIntoHandle implementation
  */
@@ -2,6 +2,7 @@
 #include <v8.h>
 #include "transferable.h"
 #include <memory>
+#include <string>
 
 namespace ivm {
 
@@ -31,9 +32,11 @@ class ExternalCopyHandle final : public TransferableHandle {
 
 		static auto New(v8::Local<v8::Value> value, v8::MaybeLocal<v8::Object> maybe_options) -> std::unique_ptr<ExternalCopyHandle>;
 		static auto TotalExternalSizeGetter() -> v8::Local<v8::Value>;
+		static auto FromFile(std::string path, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 		auto Copy(v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 		auto CopyInto(v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 		auto Release() -> v8::Local<v8::Value>;
+		auto WriteFile(std::string path) -> v8::Local<v8::Value>;
 		auto GetValue() const -> std::shared_ptr<ExternalCopy> { return value; }
 
 	private:
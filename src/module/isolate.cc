@@ -4,12 +4,17 @@
 #include "isolate/scheduler.h"
 #include "isolate/util.h"
 #include "lib/lockable.h"
+#include "call_options_handle.h"
 #include "callback.h"
+#include "channel_handle.h"
 #include "context_handle.h"
 #include "external_copy_handle.h"
 #include "isolate_handle.h"
 #include "lib_handle.h"
+#include "message_port_handle.h"
+#include "module_handle.h"
 #include "native_module_handle.h"
+#include "pipeline_handle.h"
 #include "reference_handle.h"
 #include "script_handle.h"
 
@@ -38,11 +43,17 @@ class LibraryHandle : public TransferableHandle {
 		static auto Definition() -> Local<FunctionTemplate> {
 			return Inherit<TransferableHandle>(MakeClass(
 				"isolated_vm", nullptr,
+				"CallOptions", ClassHandle::GetFunctionTemplate<CallOptionsHandle>(),
 				"Callback", ClassHandle::GetFunctionTemplate<CallbackHandle>(),
+				"Channel", ClassHandle::GetFunctionTemplate<ChannelHandle>(),
 				"Context", ClassHandle::GetFunctionTemplate<ContextHandle>(),
 				"ExternalCopy", ClassHandle::GetFunctionTemplate<ExternalCopyHandle>(),
 				"Isolate", ClassHandle::GetFunctionTemplate<IsolateHandle>(),
+				"MessageChannel", ClassHandle::GetFunctionTemplate<MessageChannelHandle>(),
+				"MessagePort", ClassHandle::GetFunctionTemplate<MessagePortHandle>(),
+				"ModuleRegistry", ClassHandle::GetFunctionTemplate<ModuleRegistryHandle>(),
 				"NativeModule", ClassHandle::GetFunctionTemplate<NativeModuleHandle>(),
+				"Pipeline", ClassHandle::GetFunctionTemplate<PipelineHandle>(),
 				"Reference", ClassHandle::GetFunctionTemplate<ReferenceHandle>(),
 				"Script", ClassHandle::GetFunctionTemplate<ScriptHandle>()
 			));
@@ -64,11 +75,17 @@ class LibraryHandle : public TransferableHandle {
 				auto proto = Unmaybe(fn->Get(context, prototype)).As<Object>();
 				proto->SetIntegrityLevel(context, IntegrityLevel::kFrozen);
 			};
+			freeze("CallOptions");
 			freeze("Callback");
+			freeze("Channel");
 			freeze("Context");
 			freeze("ExternalCopy");
 			freeze("Isolate");
+			freeze("MessageChannel");
+			freeze("MessagePort");
+			freeze("ModuleRegistry");
 			freeze("NativeModule");
+			freeze("Pipeline");
 			freeze("Reference");
 			freeze("Script");
 
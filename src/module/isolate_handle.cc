@@ -4,6 +4,7 @@
 #include "isolate/holder.h"
 #include "script_handle.h"
 #include "module_handle.h"
+#include "pipeline_handle.h"
 #include "session_handle.h"
 #include "external_copy/external_copy.h"
 #include "lib/lockable.h"
@@ -11,6 +12,7 @@
 #include "isolate/functor_runners.h"
 #include "isolate/platform_delegate.h"
 #include "isolate/remote_handle.h"
+#include "isolate/scheduler.h"
 #include "isolate/three_phase_task.h"
 #include "isolate/v8_version.h"
 #include "module/evaluation.h"
@@ -43,8 +45,10 @@ auto IsolateHandle::Definition() -> Local<FunctionTemplate> {
 	return Inherit<TransferableHandle>(MakeClass(
 	 "Isolate", ConstructorFunction<decltype(&New), &New>{},
 		"createSnapshot", FreeFunction<decltype(&CreateSnapshot), &CreateSnapshot>{},
+		"createSnapshotAsync", FreeFunction<decltype(&CreateSnapshotAsync), &CreateSnapshotAsync>{},
 		"compileScript", MemberFunction<decltype(&IsolateHandle::CompileScript<1>), &IsolateHandle::CompileScript<1>>{},
 		"compileScriptSync", MemberFunction<decltype(&IsolateHandle::CompileScript<0>), &IsolateHandle::CompileScript<0>>{},
+		"compileScriptStream", MemberFunction<decltype(&IsolateHandle::CompileScriptStream), &IsolateHandle::CompileScriptStream>{},
 		"compileModule", MemberFunction<decltype(&IsolateHandle::CompileModule<1>), &IsolateHandle::CompileModule<1>>{},
 		"compileModuleSync", MemberFunction<decltype(&IsolateHandle::CompileModule<0>), &IsolateHandle::CompileModule<0>>{},
 		"cpuTime", MemberAccessor<decltype(&IsolateHandle::GetCpuTime), &IsolateHandle::GetCpuTime>{},
@@ -54,12 +58,14 @@ auto IsolateHandle::Definition() -> Local<FunctionTemplate> {
 		"dispose", MemberFunction<decltype(&IsolateHandle::Dispose), &IsolateHandle::Dispose>{},
 		"getHeapStatistics", MemberFunction<decltype(&IsolateHandle::GetHeapStatistics<1>), &IsolateHandle::GetHeapStatistics<1>>{},
 		"getHeapStatisticsSync", MemberFunction<decltype(&IsolateHandle::GetHeapStatistics<0>), &IsolateHandle::GetHeapStatistics<0>>{},
+		"pipeline", MemberFunction<decltype(&IsolateHandle::CreatePipeline), &IsolateHandle::CreatePipeline>{},
 		"isDisposed", MemberAccessor<decltype(&IsolateHandle::IsDisposedGetter), &IsolateHandle::IsDisposedGetter>{},
 		"referenceCount", MemberAccessor<decltype(&IsolateHandle::GetReferenceCount), &IsolateHandle::GetReferenceCount>{},
 		"wallTime", MemberAccessor<decltype(&IsolateHandle::GetWallTime), &IsolateHandle::GetWallTime>{},
 		"startCpuProfiler", MemberFunction<decltype(&IsolateHandle::StartCpuProfiler), &IsolateHandle::StartCpuProfiler>{},
 		"stopCpuProfiler", MemberFunction<decltype(&IsolateHandle::StopCpuProfiler<1>), &IsolateHandle::StopCpuProfiler<1>>{},
-		"setBufferPrototype", MemberFunction<decltype(&IsolateHandle::SetBufferPrototype), &IsolateHandle::SetBufferPrototype>{}
+		"setBufferPrototype", MemberFunction<decltype(&IsolateHandle::SetBufferPrototype), &IsolateHandle::SetBufferPrototype>{},
+		"setMemoryLimit", MemberFunction<decltype(&IsolateHandle::SetMemoryLimit), &IsolateHandle::SetMemoryLimit>{}
 	));
 }
 
@@ -69,9 +75,14 @@ auto IsolateHandle::Definition() -> Local<FunctionTemplate> {
 auto IsolateHandle::New(MaybeLocal<Object> maybe_options) -> unique_ptr<ClassHandle> {
 	shared_ptr<v8::BackingStore> snapshot_blob;
 	RemoteHandle<Function> error_handler;
+	std::string code_cache_directory;
 	size_t snapshot_blob_length = 0;
 	size_t memory_limit = 128;
 	bool inspector = false;
+	bool pooled_array_buffers = false;
+	double cpu_quota_ms = 0;
+	double cpu_quota_window_ms = 0;
+	double cpu_budget_ms = 0;
 
 	// Parse options
 	Local<Object> options;
@@ -103,6 +114,27 @@ auto IsolateHandle::New(MaybeLocal<Object> maybe_options) -> unique_ptr<ClassHan
 		// Check inspector flag
 		inspector = ReadOption<bool>(options, StringTable::Get().inspector, false);
 
+		// Persistent code cache
+		code_cache_directory = ReadOption<std::string>(options, StringTable::Get().codeCacheDir, {});
+
+		// Opt into the pooled ArrayBuffer allocator
+		pooled_array_buffers = ReadOption<bool>(options, StringTable::Get().pooledArrayBuffers, false);
+
+		// CPU quota
+		auto maybe_cpu_quota = ReadOption<MaybeLocal<Object>>(options, StringTable::Get().cpuQuota, {});
+		Local<Object> cpu_quota;
+		if (maybe_cpu_quota.ToLocal(&cpu_quota)) {
+			cpu_quota_ms = ReadOption<double>(cpu_quota, StringTable::Get().ms, 0);
+			cpu_quota_window_ms = ReadOption<double>(cpu_quota, StringTable::Get().windowMs, 1000);
+			cpu_budget_ms = ReadOption<double>(cpu_quota, StringTable::Get().budgetMs, 0);
+			if (!(cpu_quota_ms >= 0) || !(cpu_budget_ms >= 0)) {
+				throw RuntimeRangeError("`cpuQuota.ms` and `cpuQuota.budgetMs` must not be negative");
+			}
+			if (!(cpu_quota_window_ms >= 1)) {
+				throw RuntimeRangeError("`cpuQuota.windowMs` must be at least 1");
+			}
+		}
+
 		auto maybe_handler = ReadOption<MaybeLocal<Function>>(options, StringTable::Get().onCatastrophicError, {});
 		Local<Function> error_handler_local;
 		if (maybe_handler.ToLocal(&error_handler_local)) {
@@ -111,10 +143,34 @@ auto IsolateHandle::New(MaybeLocal<Object> maybe_options) -> unique_ptr<ClassHan
 	}
 
 	// Return isolate handle
-	auto holder = IsolateEnvironment::New(memory_limit, std::move(snapshot_blob), snapshot_blob_length);
+	auto holder = IsolateEnvironment::New(memory_limit, std::move(snapshot_blob), snapshot_blob_length, pooled_array_buffers);
 	auto env = holder->GetIsolate();
 	env->GetIsolate()->SetHostInitializeImportMetaObjectCallback(ModuleHandle::InitializeImportMeta);
+#if V8_AT_LEAST(10, 1, 1)
+	env->GetIsolate()->SetHostImportModuleDynamicallyCallback([](
+		Local<Context> context, Local<Data> /*host_defined_options*/, Local<Value> resource_name,
+		Local<String> specifier, Local<FixedArray> /*import_assertions*/
+	) {
+		return ModuleHandle::ImportModuleDynamically(context, resource_name, specifier);
+	});
+#else
+	env->GetIsolate()->SetHostImportModuleDynamicallyCallback([](
+		Local<Context> context, Local<ScriptOrModule> referrer,
+		Local<String> specifier, Local<FixedArray> /*import_assertions*/
+	) {
+		return ModuleHandle::ImportModuleDynamically(context, referrer->GetResourceName(), specifier);
+	});
+#endif
 	env->error_handler = error_handler;
+	env->code_cache_directory = std::move(code_cache_directory);
+	if (cpu_quota_ms > 0 || cpu_budget_ms > 0) {
+		using ms = std::chrono::duration<double, std::milli>;
+		env->SetCpuQuota(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(ms{cpu_quota_ms}),
+			std::chrono::duration_cast<std::chrono::nanoseconds>(ms{cpu_quota_window_ms}),
+			std::chrono::duration_cast<std::chrono::nanoseconds>(ms{cpu_budget_ms})
+		);
+	}
 	if (inspector) {
 		env->EnableInspectorAgent();
 	}
@@ -130,11 +186,13 @@ auto IsolateHandle::TransferOut() -> unique_ptr<Transferable> {
  */
 struct CreateContextRunner : public ThreePhaseTask {
 	bool enable_inspector = false;
+	std::string snapshot_context;
 	RemoteHandle<Context> context;
 	RemoteHandle<Value> global;
 
 	explicit CreateContextRunner(MaybeLocal<Object>& maybe_options) {
 		enable_inspector = ReadOption<bool>(maybe_options, StringTable::Get().inspector, false);
+		snapshot_context = ReadOption<std::string>(maybe_options, StringTable::Get().snapshot, {});
 	}
 
 	void Phase2() final {
@@ -157,7 +215,13 @@ struct CreateContextRunner : public ThreePhaseTask {
 
 		// Make a new context and setup shared pointers
 		IsolateEnvironment::HeapCheck heap_check{env, true};
-		Local<Context> context_handle = env.NewContext();
+		Local<Context> context_handle;
+		if (snapshot_context.empty()) {
+			context_handle = env.NewContext();
+		} else if (!env.NewContext(snapshot_context).ToLocal(&context_handle)) {
+			Context::Scope context_scope{env.DefaultContext()};
+			throw RuntimeGenericError("Snapshot does not contain a context named `"+ snapshot_context+ "`");
+		}
 		if (enable_inspector) {
 			env.GetInspectorAgent()->ContextCreated(context_handle, "<isolated-vm>");
 		}
@@ -182,10 +246,17 @@ auto IsolateHandle::CreateContext(MaybeLocal<Object> maybe_options) -> Local<Val
 struct CompileScriptRunner : public CodeCompilerHolder, public ThreePhaseTask {
 	RemoteHandle<UnboundScript> script;
 
-	CompileScriptRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options) :
-		CodeCompilerHolder{code_handle, maybe_options, false} {}
+	CompileScriptRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, bool allow_streaming) :
+		CodeCompilerHolder{code_handle, maybe_options, false, allow_streaming} {}
+
+	CompileScriptRunner(const Local<Object>& source_iterable, const MaybeLocal<Object>& maybe_options) :
+		CodeCompilerHolder{source_iterable, maybe_options} {}
 
 	void Phase2() final {
+		LoadCodeCache();
+		if (ShouldStream() && StartStreaming(ScriptType::kClassic)) {
+			return;
+		}
 		// Compile in second isolate and return UnboundScript persistent
 		auto& isolate = IsolateEnvironment::GetCurrent();
 		Context::Scope context_scope(isolate.DefaultContext());
@@ -203,13 +274,38 @@ struct CompileScriptRunner : public CodeCompilerHolder, public ThreePhaseTask {
 		if (DidSupplyCachedData()) {
 			SetCachedDataRejected(source->GetCachedData()->rejected);
 		}
+		Finish();
+		heap_check.Epilogue();
+	}
+
+	auto HasBackgroundWork() -> bool final {
+		return GetStreamedSource() != nullptr;
+	}
+
+	void Phase2Background() final {
+		RunStreaming();
+	}
+
+	void Phase2Resume() final {
+		auto& isolate = IsolateEnvironment::GetCurrent();
+		Local<Context> context = isolate.DefaultContext();
+		Context::Scope context_scope(context);
+		IsolateEnvironment::HeapCheck heap_check{isolate, true};
+		auto source_string = GetSourceString();
+		script = RemoteHandle<UnboundScript>{RunWithAnnotatedErrors([&]() {
+			return Unmaybe(ScriptCompiler::Compile(context, GetStreamedSource(), source_string, GetScriptOrigin()))->GetUnboundScript();
+		})};
+		Finish();
+		heap_check.Epilogue();
+	}
+
+	void Finish() {
 		if (ShouldProduceCachedData()) {
 			ScriptCompiler::CachedData* cached_data = ScriptCompiler::CreateCodeCache(script.Deref());
 			assert(cached_data != nullptr);
 			SaveCachedData(cached_data);
 		}
 		ResetSource();
-		heap_check.Epilogue();
 	}
 
 	auto Phase3() -> Local<Value> final {
@@ -222,13 +318,34 @@ struct CompileScriptRunner : public CodeCompilerHolder, public ThreePhaseTask {
 
 struct StopCpuProfileRunner: public ThreePhaseTask {
 	const char* title_;
+	CpuProfileManager* manager = nullptr;
+	unsigned stop_id = 0;
+	bool pending = false;
 	std::vector<IVMCpuProfile> profiles;
 
 	explicit StopCpuProfileRunner(const char* title): title_(title) {}
 
 	void Phase2() final {
-		auto& isolate = IsolateEnvironment::GetCurrent();
-		profiles = isolate.GetCpuProfileManager()->StopProfiling(title_);
+		manager = IsolateEnvironment::GetCurrent().GetCpuProfileManager();
+		stop_id = manager->StopProfiling(title_);
+		pending = manager->IsStopPending(stop_id);
+		if (!pending) {
+			profiles = manager->TakeProfiles(stop_id);
+		}
+	}
+
+	// Sessions on other threads are stopped the next time those threads lock the isolate, so this
+	// waits for them with the isolate unlocked
+	auto HasBackgroundWork() -> bool final {
+		return pending;
+	}
+
+	void Phase2Background() final {
+		manager->WaitForStop(stop_id);
+	}
+
+	void Phase2Resume() final {
+		profiles = manager->TakeProfiles(stop_id);
 	}
 
 	auto Phase3() -> Local<Value> final {
@@ -249,7 +366,11 @@ struct StopCpuProfileRunner: public ThreePhaseTask {
 
 template <int async>
 auto IsolateHandle::CompileScript(Local<String> code_handle, MaybeLocal<Object> maybe_options) -> Local<Value> {
-	return ThreePhaseTask::Run<async, CompileScriptRunner>(*this->isolate, code_handle, maybe_options);
+	return ThreePhaseTask::Run<async, CompileScriptRunner>(*this->isolate, code_handle, maybe_options, async == 1);
+}
+
+auto IsolateHandle::CompileScriptStream(Local<Object> source_iterable, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	return ThreePhaseTask::Run<1, CompileScriptRunner>(*this->isolate, source_iterable, maybe_options);
 }
 
 /**
@@ -259,8 +380,8 @@ struct CompileModuleRunner : public CodeCompilerHolder, public ThreePhaseTask {
 	shared_ptr<ModuleInfo> module_info;
 	RemoteHandle<Function> meta_callback;
 
-	CompileModuleRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options) :
-		CodeCompilerHolder{code_handle, maybe_options, true} {
+	CompileModuleRunner(const Local<String>& code_handle, const MaybeLocal<Object>& maybe_options, bool allow_streaming) :
+		CodeCompilerHolder{code_handle, maybe_options, true, allow_streaming} {
 
 		auto maybe_meta_callback = ReadOption<MaybeLocal<Function>>(maybe_options, StringTable::Get().meta, {});
 		Local<Function> meta_callback;
@@ -270,17 +391,50 @@ struct CompileModuleRunner : public CodeCompilerHolder, public ThreePhaseTask {
 	}
 
 	void Phase2() final {
+		LoadCodeCache();
+		if (ShouldStream() && StartStreaming(ScriptType::kModule)) {
+			return;
+		}
 		auto& isolate = IsolateEnvironment::GetCurrent();
 		Context::Scope context_scope(isolate.DefaultContext());
 		IsolateEnvironment::HeapCheck heap_check{isolate, true};
 		auto source = GetSource();
+		ScriptCompiler::CompileOptions compile_options = ScriptCompiler::kNoCompileOptions;
+		if (DidSupplyCachedData()) {
+			compile_options = ScriptCompiler::kConsumeCodeCache;
+		}
 		auto module_handle = RunWithAnnotatedErrors(
-			[&]() { return Unmaybe(ScriptCompiler::CompileModule(isolate, source.get())); }
+			[&]() { return Unmaybe(ScriptCompiler::CompileModule(isolate, source.get(), compile_options)); }
 		);
 
 		if (DidSupplyCachedData()) {
 			SetCachedDataRejected(source->GetCachedData()->rejected);
 		}
+		Finish(module_handle);
+		heap_check.Epilogue();
+	}
+
+	auto HasBackgroundWork() -> bool final {
+		return GetStreamedSource() != nullptr;
+	}
+
+	void Phase2Background() final {
+		RunStreaming();
+	}
+
+	void Phase2Resume() final {
+		auto& isolate = IsolateEnvironment::GetCurrent();
+		Local<Context> context = isolate.DefaultContext();
+		Context::Scope context_scope(context);
+		IsolateEnvironment::HeapCheck heap_check{isolate, true};
+		auto module_handle = RunWithAnnotatedErrors([&]() {
+			return Unmaybe(ScriptCompiler::CompileModule(context, GetStreamedSource(), GetSourceString(), GetScriptOrigin()));
+		});
+		Finish(module_handle);
+		heap_check.Epilogue();
+	}
+
+	void Finish(Local<Module> module_handle) {
 		if (ShouldProduceCachedData()) {
 			ScriptCompiler::CachedData* cached_data = ScriptCompiler::CreateCodeCache(module_handle->GetUnboundModuleScript());
 			assert(cached_data != nullptr);
@@ -295,7 +449,6 @@ struct CompileModuleRunner : public CodeCompilerHolder, public ThreePhaseTask {
 			}
 			module_info->meta_callback = meta_callback;
 		}
-		heap_check.Epilogue();
 	}
 
 	auto Phase3() -> Local<Value> final {
@@ -307,12 +460,16 @@ struct CompileModuleRunner : public CodeCompilerHolder, public ThreePhaseTask {
 
 template <int async>
 auto IsolateHandle::CompileModule(Local<String> code_handle, MaybeLocal<Object> maybe_options) -> Local<Value> {
-	return ThreePhaseTask::Run<async, CompileModuleRunner>(*this->isolate, code_handle, maybe_options);
+	return ThreePhaseTask::Run<async, CompileModuleRunner>(*this->isolate, code_handle, maybe_options, async == 1);
 }
 
 /**
  * Create a new channel for debugging on the inspector
  */
+auto IsolateHandle::CreatePipeline() -> Local<Value> {
+	return ClassHandle::NewInstance<PipelineHandle>(isolate);
+}
+
 auto IsolateHandle::CreateInspectorSession() -> Local<Value> {
 	if (IsolateEnvironment::GetCurrentHolder() == isolate) {
 		throw RuntimeGenericError("An isolate is not debuggable from within itself");
@@ -343,7 +500,7 @@ auto IsolateHandle::Dispose() -> Local<Value> {
 struct HeapStatRunner : public ThreePhaseTask {
 	HeapStatistics heap;
 	size_t externally_allocated_size = 0;
-	size_t adjustment = 0;
+	ptrdiff_t adjustment = 0;
 
 	// Dummy constructor to workaround gcc bug
 	explicit HeapStatRunner(int /*unused*/) {}
@@ -351,7 +508,7 @@ struct HeapStatRunner : public ThreePhaseTask {
 	void Phase2() final {
 		IsolateEnvironment& isolate = IsolateEnvironment::GetCurrent();
 		isolate->GetHeapStatistics(&heap);
-		adjustment = heap.heap_size_limit() - isolate.GetInitialHeapSizeLimit();
+		adjustment = static_cast<ptrdiff_t>(heap.heap_size_limit()) - static_cast<ptrdiff_t>(isolate.GetHeapSizeLimit());
 		externally_allocated_size = isolate.GetExtraAllocatedMemory();
 	}
 
@@ -447,6 +604,21 @@ auto IsolateHandle::SetBufferPrototype(Local<Object> prototype) -> Local<Value>
 	return Undefined(Isolate::GetCurrent());
 }
 
+/**
+ * Change the memory limit of a live isolate
+ */
+auto IsolateHandle::SetMemoryLimit(double memory_limit) -> Local<Value> {
+	auto env = this->isolate->GetIsolate();
+	if (!env) {
+		throw RuntimeGenericError("Isolate is disposed");
+	}
+	if (!(memory_limit >= 8)) {
+		throw RuntimeGenericError("`memoryLimit` must be at least 8");
+	}
+	env->SetMemoryLimit(static_cast<size_t>(memory_limit));
+	return Undefined(Isolate::GetCurrent());
+}
+
 /**
  * Reference count
  */
@@ -472,154 +644,337 @@ static auto SerializeInternalFieldsCallback(Local<Object> /*holder*/, int /*inde
 	return {nullptr, 0};
 }
 
-auto IsolateHandle::CreateSnapshot(ArrayRange script_handles, MaybeLocal<String> warmup_handle) -> Local<Value> {
-
-	// Simple platform delegate and task queue
-	using TaskDeque = lockable_t<std::deque<std::unique_ptr<v8::Task>>>;
-	class SnapshotPlatformDelegate :
-			public node::IsolatePlatformDelegate, public TaskRunner,
-			public std::enable_shared_from_this<SnapshotPlatformDelegate> {
+static void DeserializeInternalFieldsCallback(Local<Object> /*holder*/, int /*index*/, StartupData /*payload*/, void* /*data*/) {
+}
 
-		public:
-			explicit SnapshotPlatformDelegate(TaskDeque& tasks) : tasks{tasks} {}
+namespace {
 
-			// v8 will continually post delayed tasks so we cut it off when work is done
-			void DoneWithWork() {
-				done = true;
+/**
+ * Inputs and result of a snapshot. Everything is copied out of the calling isolate up front so the
+ * snapshot itself can be created on any thread.
+ */
+class SnapshotBuilder {
+	public:
+		SnapshotBuilder(ArrayRange script_handles, MaybeLocal<String> warmup_handle, MaybeLocal<Object> maybe_options) {
+			// Copy embed scripts and warmup script from outer isolate
+			Isolate* isolate = Isolate::GetCurrent();
+			Local<Context> context = isolate->GetCurrentContext();
+			scripts = CopyScripts(script_handles);
+			if (!warmup_handle.IsEmpty()) {
+				warmup_script = ExternalCopyString{warmup_handle.ToLocalChecked().As<String>()};
 			}
 
-			// Methods for IsolatePlatformDelegate
-			auto GetForegroundTaskRunner() -> std::shared_ptr<v8::TaskRunner> final {
-			 return shared_from_this();
-			}
-			auto IdleTasksEnabled() -> bool final {
-				return false;
+			// Named contexts, each with its own prelude
+			auto maybe_contexts = ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().contexts, {});
+			Local<Object> contexts_handle;
+			if (maybe_contexts.ToLocal(&contexts_handle)) {
+				for (auto name : ArrayRange{Unmaybe(contexts_handle->GetOwnPropertyNames(context)), context}) {
+					Local<Value> context_scripts = Unmaybe(contexts_handle->Get(context, name));
+					if (!context_scripts->IsArray()) {
+						throw RuntimeTypeError("`contexts` must be an object of script arrays");
+					}
+					contexts.emplace_back(
+						*String::Utf8Value{isolate, name},
+						CopyScripts(ArrayRange{context_scripts.As<Array>(), context})
+					);
+				}
 			}
 
-			// Methods for v8::TaskRunner
-			void PostTask(std::unique_ptr<v8::Task> task) final {
-				tasks.write()->push_back(std::move(task));
-			}
-			void PostDelayedTask(std::unique_ptr<v8::Task> task, double /*delay_in_seconds*/) final {
-				if (!done) {
-					PostTask(std::move(task));
+			// Snapshot to derive this one from
+			auto maybe_snapshot = ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().snapshot, {});
+			Local<Object> snapshot_handle;
+			if (maybe_snapshot.ToLocal(&snapshot_handle)) {
+				auto* copy_handle = ClassHandle::Unwrap<ExternalCopyHandle>(snapshot_handle);
+				if (copy_handle != nullptr) {
+					auto* copy_ptr = dynamic_cast<ExternalCopyArrayBuffer*>(copy_handle->GetValue().get());
+					if (copy_ptr != nullptr) {
+						base_blob = copy_ptr->Acquire();
+					}
+				}
+				if (!base_blob) {
+					throw RuntimeTypeError("`snapshot` must be an ExternalCopy to ArrayBuffer");
+				}
+				// v8 doesn't deserialize extra contexts correctly from a snapshot which was itself derived
+				if (!contexts.empty()) {
+					throw RuntimeTypeError("`contexts` can't be combined with `snapshot`");
 				}
 			}
-			void PostNonNestableTask(std::unique_ptr<v8::Task> task) final {
-				PostTask(std::move(task));
-			}
-
-		private:
-			lockable_t<std::deque<std::unique_ptr<v8::Task>>>& tasks;
-			bool done = false;
-	};
-
-	TaskDeque tasks;
-	auto delegate = std::make_shared<SnapshotPlatformDelegate>(tasks);
-
-	// Copy embed scripts and warmup script from outer isolate
-	std::vector<std::pair<ExternalCopyString, ScriptOriginHolder>> scripts;
-	Isolate* isolate = Isolate::GetCurrent();
-	Local<Context> context = isolate->GetCurrentContext();
-	scripts.reserve(std::distance(script_handles.begin(), script_handles.end()));
-	for (auto value : script_handles) {
-		auto script_handle = HandleCast<Local<Object>>(value);
-		Local<Value> script = Unmaybe(script_handle.As<Object>()->Get(context, StringTable::Get().code));
-		if (!script->IsString()) {
-			throw RuntimeTypeError("`code` property is required");
 		}
-		scripts.emplace_back(ExternalCopyString{script.As<String>()}, ScriptOriginHolder{script_handle});
-	}
-	ExternalCopyString warmup_script;
-	if (!warmup_handle.IsEmpty()) {
-		warmup_script = ExternalCopyString{warmup_handle.ToLocalChecked().As<String>()};
-	}
-
-	// Create the snapshot
-	StartupData snapshot {};
-	unique_ptr<const char> snapshot_data_ptr;
-	shared_ptr<ExternalCopy> error;
-	{
-		Isolate* isolate;
-		isolate = Isolate::Allocate();
-		PlatformDelegate::RegisterIsolate(isolate, delegate.get());
-		SnapshotCreator snapshot_creator{isolate};
-		{
-			Locker locker(isolate);
-			Isolate::Scope isolate_scope(isolate);
-			HandleScope handle_scope(isolate);
-			Local<Context> context = Context::New(isolate);
-			snapshot_creator.SetDefaultContext(context, {&SerializeInternalFieldsCallback, nullptr});
-			FunctorRunners::RunCatchExternal(context, [&]() {
-				HandleScope handle_scope(isolate);
-				Local<Context> context_dirty = Context::New(isolate);
-				for (auto& script : scripts) {
-					Local<String> code = script.first.CopyInto().As<String>();
-					ScriptOrigin script_origin = ScriptOrigin{script.second};
-					ScriptCompiler::Source source{code, script_origin};
-					Local<UnboundScript> unbound_script;
-					{
-						Context::Scope context_scope{context};
-						Local<Script> compiled_script = RunWithAnnotatedErrors(
-							[&context, &source]() { return Unmaybe(ScriptCompiler::Compile(context, &source, ScriptCompiler::kNoCompileOptions)); }
-						);
-						Unmaybe(compiled_script->Run(context));
-						unbound_script = compiled_script->GetUnboundScript();
+
+		void Build() {
+			// Simple platform delegate and task queue
+			using TaskDeque = lockable_t<std::deque<std::unique_ptr<v8::Task>>>;
+			class SnapshotPlatformDelegate :
+					public node::IsolatePlatformDelegate, public TaskRunner,
+					public std::enable_shared_from_this<SnapshotPlatformDelegate> {
+
+				public:
+					explicit SnapshotPlatformDelegate(TaskDeque& tasks) : tasks{tasks} {}
+
+					// v8 will continually post delayed tasks so we cut it off when work is done
+					void DoneWithWork() {
+						done = true;
 					}
-					if (warmup_script) {
-						Context::Scope context_scope{context_dirty};
-						Unmaybe(unbound_script->BindToCurrentContext()->Run(context_dirty));
+
+					// Methods for IsolatePlatformDelegate
+					auto GetForegroundTaskRunner() -> std::shared_ptr<v8::TaskRunner> final {
+					 return shared_from_this();
 					}
-				}
-				if (warmup_script) {
-					Context::Scope context_scope{context_dirty};
-					MaybeLocal<Object> tmp;
-					ScriptOriginHolder script_origin{tmp};
-					ScriptCompiler::Source source{warmup_script.CopyInto().As<String>(), ScriptOrigin{script_origin}};
-					RunWithAnnotatedErrors([&context_dirty, &source]() {
-						Unmaybe(Unmaybe(ScriptCompiler::Compile(context_dirty, &source, ScriptCompiler::kNoCompileOptions))->Run(context_dirty));
+					auto IdleTasksEnabled() -> bool final {
+						return false;
+					}
+
+					// Methods for v8::TaskRunner
+					void PostTask(std::unique_ptr<v8::Task> task) final {
+						tasks.write()->push_back(std::move(task));
+					}
+					void PostDelayedTask(std::unique_ptr<v8::Task> task, double /*delay_in_seconds*/) final {
+						if (!done) {
+							PostTask(std::move(task));
+						}
+					}
+					void PostNonNestableTask(std::unique_ptr<v8::Task> task) final {
+						PostTask(std::move(task));
+					}
+
+				private:
+					lockable_t<std::deque<std::unique_ptr<v8::Task>>>& tasks;
+					bool done = false;
+			};
+
+			TaskDeque tasks;
+			auto delegate = std::make_shared<SnapshotPlatformDelegate>(tasks);
+
+			// Create the snapshot
+			StartupData base{};
+			if (base_blob) {
+				base.data = reinterpret_cast<const char*>(base_blob->Data());
+				base.raw_size = static_cast<int>(base_blob->ByteLength());
+			}
+			StartupData snapshot {};
+			{
+				Isolate* isolate;
+				isolate = Isolate::Allocate();
+				PlatformDelegate::RegisterIsolate(isolate, delegate.get());
+				SnapshotCreator snapshot_creator{isolate, nullptr, base_blob ? &base : nullptr};
+				{
+					Locker locker(isolate);
+					Isolate::Scope isolate_scope(isolate);
+					HandleScope handle_scope(isolate);
+					Local<Context> context = NewContext(isolate);
+					snapshot_creator.SetDefaultContext(context, {&SerializeInternalFieldsCallback, nullptr});
+					FunctorRunners::RunCatchExternal(context, [&]() {
+						HandleScope handle_scope(isolate);
+						Local<Context> context_dirty = NewContext(isolate);
+						for (auto& script : scripts) {
+							Local<String> code = script.first.CopyInto().As<String>();
+							ScriptOrigin script_origin = ScriptOrigin{script.second};
+							ScriptCompiler::Source source{code, script_origin};
+							Local<UnboundScript> unbound_script;
+							{
+								Context::Scope context_scope{context};
+								Local<Script> compiled_script = RunWithAnnotatedErrors(
+									[&context, &source]() { return Unmaybe(ScriptCompiler::Compile(context, &source, ScriptCompiler::kNoCompileOptions)); }
+								);
+								Unmaybe(compiled_script->Run(context));
+								unbound_script = compiled_script->GetUnboundScript();
+							}
+							if (warmup_script) {
+								Context::Scope context_scope{context_dirty};
+								Unmaybe(unbound_script->BindToCurrentContext()->Run(context_dirty));
+							}
+						}
+						if (warmup_script) {
+							Context::Scope context_scope{context_dirty};
+							MaybeLocal<Object> tmp;
+							ScriptOriginHolder script_origin{tmp};
+							ScriptCompiler::Source source{warmup_script.CopyInto().As<String>(), ScriptOrigin{script_origin}};
+							RunWithAnnotatedErrors([&context_dirty, &source]() {
+								Unmaybe(Unmaybe(ScriptCompiler::Compile(context_dirty, &source, ScriptCompiler::kNoCompileOptions))->Run(context_dirty));
+							});
+						}
+					}, [ this ](unique_ptr<ExternalCopy> error_inner) {
+						error = std::move(error_inner);
 					});
-				}
-			}, [ &error ](unique_ptr<ExternalCopy> error_inner) {
-				error = std::move(error_inner);
-			});
-			isolate->ContextDisposedNotification(false);
-
-			// Run all queued tasks
-			delegate->DoneWithWork();
-			while (true) {
-				auto task = [&]() -> std::unique_ptr<v8::Task> {
-					auto lock = tasks.write();
-					if (lock->empty()) {
-						return nullptr;
+
+					// Named contexts are added in order, and each name is added as isolate data at the same index
+					for (auto& named_context : contexts) {
+						if (error) {
+							break;
+						}
+						Local<Context> named_context_handle = NewContext(isolate);
+						FunctorRunners::RunCatchExternal(named_context_handle, [&]() {
+							Context::Scope context_scope{named_context_handle};
+							for (auto& script : named_context.second) {
+								ScriptOrigin script_origin = ScriptOrigin{script.second};
+								ScriptCompiler::Source source{script.first.CopyInto().As<String>(), script_origin};
+								RunWithAnnotatedErrors([&named_context_handle, &source]() {
+									Unmaybe(Unmaybe(ScriptCompiler::Compile(named_context_handle, &source, ScriptCompiler::kNoCompileOptions))->Run(named_context_handle));
+								});
+							}
+						}, [ this ](unique_ptr<ExternalCopy> error_inner) {
+							error = std::move(error_inner);
+						});
+						snapshot_creator.AddContext(named_context_handle, {&SerializeInternalFieldsCallback, nullptr});
+						snapshot_creator.AddData(Unmaybe(String::NewFromUtf8(isolate, named_context.first.c_str())));
 					}
-					auto task = std::move(lock->front());
-					lock->pop_front();
-					return task;
-				}();
-				if (task) {
-					task->Run();
-				} else {
-					break;
+					isolate->ContextDisposedNotification(false);
+
+					// Run all queued tasks
+					delegate->DoneWithWork();
+					while (true) {
+						auto task = [&]() -> std::unique_ptr<v8::Task> {
+							auto lock = tasks.write();
+							if (lock->empty()) {
+								return nullptr;
+							}
+							auto task = std::move(lock->front());
+							lock->pop_front();
+							return task;
+						}();
+						if (task) {
+							task->Run();
+						} else {
+							break;
+						}
+					}
+				}
+				// nb: Snapshot must be created even in the error case, because `~SnapshotCreator` will crash if
+				// you don't
+				snapshot = snapshot_creator.CreateBlob(SnapshotCreator::FunctionCodeHandling::kKeep);
+				PlatformDelegate::UnregisterIsolate(isolate);
+			}
+			// The blob is adopted instead of copied since snapshots can be several megabytes
+			auto backing_store = ArrayBuffer::NewBackingStore(
+				const_cast<char*>(snapshot.data), snapshot.raw_size,
+				[](void* data, size_t /*length*/, void* /*param*/) { delete[] static_cast<char*>(data); },
+				nullptr);
+			if (!error && snapshot.raw_size != 0) {
+				result = std::make_shared<ExternalCopyArrayBuffer>(std::move(backing_store));
+			}
+		}
+
+		// Export to outer scope
+		auto Result() -> Local<Value> {
+			if (error) {
+				Isolate::GetCurrent()->ThrowException(error->CopyInto());
+				throw RuntimeError();
+			} else if (!result) {
+				throw RuntimeGenericError("Failure creating snapshot");
+			}
+			return ClassHandle::NewInstance<ExternalCopyHandle>(std::move(result));
+		}
+
+	private:
+		using ScriptList = std::vector<std::pair<ExternalCopyString, ScriptOriginHolder>>;
+
+		static auto CopyScripts(ArrayRange script_handles) -> ScriptList {
+			Local<Context> context = Isolate::GetCurrent()->GetCurrentContext();
+			ScriptList scripts;
+			scripts.reserve(std::distance(script_handles.begin(), script_handles.end()));
+			for (auto value : script_handles) {
+				auto script_handle = HandleCast<Local<Object>>(value);
+				Local<Value> script = Unmaybe(script_handle.As<Object>()->Get(context, StringTable::Get().code));
+				if (!script->IsString()) {
+					throw RuntimeTypeError("`code` property is required");
 				}
+				scripts.emplace_back(ExternalCopyString{script.As<String>()}, ScriptOriginHolder{script_handle});
+			}
+			return scripts;
+		}
+
+		// Contexts created from a base snapshot need to deserialize its internal fields
+		auto NewContext(Isolate* isolate) -> Local<Context> {
+			if (base_blob) {
+				return Context::New(isolate, nullptr, {}, {}, &DeserializeInternalFieldsCallback);
 			}
+			return Context::New(isolate);
+		}
+
+		ScriptList scripts;
+		std::vector<std::pair<std::string, ScriptList>> contexts;
+		ExternalCopyString warmup_script;
+		shared_ptr<BackingStore> base_blob;
+		shared_ptr<ExternalCopy> error;
+		shared_ptr<ExternalCopyArrayBuffer> result;
+};
+
+/**
+ * Builds a snapshot on the thread pool and then settles a promise back in the calling isolate
+ */
+class SnapshotBuilderTask : public Runnable {
+	public:
+		SnapshotBuilderTask(std::unique_ptr<SnapshotBuilder> builder, Local<Promise::Resolver> resolver) :
+				builder{std::move(builder)},
+				resolver{resolver, Isolate::GetCurrent()->GetCurrentContext()},
+				holder{IsolateEnvironment::GetCurrentHolder()} {
+			// Keep the loop alive until the result is delivered. This also allows the result to be
+			// scheduled from the pool thread.
+			LockedScheduler::IncrementUvRefForIsolate(holder);
 		}
-		// nb: Snapshot must be created even in the error case, because `~SnapshotCreator` will crash if
-		// you don't
-		snapshot = snapshot_creator.CreateBlob(SnapshotCreator::FunctionCodeHandling::kKeep);
-		snapshot_data_ptr.reset(snapshot.data);
-		PlatformDelegate::UnregisterIsolate(isolate);
-	}
-
-	// Export to outer scope
-	if (error) {
-		Isolate::GetCurrent()->ThrowException(error->CopyInto());
-		return Undefined(Isolate::GetCurrent());
-	} else if (snapshot.raw_size == 0) {
-		throw RuntimeGenericError("Failure creating snapshot");
-	}
-	auto buffer = std::make_shared<ExternalCopyArrayBuffer>((void*)snapshot.data, snapshot.raw_size);
-	return ClassHandle::NewInstance<ExternalCopyHandle>(buffer);
+
+		void Run() final {
+			builder->Build();
+			auto holder = this->holder;
+			holder->ScheduleTask(std::make_unique<ResolveTask>(std::move(builder), std::move(resolver), holder), false, true);
+		}
+
+	private:
+		struct ResolveTask : public Runnable {
+			ResolveTask(std::unique_ptr<SnapshotBuilder> builder, RemoteTuple<Promise::Resolver, Context> resolver, shared_ptr<IsolateHolder> holder) :
+				builder{std::move(builder)}, resolver{std::move(resolver)}, holder{std::move(holder)} {}
+
+			ResolveTask(const ResolveTask&) = delete;
+			auto operator=(const ResolveTask&) = delete;
+
+			~ResolveTask() final {
+				LockedScheduler::DecrementUvRefForIsolate(holder);
+			}
+
+			void Run() final {
+				auto context = resolver.Deref<1>();
+				Context::Scope context_scope{context};
+				auto resolver = this->resolver.Deref<0>();
+				FunctorRunners::RunCatchValue([&]() {
+					Unmaybe(resolver->Resolve(context, builder->Result()));
+				}, [&](Local<Value> error) {
+					Unmaybe(resolver->Reject(context, error));
+				});
+			}
+
+			std::unique_ptr<SnapshotBuilder> builder;
+			RemoteTuple<Promise::Resolver, Context> resolver;
+			shared_ptr<IsolateHolder> holder;
+		};
+
+		std::unique_ptr<SnapshotBuilder> builder;
+		RemoteTuple<Promise::Resolver, Context> resolver;
+		shared_ptr<IsolateHolder> holder;
+};
+
+} // anonymous namespace
+
+auto IsolateHandle::CreateSnapshot(
+	ArrayRange script_handles, MaybeLocal<String> warmup_handle, MaybeLocal<Object> maybe_options
+) -> Local<Value> {
+	SnapshotBuilder builder{script_handles, warmup_handle, maybe_options};
+	builder.Build();
+	return builder.Result();
+}
+
+auto IsolateHandle::CreateSnapshotAsync(
+	ArrayRange script_handles, MaybeLocal<String> warmup_handle, MaybeLocal<Object> maybe_options
+) -> Local<Value> {
+	auto context = Isolate::GetCurrent()->GetCurrentContext();
+	auto resolver = Unmaybe(Promise::Resolver::New(context));
+	FunctorRunners::RunCatchValue([&]() {
+		LockedScheduler::ExecuteInThreadPool(std::make_unique<SnapshotBuilderTask>(
+			std::make_unique<SnapshotBuilder>(script_handles, warmup_handle, maybe_options), resolver
+		));
+	}, [&](Local<Value> error) {
+		Unmaybe(resolver->Reject(context, error));
+	});
+	return resolver->GetPromise();
 }
 
 } // namespace ivm
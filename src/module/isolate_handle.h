@@ -29,9 +29,11 @@ class IsolateHandle : public TransferableHandle {
 
 		template <int async> auto CreateContext(v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 		template <int async> auto CompileScript(v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
+		auto CompileScriptStream(v8::Local<v8::Object> source_iterable, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 		template <int async> auto CompileModule(v8::Local<v8::String> code_handle, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 
 		auto CreateInspectorSession() -> v8::Local<v8::Value>;
+		auto CreatePipeline() -> v8::Local<v8::Value>;
 		auto Dispose() -> v8::Local<v8::Value>;
 		template <int async> auto GetHeapStatistics() -> v8::Local<v8::Value>;
 		auto GetCpuTime() -> v8::Local<v8::Value>;
@@ -40,10 +42,12 @@ class IsolateHandle : public TransferableHandle {
 		template <int async> auto StopCpuProfiler(v8::Local<v8::String> title) -> v8::Local<v8::Value>;
 
         auto SetBufferPrototype(v8::Local<v8::Object> prototype) -> v8::Local<v8::Value>;
+		auto SetMemoryLimit(double memory_limit) -> v8::Local<v8::Value>;
 		
 		auto GetReferenceCount() -> v8::Local<v8::Value>;
 		auto IsDisposedGetter() -> v8::Local<v8::Value>;
-		static auto CreateSnapshot(ArrayRange script_handles, v8::MaybeLocal<v8::String> warmup_handle) -> v8::Local<v8::Value>;
+		static auto CreateSnapshot(ArrayRange script_handles, v8::MaybeLocal<v8::String> warmup_handle, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
+		static auto CreateSnapshotAsync(ArrayRange script_handles, v8::MaybeLocal<v8::String> warmup_handle, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
 };
 
 } // namespace ivm
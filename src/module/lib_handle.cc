@@ -44,10 +44,11 @@ auto LibHandle::Hrtime(MaybeLocal<Array> maybe_diff) -> Local<Value> {
 		uint64_t time_diff = Unmaybe(diff->Get(context, 0)).As<Uint32>()->Value() * kNanos + Unmaybe(diff->Get(context, 1)).As<Uint32>()->Value();
 		time -= time_diff;
 	}
-	Local<Array> ret = Array::New(isolate, 2);
-	Unmaybe(ret->Set(context, 0, Uint32::New(isolate, (uint32_t)(time / kNanos))));
-	Unmaybe(ret->Set(context, 1, Uint32::New(isolate, (uint32_t)(time - (time / kNanos) * kNanos))));
-	return ret;
+	Local<Value> elements[] = {
+		Uint32::NewFromUnsigned(isolate, (uint32_t)(time / kNanos)),
+		Uint32::NewFromUnsigned(isolate, (uint32_t)(time - (time / kNanos) * kNanos)),
+	};
+	return Array::New(isolate, elements, 2);
 }
 
 // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
@@ -0,0 +1,191 @@
+#include "message_port_handle.h"
+#include "isolate/environment.h"
+#include "isolate/node_wrapper.h"
+#include "isolate/functor_runners.h"
+#include "isolate/scheduler.h"
+#include "isolate/specific.h"
+
+using namespace v8;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace ivm {
+
+/**
+ * MessageQueue implementation
+ */
+class MessageQueue::DispatchTask : public Runnable {
+	public:
+		explicit DispatchTask(shared_ptr<MessageQueue> queue) : queue{std::move(queue)} {}
+		void Run() final { queue->Dispatch(); }
+
+	private:
+		shared_ptr<MessageQueue> queue;
+};
+
+void MessageQueue::Post(unique_ptr<Transferable> message) {
+	std::unique_lock<std::mutex> lock{mutex};
+	if (!closed) {
+		messages.push_back(std::move(message));
+		ScheduleDispatch(lock);
+	}
+}
+
+void MessageQueue::Close() {
+	std::deque<unique_ptr<Transferable>> dropped;
+	RemoteTuple<Function, Context> dropped_handler;
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		closed = true;
+		dropped = ExchangeDefault(messages);
+		dropped_handler = std::exchange(handler, {});
+	}
+}
+
+void MessageQueue::ScheduleDispatch(std::unique_lock<std::mutex>& lock) {
+	// Messages posted while a dispatch is pending will be picked up by that same task
+	if (handler && !pending_dispatch && !messages.empty()) {
+		pending_dispatch = true;
+		auto holder = handler.GetSharedIsolateHolder();
+		lock.unlock();
+		holder->ScheduleTask(std::make_unique<DispatchTask>(shared_from_this()), false, true);
+	}
+}
+
+void MessageQueue::Dispatch() {
+	std::deque<unique_ptr<Transferable>> batch;
+	RemoteTuple<Function, Context> handler;
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		if (!this->handler || this->handler.GetIsolateHolder() != IsolateEnvironment::GetCurrentHolder().get()) {
+			// The handler was removed or moved to another isolate after this task was scheduled
+			return;
+		}
+		pending_dispatch = false;
+		batch = ExchangeDefault(messages);
+		handler = this->handler;
+	}
+
+	auto* isolate = Isolate::GetCurrent();
+	auto context = handler.Deref<1>();
+	Context::Scope context_scope{context};
+	auto fn = handler.Deref<0>();
+	auto global = context->Global();
+	bool is_default = IsolateEnvironment::GetCurrent().IsDefault();
+	for (auto& message : batch) {
+		TryCatch try_catch{isolate};
+		// Uncaught exceptions are reported by nodejs. Exceptions in other isolates are ignored, like
+		// `applyIgnored`.
+		try_catch.SetVerbose(is_default);
+		Local<Value> event;
+		Local<Value> error;
+		FunctorRunners::RunCatchValue([&]() {
+			auto object = Object::New(isolate);
+			Unmaybe(object->Set(context, StringTable::Get().data, message->TransferIn()));
+			event = object;
+		}, [&](Local<Value> caught) {
+			error = caught;
+		});
+		if (!event.IsEmpty()) {
+			if (is_default) {
+				node::MakeCallback(isolate, global, fn, 1, &event, {0, 0});
+			} else if (fn->Call(context, global, 1, &event).IsEmpty() && try_catch.HasTerminated()) {
+				break;
+			}
+		} else if (is_default && !error.IsEmpty()) {
+			// The message couldn't be copied in, so report that in place of calling the handler
+			static IsolateSpecific<Function> thrower;
+			auto throw_fn = thrower.Deref([&]() {
+				return Unmaybe(Unmaybe(Script::Compile(context, v8_string("(function(error) { throw error; })")))->Run(context)).As<Function>();
+			});
+			node::MakeCallback(isolate, global, throw_fn, 1, &error, {0, 0});
+		}
+		if (try_catch.HasTerminated()) {
+			break;
+		}
+	}
+	if (!is_default) {
+		isolate->PerformMicrotaskCheckpoint();
+	}
+}
+
+/**
+ * MessagePortHandle implementation
+ */
+auto MessagePortHandle::MessagePortTransferable::TransferIn() -> Local<Value> {
+	return ClassHandle::NewInstance<MessagePortHandle>(incoming, outgoing);
+}
+
+auto MessagePortHandle::Definition() -> Local<FunctionTemplate> {
+	return Inherit<TransferableHandle>(MakeClass(
+		"MessagePort", nullptr,
+		"close", MemberFunction<decltype(&MessagePortHandle::Close), &MessagePortHandle::Close>{},
+		"onmessage", MemberProperty<
+			decltype(&MessagePortHandle::OnMessageGetter), &MessagePortHandle::OnMessageGetter,
+			decltype(&MessagePortHandle::OnMessageSetter), &MessagePortHandle::OnMessageSetter
+		>{},
+		"postMessage", MemberFunction<decltype(&MessagePortHandle::PostMessage), &MessagePortHandle::PostMessage>{}
+	));
+}
+
+auto MessagePortHandle::TransferOut() -> unique_ptr<Transferable> {
+	return std::make_unique<MessagePortTransferable>(incoming, outgoing);
+}
+
+auto MessagePortHandle::PostMessage(Local<Value> value, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	outgoing->Post(ivm::TransferOut(value, TransferOptions{maybe_options, TransferOptions::Type::Copy}));
+	return Undefined(Isolate::GetCurrent());
+}
+
+auto MessagePortHandle::Close() -> Local<Value> {
+	incoming->Close();
+	outgoing->Close();
+	return Undefined(Isolate::GetCurrent());
+}
+
+auto MessagePortHandle::OnMessageGetter() -> Local<Value> {
+	std::lock_guard<std::mutex> lock{incoming->mutex};
+	if (incoming->handler && incoming->handler.GetIsolateHolder() == IsolateEnvironment::GetCurrentHolder().get()) {
+		return incoming->handler.Deref<0>();
+	}
+	return Null(Isolate::GetCurrent());
+}
+
+void MessagePortHandle::OnMessageSetter(Local<Value> value) {
+	RemoteTuple<Function, Context> handler;
+	if (value->IsFunction()) {
+		handler = RemoteTuple<Function, Context>{value.As<Function>(), Isolate::GetCurrent()->GetCurrentContext()};
+	} else if (!value->IsNullOrUndefined()) {
+		throw RuntimeTypeError("`onmessage` must be a function");
+	}
+	std::unique_lock<std::mutex> lock{incoming->mutex};
+	if (incoming->closed) {
+		return;
+	}
+	std::swap(incoming->handler, handler);
+	// A dispatch scheduled for the previous handler won't run this one, so schedule another
+	incoming->pending_dispatch = false;
+	incoming->ScheduleDispatch(lock);
+}
+
+/**
+ * MessageChannelHandle implementation
+ */
+auto MessageChannelHandle::Definition() -> Local<FunctionTemplate> {
+	return MakeClass(
+		"MessageChannel", ConstructorFunction<decltype(&New), &New>{},
+		"port1", MemberAccessor<decltype(&MessageChannelHandle::Port1Getter), &MessageChannelHandle::Port1Getter>{},
+		"port2", MemberAccessor<decltype(&MessageChannelHandle::Port2Getter), &MessageChannelHandle::Port2Getter>{}
+	);
+}
+
+auto MessageChannelHandle::New() -> unique_ptr<MessageChannelHandle> {
+	auto first = std::make_shared<MessageQueue>();
+	auto second = std::make_shared<MessageQueue>();
+	return std::make_unique<MessageChannelHandle>(
+		ClassHandle::NewInstance<MessagePortHandle>(first, second),
+		ClassHandle::NewInstance<MessagePortHandle>(second, first)
+	);
+}
+
+} // namespace ivm
@@ -0,0 +1,84 @@
+#pragma once
+#include "isolate/remote_handle.h"
+#include "transferable.h"
+#include <v8.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace ivm {
+
+/**
+ * Messages posted to one end of a `MessageChannel`. The receiving isolate is woken once per batch
+ * of messages, and the batch is dispatched to its `onmessage` handler in a single task.
+ */
+class MessageQueue : public std::enable_shared_from_this<MessageQueue> {
+	friend class MessagePortHandle;
+	public:
+		void Post(std::unique_ptr<Transferable> message);
+		void Close();
+
+	private:
+		class DispatchTask;
+		void ScheduleDispatch(std::unique_lock<std::mutex>& lock);
+		void Dispatch();
+
+		std::mutex mutex;
+		std::deque<std::unique_ptr<Transferable>> messages;
+		RemoteTuple<v8::Function, v8::Context> handler;
+		bool pending_dispatch = false;
+		bool closed = false;
+};
+
+/**
+ * One end of a `MessageChannel`
+ */
+class MessagePortHandle final : public TransferableHandle {
+	private:
+		class MessagePortTransferable : public Transferable {
+			public:
+				MessagePortTransferable(std::shared_ptr<MessageQueue> incoming, std::shared_ptr<MessageQueue> outgoing) :
+					incoming{std::move(incoming)}, outgoing{std::move(outgoing)} {}
+				auto TransferIn() -> v8::Local<v8::Value> final;
+
+			private:
+				std::shared_ptr<MessageQueue> incoming;
+				std::shared_ptr<MessageQueue> outgoing;
+		};
+
+		std::shared_ptr<MessageQueue> incoming;
+		std::shared_ptr<MessageQueue> outgoing;
+
+	public:
+		MessagePortHandle(std::shared_ptr<MessageQueue> incoming, std::shared_ptr<MessageQueue> outgoing) :
+			incoming{std::move(incoming)}, outgoing{std::move(outgoing)} {}
+
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+		auto TransferOut() -> std::unique_ptr<Transferable> final;
+
+		auto PostMessage(v8::Local<v8::Value> value, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
+		auto Close() -> v8::Local<v8::Value>;
+		auto OnMessageGetter() -> v8::Local<v8::Value>;
+		void OnMessageSetter(v8::Local<v8::Value> value);
+};
+
+/**
+ * Creates a pair of entangled `MessagePort` instances
+ */
+class MessageChannelHandle final : public ClassHandle {
+	private:
+		RemoteHandle<v8::Value> port1;
+		RemoteHandle<v8::Value> port2;
+
+	public:
+		MessageChannelHandle(v8::Local<v8::Value> port1, v8::Local<v8::Value> port2) :
+			port1{port1}, port2{port2} {}
+
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+		static auto New() -> std::unique_ptr<MessageChannelHandle>;
+
+		auto Port1Getter() -> v8::Local<v8::Value> { return port1.Deref(); }
+		auto Port2Getter() -> v8::Local<v8::Value> { return port2.Deref(); }
+};
+
+} // namespace ivm
@@ -1,5 +1,7 @@
 #include "module_handle.h"
 #include "context_handle.h"
+#include "evaluation.h"
+#include "external_copy_handle.h"
 #include "reference_handle.h"
 #include "transferable.h"
 #include "isolate/class_handle.h"
@@ -25,6 +27,101 @@ auto LookupModuleInfo(Local<Module> module) {
 	return it == range.second ? nullptr : it->second;
 }
 
+// Registry which specifiers not resolved by a linker fall back to while `InstantiateModule` is
+// running on this thread
+thread_local ModuleRegistry* current_registry = nullptr;
+
+class RegistryScope {
+	public:
+		explicit RegistryScope(ModuleRegistry* registry) : previous{std::exchange(current_registry, registry)} {}
+		RegistryScope(const RegistryScope&) = delete;
+		~RegistryScope() { current_registry = previous; }
+		auto operator=(const RegistryScope&) = delete;
+
+	private:
+		ModuleRegistry* previous;
+};
+
+// Remembers that `registry` was used in this isolate, so guest `import()` can find it later
+void RememberRegistry(const shared_ptr<ModuleRegistry>& registry) {
+	auto& registries = IsolateEnvironment::GetCurrent().module_registries;
+	registries.erase(std::remove_if(registries.begin(), registries.end(), [](const std::weak_ptr<ModuleRegistry>& ptr) {
+		return ptr.expired();
+	}), registries.end());
+	auto it = std::find_if(registries.begin(), registries.end(), [&](const std::weak_ptr<ModuleRegistry>& ptr) {
+		return ptr.lock() == registry;
+	});
+	if (it == registries.end()) {
+		registries.emplace_back(registry);
+	}
+}
+
+// `referrers` are all the names the importing module is registered under, the first one which
+// resolves `specifier` wins
+auto ResolveFromRegistry(ModuleRegistry& registry, const std::string& specifier, const std::vector<std::string>& referrers) -> shared_ptr<ModuleInfo> {
+	shared_ptr<ModuleInfo> info;
+	for (const auto& referrer : referrers) {
+		info = registry.Find(specifier, referrer);
+		if (info) {
+			break;
+		}
+	}
+	if (referrers.empty()) {
+		info = registry.Find(specifier, "");
+	}
+	if (!info) {
+		throw RuntimeGenericError("Cannot find module '" + specifier + "'" + (referrers.empty() || referrers[0].empty() ? "" : " imported from '" + referrers[0] + "'"));
+	}
+	if (info->handle.GetIsolateHolder() != IsolateEnvironment::GetCurrentHolder().get()) {
+		throw RuntimeGenericError("Module '" + specifier + "' belongs to a different isolate");
+	}
+	return info;
+}
+
+auto IsRelativeSpecifier(const std::string& specifier) -> bool {
+	return specifier.compare(0, 2, "./") == 0 || specifier.compare(0, 3, "../") == 0 || specifier.compare(0, 1, "/") == 0;
+}
+
+// Resolves a "./" "../" or "/" specifier against `referrer`. Anything before the path of a URL-like
+// referrer ("file://", "https://host") is kept as-is.
+auto ResolveRelative(const std::string& referrer, const std::string& specifier) -> std::string {
+	std::string root;
+	std::string path = referrer;
+	auto scheme = referrer.find("://");
+	if (scheme != std::string::npos) {
+		auto path_start = referrer.find('/', scheme + 3);
+		root = referrer.substr(0, path_start);
+		path = path_start == std::string::npos ? "/" : referrer.substr(path_start);
+	}
+	std::string joined = specifier[0] == '/' ? specifier : path.substr(0, path.rfind('/') + 1) + specifier;
+	// Normalize "." and ".." segments
+	std::vector<std::string> segments;
+	size_t begin = 0;
+	while (true) {
+		auto end = joined.find('/', begin);
+		auto segment = joined.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+		if (segment == "..") {
+			if (!segments.empty()) {
+				segments.pop_back();
+			}
+		} else if (segment != "." && (!segment.empty() || end == std::string::npos)) {
+			segments.emplace_back(std::move(segment));
+		}
+		if (end == std::string::npos) {
+			break;
+		}
+		begin = end + 1;
+	}
+	std::string result = root;
+	for (size_t ii = 0; ii < segments.size(); ++ii) {
+		if (ii != 0 || joined[0] == '/') {
+			result += '/';
+		}
+		result += segments[ii];
+	}
+	return result;
+}
+
 } // anonymous namespace
 
 ModuleInfo::ModuleInfo(Local<Module> handle) : identity_hash{handle->GetIdentityHash()}, handle{handle} {
@@ -66,6 +163,8 @@ ModuleHandle::ModuleHandle(shared_ptr<ModuleInfo> info) : info(std::move(info))
 auto ModuleHandle::Definition() -> Local<FunctionTemplate> {
 	return Inherit<TransferableHandle>(MakeClass(
 		"Module", nullptr,
+		"createCachedData", MemberFunction<decltype(&ModuleHandle::CreateCachedData<1>), &ModuleHandle::CreateCachedData<1>>{},
+		"createCachedDataSync", MemberFunction<decltype(&ModuleHandle::CreateCachedData<0>), &ModuleHandle::CreateCachedData<0>>{},
 		"dependencySpecifiers", MemberAccessor<decltype(&ModuleHandle::GetDependencySpecifiers), &ModuleHandle::GetDependencySpecifiers>{},
 		"instantiate", MemberFunction<decltype(&ModuleHandle::Instantiate), &ModuleHandle::Instantiate>{},
 		"instantiateSync", MemberFunction<decltype(&ModuleHandle::InstantiateSync), &ModuleHandle::InstantiateSync>{},
@@ -239,6 +338,7 @@ struct InstantiateRunner : public ThreePhaseTask {
 	RemoteHandle<Context> context;
 	shared_ptr<ModuleInfo> info;
 	RemoteHandle<Object> linker;
+	shared_ptr<ModuleRegistry> registry;
 
 	static auto ResolveCallback(Local<Context> /*context*/, Local<String> specifier, Local<FixedArray> /*import_assertions*/, Local<Module> referrer) -> MaybeLocal<Module> {
 		MaybeLocal<Module> ret;
@@ -248,17 +348,41 @@ struct InstantiateRunner : public ThreePhaseTask {
 			if (found != nullptr) {
 				// nb: lock is already acquired in `Instantiate`
 				auto& resolutions = found->resolutions;
-				auto it = resolutions.find(*String::Utf8Value{Isolate::GetCurrent(), specifier});
+				std::string specifier_str = *String::Utf8Value{Isolate::GetCurrent(), specifier};
+				auto it = resolutions.find(specifier_str);
 				if (it != resolutions.end()) {
 					ret = it->second->handle.Deref();
 					return;
 				}
+				if (current_registry != nullptr) {
+					ret = ResolveFromRegistry(*current_registry, specifier_str, current_registry->NamesOf(*found))->handle.Deref();
+					return;
+				}
 			}
 			throw RuntimeGenericError("Dependency was left unresolved. Please report this error on github.");
 		});
 		return ret;
 	}
 
+	// Instantiates `mod`, resolving anything the linker didn't through `registry`
+	static void Instantiate(Local<Module> mod, Local<Context> context, ModuleRegistry* registry) {
+		RegistryScope registry_scope{registry};
+		TryCatch try_catch{Isolate::GetCurrent()};
+		try {
+			Unmaybe(mod->InstantiateModule(context, ResolveCallback));
+		} catch (...) {
+			try_catch.ReThrow();
+			throw;
+		}
+		// `InstantiateModule` will return Maybe<bool>{true} even when there are exceptions pending.
+		// This condition is checked here and a C++ is thrown which will propagate out as a JS
+		// exception.
+		if (try_catch.HasCaught()) {
+			try_catch.ReThrow();
+			throw RuntimeError();
+		}
+	}
+
 	InstantiateRunner(
 		RemoteHandle<Context> context,
 		shared_ptr<ModuleInfo> info,
@@ -267,8 +391,23 @@ struct InstantiateRunner : public ThreePhaseTask {
 		context(std::move(context)),
 		info(std::move(info)),
 		linker(linker) {
+		CheckContext();
+	}
+
+	InstantiateRunner(
+		RemoteHandle<Context> context,
+		shared_ptr<ModuleInfo> info,
+		shared_ptr<ModuleRegistry> registry
+	) :
+		context(std::move(context)),
+		info(std::move(info)),
+		registry(std::move(registry)) {
+		CheckContext();
+	}
+
+	void CheckContext() {
 		// Sanity check
-		if (this->info->handle.GetIsolateHolder() != this->context.GetIsolateHolder()) {
+		if (info->handle.GetIsolateHolder() != context.GetIsolateHolder()) {
 			throw RuntimeGenericError("Invalid context");
 		}
 	}
@@ -277,25 +416,17 @@ struct InstantiateRunner : public ThreePhaseTask {
 		Local<Module> mod = info->handle.Deref();
 		Local<Context> context_local = context.Deref();
 		info->context_handle = std::move(context);
-		std::lock_guard<std::mutex> lock{info->mutex};
-		TryCatch try_catch{Isolate::GetCurrent()};
-		try {
-			Unmaybe(mod->InstantiateModule(context_local, ResolveCallback));
-		} catch (...) {
-			try_catch.ReThrow();
-			throw;
-		}
-		// `InstantiateModule` will return Maybe<bool>{true} even when there are exceptions pending.
-		// This condition is checked here and a C++ is thrown which will propagate out as a JS
-		// exception.
-		if (try_catch.HasCaught()) {
-			try_catch.ReThrow();
-			throw RuntimeError();
+		if (registry) {
+			RememberRegistry(registry);
 		}
+		std::lock_guard<std::mutex> lock{info->mutex};
+		Instantiate(mod, context_local, registry.get());
 	}
 
 	auto Phase3() -> Local<Value> final {
-		ClassHandle::Unwrap<ModuleLinker>(linker.Deref())->Reset(ModuleInfo::LinkStatus::Linked);
+		if (linker) {
+			ClassHandle::Unwrap<ModuleLinker>(linker.Deref())->Reset(ModuleInfo::LinkStatus::Linked);
+		}
 		return Undefined(Isolate::GetCurrent());
 	}
 };
@@ -413,28 +544,157 @@ class ModuleLinkerAsync : public ModuleLinker::Implementation {
 		}
 };
 
-auto ModuleHandle::Instantiate(ContextHandle& context_handle, Local<Function> callback) -> Local<Value> {
+namespace {
+
+auto ResolverToRegistry(Local<Value> resolver) -> ModuleRegistryHandle* {
+	auto* registry = resolver->IsObject() ? ClassHandle::Unwrap<ModuleRegistryHandle>(resolver.As<Object>()) : nullptr;
+	if (registry == nullptr && !resolver->IsFunction()) {
+		throw RuntimeTypeError("`resolveCallback` must be a function or `ModuleRegistry`");
+	}
+	return registry;
+}
+
+} // anonymous namespace
+
+auto ModuleHandle::Instantiate(ContextHandle& context_handle, Local<Value> resolver) -> Local<Value> {
 	auto context = context_handle.GetContext();
-	Local<Object> linker_handle = ClassHandle::NewInstance<ModuleLinker>(callback);
+	auto* registry = ResolverToRegistry(resolver);
+	if (registry != nullptr) {
+		auto info = GetInfo();
+		return ThreePhaseTask::Run<1, InstantiateRunner>(*info->handle.GetIsolateHolder(), context, info, registry->GetRegistry());
+	}
+	Local<Object> linker_handle = ClassHandle::NewInstance<ModuleLinker>(resolver.As<Function>());
 	auto* linker = ClassHandle::Unwrap<ModuleLinker>(linker_handle);
 	linker->SetImplementation<ModuleLinkerAsync>();
 	return linker->Begin(*this, context);
 }
 
-auto ModuleHandle::InstantiateSync(ContextHandle& context_handle, Local<Function> callback) -> Local<Value> {
+auto ModuleHandle::InstantiateSync(ContextHandle& context_handle, Local<Value> resolver) -> Local<Value> {
 	auto context = context_handle.GetContext();
-	Local<Object> linker_handle = ClassHandle::NewInstance<ModuleLinker>(callback);
+	auto* registry = ResolverToRegistry(resolver);
+	if (registry != nullptr) {
+		auto info = GetInfo();
+		return ThreePhaseTask::Run<0, InstantiateRunner>(*info->handle.GetIsolateHolder(), context, info, registry->GetRegistry());
+	}
+	Local<Object> linker_handle = ClassHandle::NewInstance<ModuleLinker>(resolver.As<Function>());
 	auto* linker = ClassHandle::Unwrap<ModuleLinker>(linker_handle);
 	linker->SetImplementation<ModuleLinkerSync>();
 	return linker->Begin(*this, context);
 }
 
+namespace {
+
+/**
+ * Resolves, instantiates, and evaluates a dynamic `import()`. This runs as a microtask queued in the
+ * importing context so the module body never runs before `import()` has returned.
+ */
+void ImportModuleMicrotask(const FunctionCallbackInfo<Value>& args) {
+	Isolate* isolate = args.GetIsolate();
+	Local<Context> context = isolate->GetCurrentContext();
+	Local<Array> data = args.Data().As<Array>();
+	Local<Promise::Resolver> resolver = data->Get(context, 0).ToLocalChecked().As<Promise::Resolver>();
+	Local<Value> resource_name = data->Get(context, 1).ToLocalChecked();
+	Local<Value> specifier = data->Get(context, 2).ToLocalChecked();
+	TryCatch try_catch{isolate};
+	detail::RunBarrier([&]() {
+		std::string specifier_str = *String::Utf8Value{isolate, specifier};
+		std::string referrer = resource_name->IsString() ? *String::Utf8Value{isolate, resource_name} : "";
+
+		// Prefer the registry the importing module is registered in, otherwise take the first one
+		// which has this module
+		auto& registries = IsolateEnvironment::GetCurrent().module_registries;
+		shared_ptr<ModuleRegistry> registry;
+		for (const auto& ptr : registries) {
+			auto candidate = ptr.lock();
+			if (candidate && candidate->Has(referrer)) {
+				registry = std::move(candidate);
+				break;
+			}
+		}
+		if (!registry) {
+			for (const auto& ptr : registries) {
+				auto candidate = ptr.lock();
+				if (candidate && candidate->Find(specifier_str, referrer)) {
+					registry = std::move(candidate);
+					break;
+				}
+			}
+		}
+		if (!registry) {
+			throw RuntimeGenericError("Cannot find module '" + specifier_str + "'");
+		}
+		auto info = ResolveFromRegistry(*registry, specifier_str, {referrer});
+
+		// Instantiate and evaluate in the importing context
+		Local<Module> mod = info->handle.Deref();
+		if (mod->GetStatus() == Module::Status::kUninstantiated) {
+			std::lock_guard<std::mutex> lock{info->mutex};
+			if (info->link_status == ModuleInfo::LinkStatus::Linking) {
+				throw RuntimeGenericError("Module is currently being linked by another linker");
+			}
+			info->context_handle = RemoteHandle<Context>{context};
+			InstantiateRunner::Instantiate(mod, context, registry.get());
+		}
+		Local<Value> result = Unmaybe(mod->Evaluate(context));
+		Local<Value> module_namespace = mod->GetModuleNamespace();
+		{
+			std::lock_guard<std::mutex> lock{info->mutex};
+			if (!info->global_namespace) {
+				info->global_namespace = RemoteHandle<Value>{module_namespace};
+			}
+		}
+		if (result->IsPromise()) {
+			// Top-level await, the import settles with the evaluation
+			auto resolve_namespace = [](const FunctionCallbackInfo<Value>& info) {
+				info.GetReturnValue().Set(info.Data());
+			};
+			Local<Promise> evaluated = Unmaybe(result.As<Promise>()->Then(context, Unmaybe(Function::New(context, resolve_namespace, module_namespace))));
+			Unmaybe(resolver->Resolve(context, evaluated));
+		} else {
+			Unmaybe(resolver->Resolve(context, module_namespace));
+		}
+	});
+	if (try_catch.HasCaught()) {
+		if (try_catch.HasTerminated()) {
+			try_catch.ReThrow();
+			return;
+		}
+		if (resolver->Reject(context, try_catch.Exception()).IsNothing()) {
+			return;
+		}
+	}
+}
+
+} // anonymous namespace
+
+auto ModuleHandle::ImportModuleDynamically(
+	Local<Context> context,
+	Local<Value> resource_name,
+	Local<String> specifier
+) -> MaybeLocal<Promise> {
+	Isolate* isolate = context->GetIsolate();
+	Local<Promise::Resolver> resolver;
+	if (!Promise::Resolver::New(context).ToLocal(&resolver)) {
+		return {};
+	}
+	Local<Value> elements[] = { resolver, resource_name, specifier };
+	Local<Array> data = Array::New(isolate, elements, 3);
+	Local<Function> task;
+	if (!Function::New(context, ImportModuleMicrotask, data).ToLocal(&task)) {
+		return {};
+	}
+	isolate->EnqueueMicrotask(task);
+	return resolver->GetPromise();
+}
+
 struct EvaluateRunner : public ThreePhaseTask {
 	shared_ptr<ModuleInfo> info;
 	std::unique_ptr<Transferable> result;
 	uint32_t timeout;
+	uint32_t cpu_timeout;
 
-	EvaluateRunner(shared_ptr<ModuleInfo> info, uint32_t ms) : info(std::move(info)), timeout(ms) {}
+	EvaluateRunner(shared_ptr<ModuleInfo> info, uint32_t ms, uint32_t cpu_ms) :
+		info(std::move(info)), timeout(ms), cpu_timeout(cpu_ms) {}
 
 	void Phase2() final {
 		Local<Module> mod = info->handle.Deref();
@@ -443,7 +703,7 @@ struct EvaluateRunner : public ThreePhaseTask {
 		}
 		Local<Context> context_local = Deref(info->context_handle);
 		Context::Scope context_scope(context_local);
-		result = OptionalTransferOut(RunWithTimeout(timeout, [&]() { return mod->Evaluate(context_local); }));
+		result = OptionalTransferOut(RunWithTimeout(timeout, cpu_timeout, [&]() { return mod->Evaluate(context_local); }));
 		std::lock_guard<std::mutex> lock(info->mutex);
 		info->global_namespace = RemoteHandle<Value>(mod->GetModuleNamespace());
 	}
@@ -461,7 +721,41 @@ template <int async>
 auto ModuleHandle::Evaluate(MaybeLocal<Object> maybe_options) -> Local<Value> {
 	auto info = GetInfo();
 	int32_t timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, 0);
-	return ThreePhaseTask::Run<async, EvaluateRunner>(*info->handle.GetIsolateHolder(), info, timeout_ms);
+	int32_t cpu_timeout_ms = ReadOption<int32_t>(maybe_options, StringTable::Get().cpuTimeout, 0);
+	return ThreePhaseTask::Run<async, EvaluateRunner>(*info->handle.GetIsolateHolder(), info, timeout_ms, cpu_timeout_ms);
+}
+
+/**
+ * Serialize the module's code cache, including any functions which have been compiled since
+ */
+struct CreateModuleCachedDataRunner : public ThreePhaseTask {
+	shared_ptr<ModuleInfo> info;
+	std::shared_ptr<ExternalCopyArrayBuffer> cached_data;
+
+	explicit CreateModuleCachedDataRunner(shared_ptr<ModuleInfo> info) : info(std::move(info)) {}
+
+	void Phase2() final {
+		Local<Module> mod = info->handle.Deref();
+		if (mod->GetStatus() == Module::Status::kErrored) {
+			throw RuntimeGenericError("Module evaluation failed");
+		}
+		auto* data = ScriptCompiler::CreateCodeCache(mod->GetUnboundModuleScript());
+		if (data == nullptr) {
+			// v8 refuses to serialize code containing asm.js
+			throw RuntimeGenericError("Code cache could not be created");
+		}
+		cached_data = CachedDataToExternalCopy(data);
+	}
+
+	auto Phase3() -> Local<Value> final {
+		return ClassHandle::NewInstance<ExternalCopyHandle>(std::move(cached_data));
+	}
+};
+
+template <int async>
+auto ModuleHandle::CreateCachedData() -> Local<Value> {
+	auto info = GetInfo();
+	return ThreePhaseTask::Run<async, CreateModuleCachedDataRunner>(*info->handle.GetIsolateHolder(), info);
 }
 
 auto ModuleHandle::GetNamespace() -> Local<Value> {
@@ -472,4 +766,130 @@ auto ModuleHandle::GetNamespace() -> Local<Value> {
 	return ClassHandle::NewInstance<ReferenceHandle>(info->handle.GetSharedIsolateHolder(), info->global_namespace, info->context_handle, ReferenceHandle::TypeOf::Object, true, false);
 }
 
+/**
+ * ModuleRegistry implementation
+ */
+void ModuleRegistry::AddImport(const std::string& from, std::string to) {
+	std::lock_guard<std::mutex> lock{mutex};
+	if (from.back() == '/') {
+		auto it = std::find_if(prefix_imports.begin(), prefix_imports.end(), [&](const std::pair<std::string, std::string>& entry) {
+			return entry.first.size() <= from.size();
+		});
+		if (it != prefix_imports.end() && it->first == from) {
+			it->second = std::move(to);
+		} else {
+			prefix_imports.emplace(it, from, std::move(to));
+		}
+	} else {
+		imports[from] = std::move(to);
+	}
+}
+
+auto ModuleRegistry::Delete(const std::string& name) -> bool {
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = modules.find(name);
+	if (it == modules.end()) {
+		return false;
+	}
+	ForgetName(*it->second, name);
+	modules.erase(it);
+	return true;
+}
+
+auto ModuleRegistry::Find(const std::string& specifier, const std::string& referrer) -> shared_ptr<ModuleInfo> {
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = modules.find(Resolve(specifier, referrer));
+	return it == modules.end() ? nullptr : it->second;
+}
+
+auto ModuleRegistry::Has(const std::string& name) -> bool {
+	std::lock_guard<std::mutex> lock{mutex};
+	return modules.find(name) != modules.end();
+}
+
+auto ModuleRegistry::NamesOf(const ModuleInfo& info) -> std::vector<std::string> {
+	std::lock_guard<std::mutex> lock{mutex};
+	auto it = names.find(&info);
+	return it == names.end() ? std::vector<std::string>{} : it->second;
+}
+
+void ModuleRegistry::Set(const std::string& name, shared_ptr<ModuleInfo> info) {
+	std::lock_guard<std::mutex> lock{mutex};
+	auto& entry = modules[name];
+	if (entry) {
+		ForgetName(*entry, name);
+	}
+	names[info.get()].push_back(name);
+	entry = std::move(info);
+}
+
+void ModuleRegistry::ForgetName(const ModuleInfo& info, const std::string& name) {
+	auto it = names.find(&info);
+	if (it != names.end()) {
+		auto& list = it->second;
+		list.erase(std::remove(list.begin(), list.end(), name), list.end());
+		if (list.empty()) {
+			names.erase(it);
+		}
+	}
+}
+
+auto ModuleRegistry::Resolve(const std::string& specifier, const std::string& referrer) const -> std::string {
+	std::string name = IsRelativeSpecifier(specifier) ? ResolveRelative(referrer, specifier) : specifier;
+	auto it = imports.find(name);
+	if (it != imports.end()) {
+		return it->second;
+	}
+	for (const auto& entry : prefix_imports) {
+		if (name.compare(0, entry.first.size(), entry.first) == 0) {
+			return entry.second + name.substr(entry.first.size());
+		}
+	}
+	return name;
+}
+
+/**
+ * ModuleRegistryHandle implementation
+ */
+auto ModuleRegistryHandle::Definition() -> Local<FunctionTemplate> {
+	return MakeClass(
+		"ModuleRegistry", ConstructorFunction<decltype(&New), &New>{},
+		"delete", MemberFunction<decltype(&ModuleRegistryHandle::Delete), &ModuleRegistryHandle::Delete>{},
+		"set", MemberFunction<decltype(&ModuleRegistryHandle::Set), &ModuleRegistryHandle::Set>{}
+	);
+}
+
+auto ModuleRegistryHandle::New(MaybeLocal<Object> maybe_options) -> std::unique_ptr<ModuleRegistryHandle> {
+	auto registry = std::make_shared<ModuleRegistry>();
+	auto maybe_imports = ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().imports, {});
+	Local<Object> imports;
+	if (maybe_imports.ToLocal(&imports)) {
+		Isolate* isolate = Isolate::GetCurrent();
+		Local<Context> context = isolate->GetCurrentContext();
+		Local<Array> keys = Unmaybe(imports->GetOwnPropertyNames(context));
+		for (uint32_t ii = 0; ii < keys->Length(); ++ii) {
+			Local<Value> key = Unmaybe(keys->Get(context, ii));
+			Local<Value> value = Unmaybe(imports->Get(context, key));
+			if (!value->IsString()) {
+				throw RuntimeTypeError("`imports` values must be strings");
+			}
+			std::string from = *String::Utf8Value{isolate, key};
+			if (from.empty()) {
+				throw RuntimeTypeError("`imports` keys must not be empty");
+			}
+			registry->AddImport(from, *String::Utf8Value{isolate, value});
+		}
+	}
+	return std::make_unique<ModuleRegistryHandle>(std::move(registry));
+}
+
+auto ModuleRegistryHandle::Set(std::string name, ModuleHandle& module) -> Local<Value> {
+	registry->Set(name, module.GetInfo());
+	return Undefined(Isolate::GetCurrent());
+}
+
+auto ModuleRegistryHandle::Delete(std::string name) -> Local<Value> {
+	return Boolean::New(Isolate::GetCurrent(), registry->Delete(name));
+}
+
 } // namespace ivm
@@ -2,6 +2,9 @@
 #include <v8.h>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "isolate/holder.h"
 #include "isolate/remote_handle.h"
 #include "transferable.h"
@@ -50,12 +53,14 @@ class ModuleHandle : public TransferableHandle {
 		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
 		auto TransferOut() -> std::unique_ptr<Transferable> final;
 
+		template <int async>
+		auto CreateCachedData() -> v8::Local<v8::Value>;
 		auto GetDependencySpecifiers() -> v8::Local<v8::Value>;
 		auto GetInfo() const -> std::shared_ptr<ModuleInfo>;
 		auto Release() -> v8::Local<v8::Value>;
 
-		auto Instantiate(class ContextHandle& context_handle, v8::Local<v8::Function> callback) -> v8::Local<v8::Value>;
-		auto InstantiateSync(class ContextHandle& context_handle, v8::Local<v8::Function> callback) -> v8::Local<v8::Value>;
+		auto Instantiate(class ContextHandle& context_handle, v8::Local<v8::Value> resolver) -> v8::Local<v8::Value>;
+		auto InstantiateSync(class ContextHandle& context_handle, v8::Local<v8::Value> resolver) -> v8::Local<v8::Value>;
 
 		template <int async>
 		auto Evaluate(v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
@@ -63,6 +68,54 @@ class ModuleHandle : public TransferableHandle {
 		auto GetNamespace() -> v8::Local<v8::Value>;
 
 		static void InitializeImportMeta(v8::Local<v8::Context> context, v8::Local<v8::Module> module, v8::Local<v8::Object> meta);
+		static auto ImportModuleDynamically(
+			v8::Local<v8::Context> context,
+			v8::Local<v8::Value> resource_name,
+			v8::Local<v8::String> specifier
+		) -> v8::MaybeLocal<v8::Promise>;
+};
+
+/**
+ * Specifier -> module map which `instantiate` and guest `import()` resolve against without calling
+ * into JS. Relative specifiers are resolved against the names the importing module was registered
+ * under, then run through an import map. The handle stays on the thread which created it but the
+ * registry is also read by the threads of isolates it instantiates in, so all access is locked.
+ */
+class ModuleRegistry {
+	public:
+		void AddImport(const std::string& from, std::string to);
+		auto Delete(const std::string& name) -> bool;
+		auto Find(const std::string& specifier, const std::string& referrer) -> std::shared_ptr<ModuleInfo>;
+		auto Has(const std::string& name) -> bool;
+		auto NamesOf(const ModuleInfo& info) -> std::vector<std::string>;
+		void Set(const std::string& name, std::shared_ptr<ModuleInfo> info);
+
+	private:
+		auto Resolve(const std::string& specifier, const std::string& referrer) const -> std::string;
+		void ForgetName(const ModuleInfo& info, const std::string& name);
+
+		std::mutex mutex;
+		std::unordered_map<std::string, std::shared_ptr<ModuleInfo>> modules;
+		// Every name each module is registered under, in the order they were set
+		std::unordered_map<const ModuleInfo*, std::vector<std::string>> names;
+		std::unordered_map<std::string, std::string> imports;
+		// Import map entries ending in "/", longest first
+		std::vector<std::pair<std::string, std::string>> prefix_imports;
+};
+
+class ModuleRegistryHandle : public ClassHandle {
+	private:
+		std::shared_ptr<ModuleRegistry> registry;
+
+	public:
+		explicit ModuleRegistryHandle(std::shared_ptr<ModuleRegistry> registry) : registry{std::move(registry)} {}
+
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+		static auto New(v8::MaybeLocal<v8::Object> maybe_options) -> std::unique_ptr<ModuleRegistryHandle>;
+
+		auto GetRegistry() const -> const std::shared_ptr<ModuleRegistry>& { return registry; }
+		auto Set(std::string name, ModuleHandle& module) -> v8::Local<v8::Value>;
+		auto Delete(std::string name) -> v8::Local<v8::Value>;
 };
 
 } // namespace ivm
@@ -0,0 +1,447 @@
+#include "pipeline_handle.h"
+#include "external_copy/external_copy.h"
+#include "isolate/run_with_timeout.h"
+#include "isolate/three_phase_task.h"
+#include "call_options_handle.h"
+#include "context_handle.h"
+#include "evaluation.h"
+#include "reference_handle.h"
+#include "transferable.h"
+
+using namespace v8;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace ivm {
+
+/**
+ * Identifies the results of one pipeline. Placeholders refer back to this so that they can't be
+ * resolved by a different pipeline.
+ */
+struct PipelineHandle::State {};
+
+namespace {
+
+/**
+ * The pipeline which is currently running on this thread, and the results of its operations so far
+ */
+struct RunningPipeline {
+	RunningPipeline(const PipelineHandle::State& state, const std::vector<Local<Value>>& values) :
+		state{state}, values{values}, previous{std::exchange(current, this)} {}
+	RunningPipeline(const RunningPipeline&) = delete;
+	auto operator=(const RunningPipeline&) = delete;
+	~RunningPipeline() { current = previous; }
+
+	const PipelineHandle::State& state;
+	const std::vector<Local<Value>>& values;
+	RunningPipeline* previous;
+	static thread_local RunningPipeline* current;
+};
+thread_local RunningPipeline* RunningPipeline::current = nullptr;
+
+/**
+ * Placeholder for the result of an operation which hasn't run yet
+ */
+class PipelineResultTransferable : public Transferable {
+	public:
+		PipelineResultTransferable(shared_ptr<PipelineHandle::State> state, size_t index) :
+			state{std::move(state)}, index{index} {}
+
+		auto TransferIn() -> Local<Value> final {
+			auto* running = RunningPipeline::current;
+			if (running == nullptr || &running->state != state.get() || index >= running->values.size()) {
+				throw RuntimeGenericError("Pipeline results may only be used by later operations in the same pipeline");
+			}
+			return running->values[index];
+		}
+
+	private:
+		shared_ptr<PipelineHandle::State> state;
+		size_t index;
+};
+
+class PipelineResultHandle final : public TransferableHandle {
+	public:
+		PipelineResultHandle(shared_ptr<PipelineHandle::State> state, size_t index) :
+			state{std::move(state)}, index{index} {}
+
+		static auto Definition() -> Local<FunctionTemplate> {
+			return Inherit<TransferableHandle>(MakeClass("PipelineResult", nullptr));
+		}
+
+		auto TransferOut() -> unique_ptr<Transferable> final {
+			return std::make_unique<PipelineResultTransferable>(state, index);
+		}
+
+		shared_ptr<PipelineHandle::State> state;
+		size_t index;
+};
+
+struct Timeouts {
+	explicit Timeouts(MaybeLocal<Object> maybe_options) {
+		if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+			timeout = call_options->timeout;
+			cpu_timeout = call_options->cpu_timeout;
+		} else {
+			timeout = ReadOption<int32_t>(maybe_options, StringTable::Get().timeout, 0);
+			cpu_timeout = ReadOption<int32_t>(maybe_options, StringTable::Get().cpuTimeout, 0);
+		}
+	}
+
+	uint32_t timeout = 0;
+	uint32_t cpu_timeout = 0;
+};
+
+// Results of earlier operations are passed as-is, regardless of the transfer options
+auto TransferOperand(Local<Value> value, TransferOptions options) -> unique_ptr<Transferable> {
+	if (value->IsObject() && ClassHandle::Unwrap<PipelineResultHandle>(value.As<Object>()) != nullptr) {
+		return TransferOut(value);
+	}
+	return TransferOut(value, options);
+}
+
+auto CopyKey(Local<Value> key_handle) -> unique_ptr<ExternalCopy> {
+	auto key = ExternalCopy::CopyIfPrimitive(key_handle);
+	if (!key || (!key_handle->IsName() && !key_handle->IsUint32())) {
+		throw RuntimeTypeError("Invalid `key`");
+	}
+	return key;
+}
+
+} // anonymous namespace
+
+/**
+ * Operations are run in order in the pipeline's isolate, and each one is given the results of all
+ * of the operations before it
+ */
+class PipelineHandle::Operation {
+	public:
+		explicit Operation(TransferOptions transfer_options) : transfer_options{transfer_options} {}
+		Operation(const Operation&) = delete;
+		auto operator=(const Operation&) = delete;
+		virtual ~Operation() = default;
+
+		virtual auto Run(Local<Context> context, const std::vector<Local<Value>>& values) -> Local<Value> = 0;
+
+		TransferOptions transfer_options;
+		RemoteHandle<Context> context;
+};
+
+/**
+ * An operation's target is either a `Reference` or the result of an earlier operation
+ */
+struct PipelineHandle::Target {
+	auto Deref(const std::vector<Local<Value>>& values) const -> Local<Value> {
+		if (pending) {
+			return pending->Deref();
+		}
+		return reference ? reference.Deref() : values[index];
+	}
+
+	RemoteHandle<Value> reference;
+	std::shared_ptr<detail::PendingValue> pending;
+	RemoteHandle<Context> context;
+	size_t index = 0;
+	bool accessors = false;
+	bool inherit = false;
+};
+
+/**
+ * PipelineHandle implementation
+ */
+PipelineHandle::PipelineHandle(shared_ptr<IsolateHolder> isolate) :
+	isolate{std::move(isolate)}, state{std::make_shared<State>()} {}
+
+PipelineHandle::~PipelineHandle() = default;
+
+auto PipelineHandle::Definition() -> Local<FunctionTemplate> {
+	return MakeClass(
+		"Pipeline", nullptr,
+		"apply", MemberFunction<decltype(&PipelineHandle::Apply), &PipelineHandle::Apply>{},
+		"delete", MemberFunction<decltype(&PipelineHandle::Delete), &PipelineHandle::Delete>{},
+		"eval", MemberFunction<decltype(&PipelineHandle::Eval), &PipelineHandle::Eval>{},
+		"get", MemberFunction<decltype(&PipelineHandle::Get), &PipelineHandle::Get>{},
+		"set", MemberFunction<decltype(&PipelineHandle::Set), &PipelineHandle::Set>{},
+		"run", MemberFunction<decltype(&PipelineHandle::Run<1>), &PipelineHandle::Run<1>>{},
+		"runSync", MemberFunction<decltype(&PipelineHandle::Run<0>), &PipelineHandle::Run<0>>{}
+	);
+}
+
+auto PipelineHandle::ReadTarget(Local<Value> target_handle, bool require_object) -> Target {
+	if (!state) {
+		throw RuntimeGenericError("Pipeline has already been run");
+	}
+	Target target;
+	if (target_handle->IsObject()) {
+		if (auto* reference = ClassHandle::Unwrap<ReferenceHandle>(target_handle.As<Object>())) {
+			reference->CheckDisposed();
+			if (reference->isolate != isolate) {
+				throw RuntimeGenericError("Reference belongs to a different isolate");
+			} else if (require_object && !reference->pending && reference->type_of != ReferenceHandle::TypeOf::Object) {
+				throw RuntimeTypeError("Reference is not an object");
+			}
+			target.reference = reference->reference;
+			target.pending = reference->pending;
+			if (target.pending) {
+				QueuedValue::Use(target.pending);
+			}
+			target.context = reference->context;
+			target.accessors = reference->accessors;
+			target.inherit = reference->inherit;
+			return target;
+		} else if (auto* result = ClassHandle::Unwrap<PipelineResultHandle>(target_handle.As<Object>())) {
+			if (result->state != state) {
+				throw RuntimeGenericError("Result belongs to a different pipeline");
+			}
+			target.context = contexts[result->index];
+			target.index = result->index;
+			return target;
+		}
+	}
+	throw RuntimeTypeError("`target` must be a Reference or the result of an earlier operation");
+}
+
+auto PipelineHandle::Record(RemoteHandle<Context> context, unique_ptr<Operation> operation) -> Local<Value> {
+	if (!state) {
+		throw RuntimeGenericError("Pipeline has already been run");
+	}
+	operation->context = context;
+	contexts.push_back(std::move(context));
+	operations.push_back(std::move(operation));
+	return ClassHandle::NewInstance<PipelineResultHandle>(state, operations.size() - 1);
+}
+
+auto PipelineHandle::Apply(
+	Local<Value> target_handle,
+	MaybeLocal<Value> recv_handle,
+	Maybe<ArrayRange> maybe_arguments,
+	MaybeLocal<Object> maybe_options
+) -> Local<Value> {
+	class ApplyOperation : public Operation {
+		public:
+			ApplyOperation(Target target, MaybeLocal<Value> recv_handle, Maybe<ArrayRange> maybe_arguments, MaybeLocal<Object> maybe_options) :
+					Operation{TransferOptions{TransferOptions::Type::Reference}},
+					target{std::move(target)}, timeouts{maybe_options} {
+				TransferOptions arguments_transfer_options;
+				if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+					arguments_transfer_options = call_options->arguments_transfer_options;
+					transfer_options = call_options->result_transfer_options.WithFallback(TransferOptions::Type::Reference);
+				} else {
+					arguments_transfer_options = TransferOptions{
+						ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().arguments, {})};
+					transfer_options = TransferOptions{
+						ReadOption<MaybeLocal<Object>>(maybe_options, StringTable::Get().result, {}),
+						TransferOptions::Type::Reference};
+				}
+				Local<Value> recv_local;
+				if (recv_handle.ToLocal(&recv_local)) {
+					recv = TransferOut(recv_local);
+				}
+				ArrayRange arguments;
+				if (maybe_arguments.To(&arguments)) {
+					for (auto argument : arguments) {
+						argv.push_back(TransferOperand(argument, arguments_transfer_options));
+					}
+				}
+			}
+
+			auto Run(Local<Context> context, const std::vector<Local<Value>>& values) -> Local<Value> final {
+				auto fn = target.Deref(values);
+				if (!fn->IsFunction()) {
+					throw RuntimeTypeError("Reference is not a function");
+				}
+				auto recv_inner = recv ? recv->TransferIn() : Undefined(Isolate::GetCurrent()).As<Value>();
+				std::vector<Local<Value>> argv_inner;
+				argv_inner.reserve(argv.size());
+				for (auto& argument : argv) {
+					argv_inner.emplace_back(argument->TransferIn());
+				}
+				return RunWithTimeout(timeouts.timeout, timeouts.cpu_timeout, [&]() {
+					return fn.As<Function>()->Call(context, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
+				});
+			}
+
+		private:
+			Target target;
+			Timeouts timeouts;
+			unique_ptr<Transferable> recv;
+			std::vector<unique_ptr<Transferable>> argv;
+	};
+	QueuedValue::Collector collector{dependencies};
+	auto target = ReadTarget(target_handle, false);
+	auto context = target.context;
+	return Record(std::move(context), std::make_unique<ApplyOperation>(std::move(target), recv_handle, maybe_arguments, maybe_options));
+}
+
+auto PipelineHandle::Delete(Local<Value> target_handle, Local<Value> key_handle) -> Local<Value> {
+	class DeleteOperation : public Operation {
+		public:
+			DeleteOperation(Target target, Local<Value> key_handle) :
+				Operation{TransferOptions{}}, target{std::move(target)}, key{CopyKey(key_handle)} {}
+
+			auto Run(Local<Context> context, const std::vector<Local<Value>>& values) -> Local<Value> final {
+				auto object = detail::CheckForProxy(target.Deref(values));
+				if (!Unmaybe(object->Delete(context, detail::PropertyKey(context, key->CopyInto())))) {
+					throw RuntimeTypeError("Delete failed");
+				}
+				return Undefined(Isolate::GetCurrent());
+			}
+
+		private:
+			Target target;
+			unique_ptr<ExternalCopy> key;
+	};
+	QueuedValue::Collector collector{dependencies};
+	auto target = ReadTarget(target_handle, true);
+	auto context = target.context;
+	return Record(std::move(context), std::make_unique<DeleteOperation>(std::move(target), key_handle));
+}
+
+auto PipelineHandle::Eval(ContextHandle& context_handle, Local<String> code, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	class EvalOperation : public Operation {
+		public:
+			EvalOperation(Local<String> code, MaybeLocal<Object> maybe_options) :
+				Operation{TransferOptions{maybe_options}}, compiler{code, maybe_options}, timeouts{maybe_options} {}
+
+			auto Run(Local<Context> context, const std::vector<Local<Value>>& /*values*/) -> Local<Value> final {
+				auto source = compiler.GetSource();
+				auto script = RunWithAnnotatedErrors([&]() {
+					return Unmaybe(ScriptCompiler::Compile(context, source.get()));
+				});
+				return RunWithTimeout(timeouts.timeout, timeouts.cpu_timeout, [&]() {
+					return script->Run(context);
+				});
+			}
+
+		private:
+			CodeCompilerHolder compiler;
+			Timeouts timeouts;
+	};
+	auto context = context_handle.GetContext();
+	if (!context) {
+		throw RuntimeGenericError("Context is released");
+	} else if (context.GetIsolateHolder() != isolate.get()) {
+		throw RuntimeGenericError("Context belongs to a different isolate");
+	}
+	return Record(std::move(context), std::make_unique<EvalOperation>(code, maybe_options));
+}
+
+auto PipelineHandle::Get(Local<Value> target_handle, Local<Value> key_handle, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	class GetOperation : public Operation {
+		public:
+			GetOperation(Target target, Local<Value> key_handle, MaybeLocal<Object> maybe_options) :
+					Operation{TransferOptions{maybe_options, target.inherit ?
+						TransferOptions::Type::DeepReference : TransferOptions::Type::Reference}},
+					target{std::move(target)}, key{CopyKey(key_handle)} {
+				if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+					this->target.accessors |= call_options->accessors;
+				} else {
+					this->target.accessors |= ReadOption(maybe_options, StringTable::Get().accessors, false);
+				}
+			}
+
+			auto Run(Local<Context> context, const std::vector<Local<Value>>& values) -> Local<Value> final {
+				auto object = detail::CheckForProxy(target.Deref(values));
+				auto name = detail::PropertyKey(context, key->CopyInto());
+				return detail::GetProperty(context, object, name, target.accessors, target.inherit);
+			}
+
+		private:
+			Target target;
+			unique_ptr<ExternalCopy> key;
+	};
+	QueuedValue::Collector collector{dependencies};
+	auto target = ReadTarget(target_handle, true);
+	auto context = target.context;
+	return Record(std::move(context), std::make_unique<GetOperation>(std::move(target), key_handle, maybe_options));
+}
+
+auto PipelineHandle::Set(
+	Local<Value> target_handle,
+	Local<Value> key_handle,
+	Local<Value> val_handle,
+	MaybeLocal<Object> maybe_options
+) -> Local<Value> {
+	class SetOperation : public Operation {
+		public:
+			SetOperation(Target target, Local<Value> key_handle, Local<Value> val_handle, MaybeLocal<Object> maybe_options) :
+				Operation{TransferOptions{}}, target{std::move(target)}, key{CopyKey(key_handle)},
+				val{TransferOperand(val_handle, TransferOptions{maybe_options})} {}
+
+			auto Run(Local<Context> context, const std::vector<Local<Value>>& values) -> Local<Value> final {
+				auto object = detail::CheckForProxy(target.Deref(values));
+				auto name = detail::PropertyKey(context, key->CopyInto());
+				Unmaybe(object->Delete(context, name));
+				if (!Unmaybe(object->CreateDataProperty(context, name, val->TransferIn()))) {
+					throw RuntimeTypeError("Set failed");
+				}
+				return Undefined(Isolate::GetCurrent());
+			}
+
+		private:
+			Target target;
+			unique_ptr<ExternalCopy> key;
+			unique_ptr<Transferable> val;
+	};
+	QueuedValue::Collector collector{dependencies};
+	auto target = ReadTarget(target_handle, true);
+	auto context = target.context;
+	return Record(std::move(context), std::make_unique<SetOperation>(std::move(target), key_handle, val_handle, maybe_options));
+}
+
+/**
+ * Runs every recorded operation under one lock of the isolate
+ */
+class PipelineRunner final : public ThreePhaseTask {
+	public:
+		PipelineRunner(
+			shared_ptr<PipelineHandle::State> state,
+			std::vector<unique_ptr<PipelineHandle::Operation>> operations,
+			const std::vector<shared_ptr<QueuedValue>>& dependencies
+		) : state{std::move(state)}, operations{std::move(operations)} {
+			if (!this->state) {
+				throw RuntimeGenericError("Pipeline has already been run");
+			}
+			for (const auto& dependency : dependencies) {
+				QueuedValue::Use(dependency);
+			}
+		}
+
+		void Phase2() final {
+			std::vector<Local<Value>> values;
+			values.reserve(operations.size());
+			results.reserve(operations.size());
+			RunningPipeline running{*state, values};
+			for (auto& operation : operations) {
+				auto context = operation->context.Deref();
+				Context::Scope context_scope{context};
+				auto value = operation->Run(context, values);
+				values.push_back(value);
+				results.push_back(OptionalTransferOut(value, operation->transfer_options));
+			}
+		}
+
+		auto Phase3() -> Local<Value> final {
+			auto* isolate = Isolate::GetCurrent();
+			auto context = isolate->GetCurrentContext();
+			auto array = Array::New(isolate, static_cast<int>(results.size()));
+			for (size_t ii = 0; ii < results.size(); ++ii) {
+				auto value = results[ii] ? results[ii]->TransferIn() : Undefined(isolate).As<Value>();
+				Unmaybe(array->Set(context, ii, value));
+			}
+			return array;
+		}
+
+	private:
+		shared_ptr<PipelineHandle::State> state;
+		std::vector<unique_ptr<PipelineHandle::Operation>> operations;
+		std::vector<unique_ptr<Transferable>> results;
+};
+
+template <int async>
+auto PipelineHandle::Run() -> Local<Value> {
+	contexts.clear();
+	return ThreePhaseTask::Run<async, PipelineRunner>(*isolate, std::exchange(state, {}), std::move(operations), std::exchange(dependencies, {}));
+}
+
+} // namespace ivm
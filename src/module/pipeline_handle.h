@@ -0,0 +1,71 @@
+#pragma once
+#include "isolate/class_handle.h"
+#include "isolate/generic/array.h"
+#include "isolate/remote_handle.h"
+#include <v8.h>
+#include <memory>
+#include <vector>
+
+namespace ivm {
+
+class ContextHandle;
+class QueuedValue;
+
+/**
+ * Records a sequence of operations against one isolate which are then run together as a single
+ * task. Each recorded operation returns a placeholder for its result which later operations in the
+ * same pipeline can use as a target, receiver, argument, or value.
+ */
+class PipelineHandle final : public ClassHandle {
+	public:
+		class Operation;
+		struct State;
+
+		explicit PipelineHandle(std::shared_ptr<IsolateHolder> isolate);
+		PipelineHandle(const PipelineHandle&) = delete;
+		auto operator=(const PipelineHandle&) -> PipelineHandle& = delete;
+		~PipelineHandle() final;
+		static auto Definition() -> v8::Local<v8::FunctionTemplate>;
+
+		auto Apply(
+			v8::Local<v8::Value> target_handle,
+			v8::MaybeLocal<v8::Value> recv_handle,
+			v8::Maybe<ArrayRange> maybe_arguments,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+		auto Delete(v8::Local<v8::Value> target_handle, v8::Local<v8::Value> key_handle) -> v8::Local<v8::Value>;
+		auto Eval(
+			ContextHandle& context_handle,
+			v8::Local<v8::String> code,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+		auto Get(
+			v8::Local<v8::Value> target_handle,
+			v8::Local<v8::Value> key_handle,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+		auto Set(
+			v8::Local<v8::Value> target_handle,
+			v8::Local<v8::Value> key_handle,
+			v8::Local<v8::Value> val_handle,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+
+		template <int async>
+		auto Run() -> v8::Local<v8::Value>;
+
+	private:
+		struct Target;
+		auto ReadTarget(v8::Local<v8::Value> target_handle, bool require_object) -> Target;
+		auto Record(RemoteHandle<v8::Context> context, std::unique_ptr<Operation> operation) -> v8::Local<v8::Value>;
+
+		std::shared_ptr<IsolateHolder> isolate;
+		std::shared_ptr<State> state;
+		std::vector<std::unique_ptr<Operation>> operations;
+		// Context of each recorded operation, so results used as targets are run in the same context
+		std::vector<RemoteHandle<v8::Context>> contexts;
+		// Pending references used by recorded operations, which `runSync` waits for
+		std::vector<std::shared_ptr<QueuedValue>> dependencies;
+};
+
+} // namespace ivm
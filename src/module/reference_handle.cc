@@ -1,6 +1,9 @@
 #include "reference_handle.h"
+#include "call_options_handle.h"
+#include "external_copy/error.h"
 #include "external_copy/external_copy.h"
 #include "isolate/run_with_timeout.h"
+#include "isolate/specific.h"
 #include "isolate/three_phase_task.h"
 #include "transferable.h"
 #include <array>
@@ -31,17 +34,25 @@ auto InferTypeOf(Local<Value> value) -> TypeOf {
 	}
 }
 
+// Pending references are resolved by a task queued ahead of the one dereferencing them
+auto DerefReference(const RemoteHandle<Value>& reference, const shared_ptr<detail::PendingValue>& pending) -> Local<Value> {
+	return pending ? pending->Deref() : Deref(reference);
+}
+
 /**
  * The return value for .derefInto()
  */
 class DereferenceHandleTransferable : public Transferable {
 	public:
-		DereferenceHandleTransferable(shared_ptr<IsolateHolder> isolate, RemoteHandle<v8::Value> reference) :
-			isolate{std::move(isolate)}, reference{std::move(reference)} {}
+		DereferenceHandleTransferable(
+			shared_ptr<IsolateHolder> isolate,
+			RemoteHandle<v8::Value> reference,
+			shared_ptr<detail::PendingValue> pending
+		) : isolate{std::move(isolate)}, reference{std::move(reference)}, pending{std::move(pending)} {}
 
 		auto TransferIn() -> v8::Local<v8::Value> final {
 			if (isolate == IsolateEnvironment::GetCurrentHolder()) {
-				return Deref(reference);
+				return DerefReference(reference, pending);
 			} else {
 				throw RuntimeTypeError("Cannot dereference this into target isolate");
 			}
@@ -50,27 +61,35 @@ class DereferenceHandleTransferable : public Transferable {
 	private:
 		shared_ptr<IsolateHolder> isolate;
 		RemoteHandle<v8::Value> reference;
+		shared_ptr<detail::PendingValue> pending;
 };
 
 class DereferenceHandle : public TransferableHandle {
 	public:
-		DereferenceHandle(shared_ptr<IsolateHolder> isolate, RemoteHandle<v8::Value> reference) :
-			isolate{std::move(isolate)}, reference{std::move(reference)} {}
+		DereferenceHandle(
+			shared_ptr<IsolateHolder> isolate,
+			RemoteHandle<v8::Value> reference,
+			shared_ptr<detail::PendingValue> pending
+		) : isolate{std::move(isolate)}, reference{std::move(reference)}, pending{std::move(pending)} {}
 
 		static auto Definition() -> v8::Local<v8::FunctionTemplate> {
 			return Inherit<TransferableHandle>(MakeClass("Dereference", nullptr));
 		}
 
 		auto TransferOut() -> std::unique_ptr<Transferable> final {
-			if (!reference) {
+			if (!reference && !pending) {
 				throw RuntimeGenericError("The return value of `derefInto()` should only be used once");
 			}
-			return std::make_unique<DereferenceHandleTransferable>(std::move(isolate), std::move(reference));
+			if (pending) {
+				QueuedValue::Use(pending);
+			}
+			return std::make_unique<DereferenceHandleTransferable>(std::move(isolate), std::move(reference), std::move(pending));
 		}
 
 	private:
 		shared_ptr<IsolateHolder> isolate;
 		RemoteHandle<v8::Value> reference;
+		shared_ptr<detail::PendingValue> pending;
 };
 
 } // anonymous namespace
@@ -91,11 +110,13 @@ ReferenceData::ReferenceData(
 	RemoteHandle<Context> context,
 	TypeOf type_of,
 	bool accessors,
-	bool inherit
+	bool inherit,
+	shared_ptr<PendingValue> pending
 ) :
 	isolate{std::move(isolate)},
 	reference{std::move(reference)},
 	context{std::move(context)},
+	pending{std::move(pending)},
 	type_of{type_of},
 	accessors{accessors},
 	inherit{inherit} {}
@@ -125,6 +146,9 @@ auto ReferenceHandle::Definition() -> Local<FunctionTemplate> {
 		"applyIgnored", MemberFunction<decltype(&ReferenceHandle::Apply<2>), &ReferenceHandle::Apply<2>>{},
 		"applySync", MemberFunction<decltype(&ReferenceHandle::Apply<0>), &ReferenceHandle::Apply<0>>{},
 		"applySyncPromise", MemberFunction<decltype(&ReferenceHandle::Apply<4>), &ReferenceHandle::Apply<4>>{},
+		"applyPending", MemberFunction<decltype(&ReferenceHandle::ApplyPending), &ReferenceHandle::ApplyPending>{},
+		"applyIterator", MemberFunction<decltype(&ReferenceHandle::ApplyIterator), &ReferenceHandle::ApplyIterator>{},
+		"getPending", MemberFunction<decltype(&ReferenceHandle::GetPending), &ReferenceHandle::GetPending>{},
 		"typeof", MemberAccessor<decltype(&ReferenceHandle::TypeOfGetter), &ReferenceHandle::TypeOfGetter>{}
 	));
 }
@@ -135,6 +159,9 @@ auto ReferenceHandle::New(Local<Value> value, MaybeLocal<Object> options) -> uni
 }
 
 auto ReferenceHandle::TransferOut() -> unique_ptr<Transferable> {
+	if (pending) {
+		QueuedValue::Use(pending);
+	}
 	return std::make_unique<ReferenceHandleTransferable>(*this);
 }
 
@@ -143,7 +170,10 @@ auto ReferenceHandle::TransferOut() -> unique_ptr<Transferable> {
  */
 auto ReferenceHandle::TypeOfGetter() -> Local<Value> {
 	CheckDisposed();
-	switch (type_of) {
+	if (pending) {
+		pending->Wait();
+	}
+	switch (pending ? pending->GetTypeOf() : type_of) {
 		case TypeOf::Null:
 			return StringTable::Get().null;
 		case TypeOf::Undefined:
@@ -171,7 +201,10 @@ auto ReferenceHandle::Deref(MaybeLocal<Object> maybe_options) -> Local<Value> {
 		throw RuntimeTypeError("Cannot dereference this from current isolate");
 	}
 	bool release = ReadOption<bool>(maybe_options, StringTable::Get().release, false);
-	Local<Value> ret = ivm::Deref(reference);
+	if (pending) {
+		pending->Wait();
+	}
+	Local<Value> ret = DerefReference(reference, pending);
 	if (release) {
 		Release();
 	}
@@ -184,7 +217,7 @@ auto ReferenceHandle::Deref(MaybeLocal<Object> maybe_options) -> Local<Value> {
 auto ReferenceHandle::DerefInto(MaybeLocal<Object> maybe_options) -> Local<Value> {
 	CheckDisposed();
 	bool release = ReadOption<bool>(maybe_options, StringTable::Get().release, false);
-	Local<Value> ret = ClassHandle::NewInstance<DereferenceHandle>(isolate, reference);
+	Local<Value> ret = ClassHandle::NewInstance<DereferenceHandle>(isolate, reference, pending);
 	if (release) {
 		Release();
 	}
@@ -199,6 +232,7 @@ auto ReferenceHandle::Release() -> Local<Value> {
 	isolate.reset();
 	reference = {};
 	context = {};
+	pending.reset();
 	return Undefined(Isolate::GetCurrent());
 }
 
@@ -211,10 +245,15 @@ class ApplyRunner : public ThreePhaseTask {
 			ReferenceHandle& that,
 			MaybeLocal<Value> recv_handle,
 			Maybe<ArrayRange> maybe_arguments,
-			MaybeLocal<Object> maybe_options
-		) :	context{that.context}, reference{that.reference}
+			MaybeLocal<Object> maybe_options,
+			shared_ptr<detail::PendingValue> result_pending = {}
+		) :	context{that.context}, reference{that.reference}, pending{that.pending},
+				result_pending{std::move(result_pending)}
 		{
 			that.CheckDisposed();
+			if (pending) {
+				QueuedValue::Use(pending);
+			}
 
 			// Get receiver, holder, this, whatever
 			Local<Value> recv_local;
@@ -225,8 +264,14 @@ class ApplyRunner : public ThreePhaseTask {
 			// Get run options
 			TransferOptions arguments_transfer_options;
 			Local<Object> options;
-			if (maybe_options.ToLocal(&options)) {
+			if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+				timeout = call_options->timeout;
+				cpu_timeout = call_options->cpu_timeout;
+				arguments_transfer_options = call_options->arguments_transfer_options;
+				return_transfer_options = call_options->result_transfer_options.WithFallback(TransferOptions::Type::Reference);
+			} else if (maybe_options.ToLocal(&options)) {
 				timeout = ReadOption<int32_t>(options, StringTable::Get().timeout, 0);
+				cpu_timeout = ReadOption<int32_t>(options, StringTable::Get().cpuTimeout, 0);
 				arguments_transfer_options = TransferOptions{
 					ReadOption<MaybeLocal<Object>>(options, StringTable::Get().arguments, {})};
 				return_transfer_options = TransferOptions{
@@ -251,24 +296,25 @@ class ApplyRunner : public ThreePhaseTask {
 			if (did_finish) {
 				*did_finish = 1;
 			}
+			if (result_pending) {
+				result_pending->Abandon();
+			}
 		}
 
 		void Phase2() final {
 			// Invoke in the isolate
 			Local<Context> context_handle = Deref(context);
 			Context::Scope context_scope{context_handle};
-			Local<Value> fn = Deref(reference);
-			if (!fn->IsFunction()) {
-				throw RuntimeTypeError("Reference is not a function");
+			if (result_pending) {
+				// Nobody waits on this task, so errors are handed to whatever uses the result
+				FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent().DefaultContext(), [&]() {
+					result_pending->Resolve(Invoke(context_handle));
+				}, [&](unique_ptr<ExternalCopy> error) {
+					result_pending->Reject(std::move(error));
+				});
+			} else {
+				ret = TransferOut(Invoke(context_handle), return_transfer_options);
 			}
-			std::vector<Local<Value>> argv_inner = TransferArguments();
-			Local<Value> recv_inner = recv->TransferIn();
-			Local<Value> result = RunWithTimeout(timeout,
-				[&fn, &context_handle, &recv_inner, &argv_inner]() {
-					return fn.As<Function>()->Call(context_handle, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
-				}
-			);
-			ret = TransferOut(result, return_transfer_options);
 		}
 
 		auto Phase2Async(Scheduler::AsyncWait& wait) -> bool final {
@@ -278,14 +324,14 @@ class ApplyRunner : public ThreePhaseTask {
 			}
 			Local<Context> context_handle = Deref(context);
 			Context::Scope context_scope{context_handle};
-			Local<Value> fn = Deref(reference);
+			Local<Value> fn = DerefReference(reference, pending);
 			if (!fn->IsFunction()) {
 				throw RuntimeTypeError("Reference is not a function");
 			}
 			Local<Value> recv_inner = recv->TransferIn();
 			std::vector<Local<Value>> argv_inner = TransferArguments();
 			Local<Value> value = RunWithTimeout(
-				timeout,
+				timeout, cpu_timeout,
 				[&fn, &context_handle, &recv_inner, &argv_inner]() {
 					return fn.As<Function>()->Call(context_handle, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
 				}
@@ -378,6 +424,20 @@ class ApplyRunner : public ThreePhaseTask {
 			return inner_fn.As<Function>();
 		}
 
+		auto Invoke(Local<Context> context_handle) -> Local<Value> {
+			Local<Value> fn = DerefReference(reference, pending);
+			if (!fn->IsFunction()) {
+				throw RuntimeTypeError("Reference is not a function");
+			}
+			std::vector<Local<Value>> argv_inner = TransferArguments();
+			Local<Value> recv_inner = recv->TransferIn();
+			return RunWithTimeout(timeout, cpu_timeout,
+				[&fn, &context_handle, &recv_inner, &argv_inner]() {
+					return fn.As<Function>()->Call(context_handle, recv_inner, argv_inner.size(), argv_inner.empty() ? nullptr : &argv_inner[0]);
+				}
+			);
+		}
+
 		auto TransferArguments() -> std::vector<Local<Value>> {
 			std::vector<Local<Value>> argv_inner;
 			size_t argc = argv.size();
@@ -391,9 +451,12 @@ class ApplyRunner : public ThreePhaseTask {
 		std::vector<unique_ptr<Transferable>> argv;
 		RemoteHandle<Context> context;
 		RemoteHandle<Value> reference;
+		shared_ptr<detail::PendingValue> pending;
+		shared_ptr<detail::PendingValue> result_pending;
 		unique_ptr<Transferable> recv;
 		unique_ptr<Transferable> ret;
 		uint32_t timeout = 0;
+		uint32_t cpu_timeout = 0;
 		// Only used in the AsyncPhase2 case
 		shared_ptr<char> did_finish; // GCC 5.4.0 `std::make_shared<bool>(...)` is broken(?)
 		TransferOptions return_transfer_options{TransferOptions::Type::Reference};
@@ -405,6 +468,326 @@ auto ReferenceHandle::Apply(MaybeLocal<Value> recv_handle, Maybe<ArrayRange> may
 	return ThreePhaseTask::Run<async, ApplyRunner>(*isolate, *this, recv_handle, maybe_arguments, maybe_options);
 }
 
+auto ReferenceHandle::ApplyPending(MaybeLocal<Value> recv_handle, Maybe<ArrayRange> maybe_arguments, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	auto result = std::make_shared<detail::PendingValue>(isolate);
+	ThreePhaseTask::Run<2, ApplyRunner>(*isolate, *this, recv_handle, maybe_arguments, maybe_options, result);
+	return ClassHandle::NewInstance<ReferenceHandle>(isolate, RemoteHandle<Value>{}, context, TypeOf::Undefined, false, false, std::move(result));
+}
+
+namespace {
+
+/**
+ * State shared between the host iterator returned by `applyIterator` and the tasks which pull
+ * batches out of the guest iterator
+ */
+struct IteratorState {
+	RemoteHandle<Context> context;
+	RemoteHandle<Value> reference;
+	shared_ptr<detail::PendingValue> pending;
+	unique_ptr<Transferable> recv;
+	std::vector<unique_ptr<Transferable>> argv;
+	// Created by the first pull, called once per batch
+	RemoteHandle<Function> pull;
+	int32_t batch_size = 0;
+	uint32_t timeout = 0;
+	uint32_t cpu_timeout = 0;
+};
+
+/**
+ * Invokes the function on the first pull and then collects one batch of results per task. The
+ * batch is copied out as a single value, and if the guest iterator is async the copy waits on the
+ * guest promise before resolving in the host.
+ */
+class IteratorPullRunner final : public ThreePhaseTask {
+	public:
+		IteratorPullRunner(shared_ptr<IteratorState> state, bool close) :
+			state{std::move(state)}, close{close} {}
+
+		void Phase2() final {
+			auto context = Deref(state->context);
+			Context::Scope context_scope{context};
+			if (!state->pull) {
+				if (close) {
+					return;
+				}
+				state->pull = RemoteHandle<Function>{Start(context)};
+			}
+			auto pull = Deref(state->pull);
+			Local<Value> close_handle = Boolean::New(Isolate::GetCurrent(), close);
+			auto batch = RunWithTimeout(state->timeout, state->cpu_timeout, [&]() {
+				return pull->Call(context, Undefined(Isolate::GetCurrent()), 1, &close_handle);
+			});
+			if (!close) {
+				TransferOptions options{TransferOptions::Type::Copy};
+				options.promise = true;
+				ret = TransferOut(batch, options);
+			}
+		}
+
+		auto Phase3() -> Local<Value> final {
+			if (ret) {
+				return ret->TransferIn();
+			}
+			return Undefined(Isolate::GetCurrent());
+		}
+
+	private:
+		auto Start(Local<Context> context) -> Local<Function> {
+			Local<Value> fn = DerefReference(state->reference, state->pending);
+			if (!fn->IsFunction()) {
+				throw RuntimeTypeError("Reference is not a function");
+			}
+			Local<Value> recv = state->recv->TransferIn();
+			std::vector<Local<Value>> argv;
+			argv.reserve(state->argv.size());
+			for (auto& argument : state->argv) {
+				argv.emplace_back(argument->TransferIn());
+			}
+			state->recv.reset();
+			state->argv.clear();
+			// This is compiled in the target context so the iterator protocol runs entirely in the guest
+			auto factory = Unmaybe(Unmaybe(Script::Compile(context, v8_string(
+				"'use strict';"
+				"(function(iterable, size) {"
+					"if (iterable == null) {"
+						"throw new TypeError('Result is not iterable');"
+					"}"
+					"let iterator;"
+					"const isAsync = iterable[Symbol.asyncIterator] != null;"
+					"if (isAsync) {"
+						"iterator = iterable[Symbol.asyncIterator]();"
+					"} else if (typeof iterable[Symbol.iterator] === 'function') {"
+						"iterator = iterable[Symbol.iterator]();"
+					"} else {"
+						"throw new TypeError('Result is not iterable');"
+					"}"
+					"if (Object(iterator) !== iterator) {"
+						"throw new TypeError('Result of the iterator method is not an object');"
+					"}"
+					"const next = iterator.next;"
+					"let done = false;"
+					"let failure;"
+					"const fail = (values, error) => {"
+						"done = true;"
+						"if (values.length === 0) {"
+							"throw error;"
+						"}"
+						// Deliver what was collected first, the error is thrown by the next pull
+						"failure = { error };"
+						"return { values, done: false };"
+					"};"
+					"const accept = result => {"
+						"if (Object(result) !== result) {"
+							"throw new TypeError('Iterator result is not an object');"
+						"}"
+						"done = Boolean(result.done);"
+						"return !done;"
+					"};"
+					"const collect = values => {"
+						"try {"
+							"for (let result; values.length < size && accept(result = next.call(iterator));) {"
+								"values.push(result.value);"
+							"}"
+						"} catch (error) {"
+							"return fail(values, error);"
+						"}"
+						"return { values, done };"
+					"};"
+					"const collectAsync = async values => {"
+						"try {"
+							"for (let result; values.length < size && accept(result = await next.call(iterator));) {"
+								"values.push(result.value);"
+							"}"
+						"} catch (error) {"
+							"return fail(values, error);"
+						"}"
+						"return { values, done };"
+					"};"
+					"return function(close) {"
+						"if (failure !== undefined) {"
+							"const { error } = failure;"
+							"failure = undefined;"
+							"if (!close) {"
+								"throw error;"
+							"}"
+						"}"
+						"if (done) {"
+							"return close ? undefined : { values: [], done };"
+						"}"
+						"if (close) {"
+							"done = true;"
+							"return typeof iterator.return === 'function' ? iterator.return() : undefined;"
+						"}"
+						"return isAsync ? collectAsync([]) : collect([]);"
+					"};"
+				"})"
+			)))->Run(context));
+			return RunWithTimeout(state->timeout, state->cpu_timeout, [&]() -> MaybeLocal<Value> {
+				Local<Value> iterable;
+				if (!fn.As<Function>()->Call(context, recv, argv.size(), argv.empty() ? nullptr : &argv[0]).ToLocal(&iterable)) {
+					return {};
+				}
+				std::array<Local<Value>, 2> factory_argv{{iterable, Integer::New(Isolate::GetCurrent(), state->batch_size)}};
+				return factory.As<Function>()->Call(context, Undefined(Isolate::GetCurrent()), 2, &factory_argv.front());
+			}).As<Function>();
+		}
+
+		shared_ptr<IteratorState> state;
+		unique_ptr<Transferable> ret;
+		bool close;
+};
+
+/**
+ * Native half of the host iterator, wrapped by `CompileIteratorWrapper()`
+ */
+class ReferenceIteratorHandle final : public ClassHandle {
+	public:
+		ReferenceIteratorHandle(shared_ptr<IsolateHolder> isolate, shared_ptr<IteratorState> state) :
+			isolate{std::move(isolate)}, state{std::move(state)} {}
+
+		static auto Definition() -> Local<FunctionTemplate> {
+			return MakeClass("ReferenceIterator", nullptr,
+				"pull", MemberFunction<decltype(&ReferenceIteratorHandle::Pull), &ReferenceIteratorHandle::Pull>{},
+				"close", MemberFunction<decltype(&ReferenceIteratorHandle::Close), &ReferenceIteratorHandle::Close>{}
+			);
+		}
+
+		auto Pull() -> Local<Value> {
+			return ThreePhaseTask::Run<1, IteratorPullRunner>(*isolate, state, false);
+		}
+
+		auto Close() -> Local<Value> {
+			return ThreePhaseTask::Run<1, IteratorPullRunner>(*isolate, state, true);
+		}
+
+	private:
+		shared_ptr<IsolateHolder> isolate;
+		shared_ptr<IteratorState> state;
+};
+
+/**
+ * Host side async iterator. The next batch is requested as soon as the current one arrives so the
+ * guest produces while the host consumes, but never more than one batch ahead.
+ */
+auto CompileIteratorWrapper() -> Local<Function> {
+	Local<Context> context = IsolateEnvironment::GetCurrent().DefaultContext();
+	Local<Script> script = Unmaybe(Script::Compile(context, v8_string(
+		"'use strict';"
+		"(function(handle) {"
+			"let values = [];"
+			"let index = 0;"
+			"let done = false;"
+			"let ahead;"
+			"let last = Promise.resolve();"
+			"const pull = () => {"
+				"const batch = handle.pull();"
+				"batch.catch(() => {});"
+				"return batch;"
+			"};"
+			"const next = async () => {"
+				"while (index === values.length) {"
+					"if (done) {"
+						"return { value: undefined, done: true };"
+					"}"
+					"const batch = ahead || pull();"
+					"ahead = undefined;"
+					"index = 0;"
+					"try {"
+						"({ values, done } = await batch);"
+					"} catch (error) {"
+						"values = [];"
+						"done = true;"
+						"throw error;"
+					"}"
+					"if (!done) {"
+						"ahead = pull();"
+					"}"
+				"}"
+				"return { value: values[index++], done: false };"
+			"};"
+			"const close = async value => {"
+				"if (!done) {"
+					"values = [];"
+					"index = 0;"
+					"done = true;"
+					"ahead = undefined;"
+					"await handle.close();"
+				"}"
+				"return { value, done: true };"
+			"};"
+			"return {"
+				"next() {"
+					"return last = last.then(next, next);"
+				"},"
+				"return(value) {"
+					"const result = () => close(value);"
+					"return last = last.then(result, result);"
+				"},"
+				"[Symbol.asyncIterator]() {"
+					"return this;"
+				"},"
+			"};"
+		"})"
+	)));
+	Local<Value> fn = Unmaybe(script->Run(context));
+	assert(fn->IsFunction());
+	return fn.As<Function>();
+}
+
+} // anonymous namespace
+
+/**
+ * Call a generator function and stream its results back in batches
+ */
+auto ReferenceHandle::ApplyIterator(MaybeLocal<Value> recv_handle, Maybe<ArrayRange> maybe_arguments, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	CheckDisposed();
+	auto state = std::make_shared<IteratorState>();
+	state->context = context;
+	state->reference = reference;
+	state->pending = pending;
+
+	// Get receiver
+	Local<Value> recv_local;
+	if (recv_handle.ToLocal(&recv_local)) {
+		state->recv = ivm::TransferOut(recv_local);
+	} else {
+		state->recv = ivm::TransferOut(Undefined(Isolate::GetCurrent()));
+	}
+
+	// Get options
+	TransferOptions arguments_transfer_options;
+	Local<Object> options;
+	if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+		state->timeout = call_options->timeout;
+		state->cpu_timeout = call_options->cpu_timeout;
+		arguments_transfer_options = call_options->arguments_transfer_options;
+	} else if (maybe_options.ToLocal(&options)) {
+		state->timeout = ReadOption<int32_t>(options, StringTable::Get().timeout, 0);
+		state->cpu_timeout = ReadOption<int32_t>(options, StringTable::Get().cpuTimeout, 0);
+		arguments_transfer_options = TransferOptions{
+			ReadOption<MaybeLocal<Object>>(options, StringTable::Get().arguments, {})};
+	}
+	state->batch_size = ReadOption<int32_t>(maybe_options, StringTable::Get().batchSize, 100);
+	if (state->batch_size < 1) {
+		throw RuntimeRangeError("`batchSize` must be a positive integer");
+	}
+
+	// Externalize all arguments
+	ArrayRange arguments;
+	if (maybe_arguments.To(&arguments)) {
+		state->argv.reserve(std::distance(arguments.begin(), arguments.end()));
+		for (auto argument : arguments) {
+			state->argv.push_back(ivm::TransferOut(argument, arguments_transfer_options));
+		}
+	}
+
+	static IsolateSpecific<Function> wrapper;
+	Local<Value> handle = ClassHandle::NewInstance<ReferenceIteratorHandle>(isolate, std::move(state));
+	auto* current = Isolate::GetCurrent();
+	return Unmaybe(wrapper.Deref(CompileIteratorWrapper)->Call(
+		current->GetCurrentContext(), Undefined(current), 1, &handle));
+}
+
 /**
  * Copy this reference's value into this isolate
  */
@@ -414,13 +797,16 @@ class CopyRunner : public ThreePhaseTask {
 			const ReferenceHandle& that,
 			RemoteHandle<Context> context,
 			RemoteHandle<Value> reference
-		) : context{std::move(context)}, reference{std::move(reference)} {
+		) : context{std::move(context)}, reference{std::move(reference)}, pending{that.pending} {
 			that.CheckDisposed();
+			if (pending) {
+				QueuedValue::Use(pending);
+			}
 		}
 
 		void Phase2() final {
 			Context::Scope context_scope{Deref(context)};
-			Local<Value> value = Deref(reference);
+			Local<Value> value = DerefReference(reference, pending);
 			copy = ExternalCopy::Copy(value);
 		}
 
@@ -431,6 +817,7 @@ class CopyRunner : public ThreePhaseTask {
 	private:
 		RemoteHandle<Context> context;
 		RemoteHandle<Value> reference;
+		shared_ptr<detail::PendingValue> pending;
 		unique_ptr<Transferable> copy;
 };
 
@@ -447,47 +834,33 @@ class AccessorRunner : public ThreePhaseTask {
 		AccessorRunner(ReferenceHandle& target, Local<Value> key_handle) :
 		context{target.context},
 		target{target.reference},
+		pending{target.pending},
 		key{ExternalCopy::CopyIfPrimitive(key_handle)} {
 			target.CheckDisposed();
 			if (!key || (!key_handle->IsName() && !key_handle->IsUint32())) {
 				throw RuntimeTypeError("Invalid `key`");
-			} else if (target.type_of != decltype(target.type_of)::Object) {
+			} else if (!pending && target.type_of != decltype(target.type_of)::Object) {
 				throw RuntimeTypeError("Reference is not an object");
 			}
+			if (pending) {
+				QueuedValue::Use(pending);
+			}
 		}
 
 	protected:
 		auto GetTargetAndAlsoCheckForProxy() -> Local<Object> {
-			auto object = Local<Object>::Cast(Deref(target));
-			if (HasProxy(object)) {
-				throw RuntimeTypeError("Object is or has proxy");
-			}
-			return object;
+			return detail::CheckForProxy(DerefReference(target, pending));
 		}
 
 		auto GetKey(Local<Context> context) -> Local<Name> {
-			auto key_inner = key->CopyInto();
-			return (key_inner->IsString() || key_inner->IsSymbol()) ?
-				key_inner.As<Name>() : Unmaybe(key_inner->ToString(context)).As<Name>();
+			return detail::PropertyKey(context, key->CopyInto());
 		}
 
 		RemoteHandle<Context> context;
 
 	private:
-		static auto HasProxy(Local<Object> object) -> bool {
-			if (object->IsProxy()) {
-				return true;
-			} else {
-				auto proto = object->GetPrototype();
-				if (proto->IsNullOrUndefined()) {
-					return false;
-				} else {
-					return HasProxy(proto.As<Object>());
-				}
-			}
-		}
-
 		RemoteHandle<Value> target;
+		shared_ptr<detail::PendingValue> pending;
 		unique_ptr<ExternalCopy> key;
 };
 
@@ -496,48 +869,43 @@ class AccessorRunner : public ThreePhaseTask {
  */
 class GetRunner final : public AccessorRunner {
 	public:
-		GetRunner(ReferenceHandle& target, Local<Value> key_handle, MaybeLocal<Object> maybe_options) :
+		GetRunner(
+			ReferenceHandle& target,
+			Local<Value> key_handle,
+			MaybeLocal<Object> maybe_options,
+			shared_ptr<detail::PendingValue> result_pending = {}
+		) :
 		AccessorRunner{target, key_handle},
+		result_pending{std::move(result_pending)},
 		options{maybe_options, target.inherit ?
 			TransferOptions::Type::DeepReference : TransferOptions::Type::Reference},
-		accessors{target.accessors || ReadOption(maybe_options, StringTable::Get().accessors, false)},
+		accessors{target.accessors || ReadAccessors(maybe_options)},
 		inherit{target.inherit} {}
 
+		GetRunner(const GetRunner&) = delete;
+		auto operator=(const GetRunner&) -> GetRunner& = delete;
+		~GetRunner() final {
+			if (result_pending) {
+				result_pending->Abandon();
+			}
+		}
+
 		void Phase2() final {
-			// Setup
-			auto* isolate = Isolate::GetCurrent();
 			auto context = Deref(this->context);
 			Context::Scope context_scope{context};
-			auto name = GetKey(context);
-			auto object = GetTargetAndAlsoCheckForProxy();
-
-			// Get property
-			ret = TransferOut([&]() {
-				if (inherit) {
-					// To avoid accessors I guess we have to walk the prototype chain ourselves
-					auto target = object;
-					if (!accessors) {
-						do {
-							if (Unmaybe(target->HasOwnProperty(context, name))) {
-								if (Unmaybe(target->HasRealNamedCallbackProperty(context, name))) {
-									throw RuntimeTypeError("Property is getter");
-								}
-								return Unmaybe(target->GetRealNamedProperty(context, name));
-							}
-							auto next = target->GetPrototype();
-							if (next->IsNullOrUndefined()) {
-								return Undefined(isolate).As<Value>();
-							}
-							target = next.As<Object>();
-						} while (true);
-					}
-				} else if (!Unmaybe(object->HasOwnProperty(context, name))) {
-					return Undefined(isolate).As<Value>();
-				} else if (!accessors && Unmaybe(object->HasRealNamedCallbackProperty(context, name))) {
-					throw RuntimeTypeError("Property is getter");
-				}
-				return Unmaybe(object->Get(context, name));
-			}(), options);
+			if (result_pending) {
+				FunctorRunners::RunCatchExternal(IsolateEnvironment::GetCurrent().DefaultContext(), [&]() {
+					auto name = GetKey(context);
+					auto object = GetTargetAndAlsoCheckForProxy();
+					result_pending->Resolve(detail::GetProperty(context, object, name, accessors, inherit));
+				}, [&](unique_ptr<ExternalCopy> error) {
+					result_pending->Reject(std::move(error));
+				});
+			} else {
+				auto name = GetKey(context);
+				auto object = GetTargetAndAlsoCheckForProxy();
+				ret = TransferOut(detail::GetProperty(context, object, name, accessors, inherit), options);
+			}
 		}
 
 		auto Phase3() -> Local<Value> final {
@@ -545,6 +913,14 @@ class GetRunner final : public AccessorRunner {
 		}
 
 	private:
+		static auto ReadAccessors(MaybeLocal<Object> maybe_options) -> bool {
+			if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+				return call_options->accessors;
+			}
+			return ReadOption(maybe_options, StringTable::Get().accessors, false);
+		}
+
+		shared_ptr<detail::PendingValue> result_pending;
 		unique_ptr<Transferable> ret;
 		TransferOptions options;
 		bool accessors;
@@ -555,6 +931,12 @@ auto ReferenceHandle::Get(Local<Value> key_handle, MaybeLocal<Object> maybe_opti
 	return ThreePhaseTask::Run<async, GetRunner>(*isolate, *this, key_handle, maybe_options);
 }
 
+auto ReferenceHandle::GetPending(Local<Value> key_handle, MaybeLocal<Object> maybe_options) -> Local<Value> {
+	auto result = std::make_shared<detail::PendingValue>(isolate);
+	ThreePhaseTask::Run<2, GetRunner>(*isolate, *this, key_handle, maybe_options, result);
+	return ClassHandle::NewInstance<ReferenceHandle>(isolate, RemoteHandle<Value>{}, context, TypeOf::Undefined, false, inherit, std::move(result));
+}
+
 /**
  * Delete a property on this reference
  */
@@ -621,11 +1003,132 @@ auto ReferenceHandle::Set(Local<Value> key_handle, Local<Value> val_handle, Mayb
 }
 
 void ReferenceHandle::CheckDisposed() const {
-	if (!reference) {
+	if (!reference && !pending) {
 		throw RuntimeGenericError("Reference has been released");
 	}
 }
 
+namespace detail {
+
+auto CheckForProxy(Local<Value> value) -> Local<Object> {
+	if (!value->IsObject()) {
+		throw RuntimeTypeError("Reference is not an object");
+	}
+	auto object = value.As<Object>();
+	for (auto target = object;;) {
+		if (target->IsProxy()) {
+			throw RuntimeTypeError("Object is or has proxy");
+		}
+		auto proto = target->GetPrototype();
+		if (proto->IsNullOrUndefined()) {
+			return object;
+		}
+		target = proto.As<Object>();
+	}
+}
+
+auto PropertyKey(Local<Context> context, Local<Value> key) -> Local<Name> {
+	return (key->IsString() || key->IsSymbol()) ?
+		key.As<Name>() : Unmaybe(key->ToString(context)).As<Name>();
+}
+
+auto GetProperty(Local<Context> context, Local<Object> object, Local<Name> name, bool accessors, bool inherit) -> Local<Value> {
+	auto* isolate = Isolate::GetCurrent();
+	if (inherit) {
+		// To avoid accessors I guess we have to walk the prototype chain ourselves
+		auto target = object;
+		if (!accessors) {
+			do {
+				if (Unmaybe(target->HasOwnProperty(context, name))) {
+					if (Unmaybe(target->HasRealNamedCallbackProperty(context, name))) {
+						throw RuntimeTypeError("Property is getter");
+					}
+					return Unmaybe(target->GetRealNamedProperty(context, name));
+				}
+				auto next = target->GetPrototype();
+				if (next->IsNullOrUndefined()) {
+					return Undefined(isolate).As<Value>();
+				}
+				target = next.As<Object>();
+			} while (true);
+		}
+	} else if (!Unmaybe(object->HasOwnProperty(context, name))) {
+		return Undefined(isolate).As<Value>();
+	} else if (!accessors && Unmaybe(object->HasRealNamedCallbackProperty(context, name))) {
+		throw RuntimeTypeError("Property is getter");
+	}
+	return Unmaybe(object->Get(context, name));
+}
+
+/**
+ * PendingValue implementation
+ */
+void PendingValue::Resolve(Local<Value> value) {
+	auto lock = state.write();
+	lock->value = RemoteHandle<Value>{value};
+	lock->type_of = InferTypeOf(value);
+	lock->resolved = true;
+	state.notify_all();
+}
+
+void PendingValue::Reject(unique_ptr<ExternalCopy> error) {
+	auto lock = state.write();
+	lock->error = std::move(error);
+	lock->resolved = true;
+	state.notify_all();
+}
+
+void PendingValue::Abandon() {
+	auto lock = state.write();
+	if (!lock->resolved) {
+		lock->error = std::make_unique<ExternalCopyError>(ExternalCopyError::ErrorType::Error, "Isolate is disposed");
+		lock->resolved = true;
+		state.notify_all();
+	}
+}
+
+void PendingValue::Wait() {
+	auto lock = state.write<true>();
+	if (lock->resolved) {
+		return;
+	}
+	auto env = isolate->GetIsolate();
+	if (env && Locker::IsLocked(env->GetIsolate())) {
+		throw RuntimeGenericError("Reference is still pending");
+	}
+	env.reset();
+	while (!lock->resolved) {
+		lock.wait();
+	}
+}
+
+void PendingValue::CheckResolved(const State& state) const {
+	if (!state.resolved) {
+		throw RuntimeGenericError("Reference is still pending");
+	} else if (state.error) {
+		Isolate::GetCurrent()->ThrowException(state.error->CopyInto());
+		throw RuntimeError();
+	}
+}
+
+auto PendingValue::Deref() const -> Local<Value> {
+	return ivm::Deref(GetReference());
+}
+
+auto PendingValue::GetReference() const -> RemoteHandle<Value> {
+	auto lock = state.read();
+	CheckResolved(*lock);
+	return lock->value;
+}
+
+auto PendingValue::GetTypeOf() const -> ReferenceData::TypeOf {
+	auto lock = state.read();
+	CheckResolved(*lock);
+	return lock->type_of;
+}
+
+} // namespace detail
+
 /**
  * ReferenceHandleTransferable implementation
  */
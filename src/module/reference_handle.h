@@ -1,5 +1,7 @@
 #pragma once
 #include "isolate/remote_handle.h"
+#include "isolate/three_phase_task.h"
+#include "lib/lockable.h"
 #include "transferable.h"
 #include <v8.h>
 #include <memory>
@@ -7,8 +9,13 @@
 #include <vector>
 
 namespace ivm {
+
+class ExternalCopy;
+
 namespace detail {
 
+class PendingValue;
+
 /**
  * Holds common data for ReferenceHandle and ReferenceHandleTransferable
  */
@@ -24,18 +31,68 @@ class ReferenceData {
 			RemoteHandle<v8::Context> context,
 			TypeOf type_of,
 			bool accessors,
-			bool inherit
+			bool inherit,
+			std::shared_ptr<PendingValue> pending = {}
 		);
 
 	protected:
 		std::shared_ptr<IsolateHolder> isolate;
 		RemoteHandle<v8::Value> reference;
 		RemoteHandle<v8::Context> context;
+		// Set instead of `reference` for the result of `applyPending` and `getPending`
+		std::shared_ptr<PendingValue> pending;
 		TypeOf type_of;
 		bool accessors;
 		bool inherit;
 };
 
+/**
+ * Value produced by `applyPending` or `getPending`. The producing task fills this in from the
+ * target isolate, so tasks queued behind it can use the value without a trip back to the caller.
+ * Sync tasks skip the queue and wait for it instead.
+ */
+class PendingValue final : public QueuedValue {
+	public:
+		explicit PendingValue(std::shared_ptr<IsolateHolder> isolate) : isolate{std::move(isolate)} {}
+
+		// Invoked in the target isolate by the producing task
+		void Resolve(v8::Local<v8::Value> value);
+		void Reject(std::unique_ptr<ExternalCopy> error);
+		// Invoked when the producing task is destroyed, which rejects the value if the task never ran
+		void Abandon();
+
+		// Throws if this thread holds the target isolate, since the producer would never get to run
+		void Wait() final;
+
+		// These throw the producer's error if it failed
+		auto Deref() const -> v8::Local<v8::Value>;
+		auto GetTypeOf() const -> ReferenceData::TypeOf;
+
+	private:
+		struct State {
+			RemoteHandle<v8::Value> value;
+			std::shared_ptr<ExternalCopy> error;
+			ReferenceData::TypeOf type_of = ReferenceData::TypeOf::Undefined;
+			bool resolved = false;
+		};
+		void CheckResolved(const State& state) const;
+		auto GetReference() const -> RemoteHandle<v8::Value>;
+
+		std::shared_ptr<IsolateHolder> isolate;
+		lockable_t<State, false, true> state;
+};
+
+// Property access shared by `Reference` and `Pipeline`, invoked in the target isolate
+auto CheckForProxy(v8::Local<v8::Value> value) -> v8::Local<v8::Object>;
+auto PropertyKey(v8::Local<v8::Context> context, v8::Local<v8::Value> key) -> v8::Local<v8::Name>;
+auto GetProperty(
+	v8::Local<v8::Context> context,
+	v8::Local<v8::Object> object,
+	v8::Local<v8::Name> name,
+	bool accessors,
+	bool inherit
+) -> v8::Local<v8::Value>;
+
 } // namespace detail
 
 /**
@@ -46,6 +103,7 @@ class ReferenceHandle : public TransferableHandle, public detail::ReferenceData
 	friend class CopyRunner;
 	friend class AccessorRunner;
 	friend class GetRunner;
+	friend class PipelineHandle;
 	public:
 		using TypeOf = detail::ReferenceData::TypeOf;
 
@@ -69,6 +127,18 @@ class ReferenceHandle : public TransferableHandle, public detail::ReferenceData
 			v8::MaybeLocal<v8::Object> maybe_options
 		) -> v8::Local<v8::Value>;
 
+		auto ApplyPending(
+			v8::MaybeLocal<v8::Value> recv_handle,
+			v8::Maybe<ArrayRange> maybe_arguments,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+
+		auto ApplyIterator(
+			v8::MaybeLocal<v8::Value> recv_handle,
+			v8::Maybe<ArrayRange> maybe_arguments,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+
 		template <int async>
 		auto Copy() -> v8::Local<v8::Value>;
 
@@ -78,6 +148,11 @@ class ReferenceHandle : public TransferableHandle, public detail::ReferenceData
 			v8::MaybeLocal<v8::Object> maybe_options
 		) -> v8::Local<v8::Value>;
 
+		auto GetPending(
+			v8::Local<v8::Value> key_handle,
+			v8::MaybeLocal<v8::Object> maybe_options
+		) -> v8::Local<v8::Value>;
+
 		template <int async>
 		auto Delete(v8::Local<v8::Value> key_handle) -> v8::Local<v8::Value>;
 
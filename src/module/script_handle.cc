@@ -1,6 +1,9 @@
 #include "isolate/run_with_timeout.h"
 #include "isolate/three_phase_task.h"
+#include "call_options_handle.h"
 #include "context_handle.h"
+#include "evaluation.h"
+#include "external_copy_handle.h"
 #include "script_handle.h"
 
 using namespace v8;
@@ -16,6 +19,8 @@ ScriptHandle::ScriptHandle(RemoteHandle<UnboundScript> script) :
 auto ScriptHandle::Definition() -> Local<FunctionTemplate> {
 	return Inherit<TransferableHandle>(MakeClass(
 		"Script", nullptr,
+		"createCachedData", MemberFunction<decltype(&ScriptHandle::CreateCachedData<1>), &ScriptHandle::CreateCachedData<1>>{},
+		"createCachedDataSync", MemberFunction<decltype(&ScriptHandle::CreateCachedData<0>), &ScriptHandle::CreateCachedData<0>>{},
 		"release", MemberFunction<decltype(&ScriptHandle::Release), &ScriptHandle::Release>{},
 		"run", MemberFunction<decltype(&ScriptHandle::Run<1>), &ScriptHandle::Run<1>>{},
 		"runIgnored", MemberFunction<decltype(&ScriptHandle::Run<2>), &ScriptHandle::Run<2>>{},
@@ -52,9 +57,14 @@ struct RunRunner /* lol */ : public ThreePhaseTask {
 		// Parse options
 		bool release = false;
 		Local<Object> options;
-		if (maybe_options.ToLocal(&options)) {
+		if (const auto* call_options = CallOptionsHandle::Find(maybe_options)) {
+			release = call_options->release;
+			timeout_ms = call_options->timeout;
+			cpu_timeout_ms = call_options->cpu_timeout;
+		} else if (maybe_options.ToLocal(&options)) {
 			release = ReadOption<bool>(options, StringTable::Get().release, false);
 			timeout_ms = ReadOption<int32_t>(options, StringTable::Get().timeout, 0);
+			cpu_timeout_ms = ReadOption<int32_t>(options, StringTable::Get().cpuTimeout, 0);
 		}
 		if (release) {
 			this->script = std::move(script);
@@ -69,7 +79,7 @@ struct RunRunner /* lol */ : public ThreePhaseTask {
 		Local<Context> context_local = Deref(context);
 		Context::Scope context_scope{context_local};
 		Local<Script> script_handle = Deref(script)->BindToCurrentContext();
-		Local<Value> script_result = RunWithTimeout(timeout_ms, [&script_handle, &context_local]() {
+		Local<Value> script_result = RunWithTimeout(timeout_ms, cpu_timeout_ms, [&script_handle, &context_local]() {
 			return script_handle->Run(context_local);
 		});
 		result = OptionalTransferOut(script_result, transfer_options);
@@ -88,12 +98,43 @@ struct RunRunner /* lol */ : public ThreePhaseTask {
 	TransferOptions transfer_options;
 	std::unique_ptr<Transferable> result;
 	uint32_t timeout_ms = 0;
+	uint32_t cpu_timeout_ms = 0;
 };
 template <int async>
 auto ScriptHandle::Run(ContextHandle& context_handle, MaybeLocal<Object> maybe_options) -> Local<Value> {
 	return ThreePhaseTask::Run<async, RunRunner>(*script.GetIsolateHolder(), script, context_handle, maybe_options);
 }
 
+/*
+ * Serialize the script's code cache, including any functions which have been compiled since
+ */
+struct CreateCachedDataRunner : public ThreePhaseTask {
+	explicit CreateCachedDataRunner(RemoteHandle<UnboundScript> script) : script{std::move(script)} {}
+
+	void Phase2() final {
+		auto* data = ScriptCompiler::CreateCodeCache(Deref(script));
+		if (data == nullptr) {
+			// v8 refuses to serialize code containing asm.js
+			throw RuntimeGenericError("Code cache could not be created");
+		}
+		cached_data = CachedDataToExternalCopy(data);
+	}
+
+	auto Phase3() -> Local<Value> final {
+		return ClassHandle::NewInstance<ExternalCopyHandle>(std::move(cached_data));
+	}
+
+	RemoteHandle<UnboundScript> script;
+	std::shared_ptr<ExternalCopyArrayBuffer> cached_data;
+};
+template <int async>
+auto ScriptHandle::CreateCachedData() -> Local<Value> {
+	if (!script) {
+		throw RuntimeGenericError("Script has been released");
+	}
+	return ThreePhaseTask::Run<async, CreateCachedDataRunner>(*script.GetIsolateHolder(), script);
+}
+
 /**
  * ScriptHandleTransferable implementation
  */
@@ -18,6 +18,8 @@ class ScriptHandle : public TransferableHandle {
 
 		auto TransferOut() -> std::unique_ptr<Transferable> final;
 
+		template <int async>
+		auto CreateCachedData() -> v8::Local<v8::Value>;
 		auto Release() -> v8::Local<v8::Value>;
 		template <int async>
 		auto Run(ContextHandle& context_handle, v8::MaybeLocal<v8::Object> maybe_options) -> v8::Local<v8::Value>;
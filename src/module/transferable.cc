@@ -2,6 +2,7 @@
 #include "isolate/class_handle.h"
 #include "isolate/util.h"
 #include "lib/lockable.h"
+#include "call_options_handle.h"
 #include "callback.h"
 #include "reference_handle.h"
 #include "transferable.h"
@@ -185,7 +186,12 @@ TransferOptions::TransferOptions(Local<Object> options, Type fallback) : fallbac
 TransferOptions::TransferOptions(MaybeLocal<Object> maybe_options, Type fallback) : fallback{fallback} {
 	Local<Object> options;
 	if (maybe_options.ToLocal(&options)) {
-		ParseOptions(options);
+		if (const auto* call_options = CallOptionsHandle::Find(options)) {
+			type = call_options->transfer_options.type;
+			promise = call_options->transfer_options.promise;
+		} else {
+			ParseOptions(options);
+		}
 	}
 }
 
@@ -23,6 +23,12 @@ class TransferOptions {
 		explicit TransferOptions(Type fallback) : fallback{fallback} {};
 		explicit TransferOptions(v8::Local<v8::Object> options, Type fallback = Type::None);
 		explicit TransferOptions(v8::MaybeLocal<v8::Object> maybe_options, Type fallback = Type::None);
+		// Same options with a different fallback, for parsed options which are shared between calls
+		auto WithFallback(Type fallback) const -> TransferOptions {
+			TransferOptions options = *this;
+			options.fallback = fallback;
+			return options;
+		}
 
 		auto operator==(const TransferOptions& that) const -> bool {
 			return type == that.type && fallback == that.fallback && promise == that.promise;
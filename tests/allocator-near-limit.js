@@ -0,0 +1,25 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Churn through short-lived buffers while most of the memory limit is retained. This should
+// succeed, and it shouldn't take a full GC per allocation to do it.
+const isolate = new ivm.Isolate({ memoryLimit: 64 });
+const context = isolate.createContextSync();
+const result = isolate.compileScriptSync(`
+	const retained = [];
+	for (let ii = 0; ii < 48; ++ii) {
+		retained.push(new Uint8Array(1024 * 1024));
+	}
+	let sum = 0;
+	for (let ii = 0; ii < 4000; ++ii) {
+		sum += new Uint8Array(256 * 1024).length;
+	}
+	sum;
+`).runSync(context, { timeout: 10000 });
+assert.strictEqual(result, 4000 * 256 * 1024);
+
+// Going over the limit still fails
+assert.throws(() => isolate.compileScriptSync('new Uint8Array(32 * 1024 * 1024)').runSync(context), RangeError);
+assert(!isolate.isDisposed);
+console.log('pass');
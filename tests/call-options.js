@@ -0,0 +1,38 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const fn = context.evalSync('(function(value) { return { value } })', { reference: true });
+const copy = new ivm.CallOptions({ arguments: { copy: true }, result: { copy: true } });
+
+// The same instance can be reused for many calls
+for (let ii = 0; ii < 3; ++ii) {
+	assert.deepStrictEqual(fn.applySync(undefined, [ { ii } ], copy), { value: { ii } });
+}
+(async function() {
+	assert.deepStrictEqual(await fn.apply(undefined, [ [ 1 ] ], copy), { value: [ 1 ] });
+
+	// Options are read once, so later changes to the source object have no effect
+	const source = { timeout: 20 };
+	const timeout = new ivm.CallOptions(source);
+	source.timeout = 0;
+	assert.throws(() => context.evalSync('for(;;);', timeout), /timed out/);
+	assert.throws(() => context.evalClosureSync('for(;;);', [], timeout), /timed out/);
+	assert.throws(() => isolate.compileScriptSync('for(;;);').runSync(context, timeout), /timed out/);
+
+	// Top-level transfer options are used by `get`, `set`, `eval`, and `run`
+	const copyResult = new ivm.CallOptions({ copy: true });
+	assert.deepStrictEqual(context.evalSync('({ a: 1 })', copyResult), { a: 1 });
+	context.global.setSync('object', { b: 2 }, copyResult);
+	assert.deepStrictEqual(context.global.getSync('object', copyResult), { b: 2 });
+	context.evalSync('Object.defineProperty(globalThis, "getter", { get: () => 3 })');
+	assert.throws(() => context.global.getSync('getter'), /getter/);
+	assert.strictEqual(context.global.getSync('getter', new ivm.CallOptions({ accessors: true, copy: true })), 3);
+
+	// Validation happens up front
+	assert.throws(() => new ivm.CallOptions({ copy: true, reference: true }), /Only one of/);
+	assert.throws(() => new ivm.CallOptions({ result: { copy: true, externalCopy: true } }), /Only one of/);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,90 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate({ memoryLimit: 32 });
+const context = isolate.createContextSync();
+const channel = new ivm.Channel({ capacity: 100 });
+assert.strictEqual(channel.capacity, 128);
+context.global.setSync('channel', channel);
+
+// Raw bytes, views and serialized values
+isolate.compileScriptSync(`
+	channel.send(new Uint8Array([ 1, 2, 3 ]).buffer);
+	channel.send(new Uint16Array([ 4, 5 ]));
+	channel.send(new Float64Array([ 0.5 ]));
+	channel.send(new DataView(new Uint8Array([ 6, 7, 8 ]).buffer, 1));
+	channel.send({ hello: 'world', list: [ 1, 2 ] });
+`).runSync(context);
+const buffer = channel.tryReceive();
+assert(buffer instanceof ArrayBuffer);
+assert.deepStrictEqual([ ...new Uint8Array(buffer) ], [ 1, 2, 3 ]);
+const view = channel.tryReceive();
+assert(view instanceof Uint16Array);
+assert.deepStrictEqual([ ...view ], [ 4, 5 ]);
+const doubles = channel.tryReceive();
+assert(doubles instanceof Float64Array);
+assert.deepStrictEqual([ ...doubles ], [ 0.5 ]);
+const dataView = channel.tryReceive();
+assert(dataView instanceof DataView);
+assert.deepStrictEqual([ dataView.getUint8(0), dataView.getUint8(1) ], [ 7, 8 ]);
+assert.deepStrictEqual(channel.tryReceive(), { hello: 'world', list: [ 1, 2 ] });
+assert.strictEqual(channel.tryReceive(), undefined);
+
+// Full channel, and messages which would never fit
+let sent = 0;
+while (channel.send(new Uint8Array(15))) {
+	++sent;
+}
+assert.strictEqual(sent, 128 / 16);
+assert.throws(() => channel.send(new Uint8Array(128)), RangeError);
+assert.throws(() => channel.send(new ivm.Reference({})), TypeError);
+while (channel.tryReceive() !== undefined);
+
+// A message which can't be received is dropped instead of blocking the channel
+const large = new ivm.Channel({ capacity: 64 * 1024 * 1024 });
+context.global.setSync('large', large);
+large.send(new Uint8Array(40 * 1024 * 1024));
+large.send('after');
+assert.throws(() => isolate.compileScriptSync('large.tryReceive()').runSync(context), RangeError);
+assert.strictEqual(isolate.compileScriptSync('large.tryReceive()').runSync(context), 'after');
+
+(async function() {
+	// Host waits for messages sent from an async task in the isolate. Messages wrap around the ring.
+	const received = [];
+	const done = (async function() {
+		for (let ii = 0; ii < 100; ++ii) {
+			received.push(await channel.receive());
+		}
+	})();
+	await isolate.compileScriptSync(`
+		for (let ii = 0; ii < 100; ++ii) {
+			while (!channel.send(ii));
+		}
+	`).run(context);
+	await done;
+	assert.deepStrictEqual(received, Array.from({ length: 100 }, (_, ii) => ii));
+
+	// Isolate waits for messages sent from the host
+	const result = isolate.compileScriptSync(`
+		(async function() {
+			let sum = 0;
+			for (let ii = 0; ii < 10; ++ii) {
+				sum += await channel.receive();
+			}
+			return sum;
+		})()
+	`).run(context, { promise: true });
+	for (let ii = 0; ii < 10; ++ii) {
+		await new Promise(resolve => setTimeout(resolve, 1));
+		channel.send(ii);
+	}
+	assert.strictEqual(await result, 45);
+
+	// `tryReceive()` doesn't jump ahead of pending `receive()` calls
+	const first = channel.receive();
+	channel.send('first');
+	assert.strictEqual(channel.tryReceive(), undefined);
+	assert.strictEqual(await first, 'first');
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,51 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const codeCacheDir = fs.mkdtempSync(path.join(os.tmpdir(), 'ivm-'));
+(async function() {
+	const code = 'function add(a, b) { return a + b; } add(1, 2)';
+	const compile = () => new ivm.Isolate({ codeCacheDir }).compileScriptSync(code);
+	const files = () => fs.readdirSync(codeCacheDir);
+
+	// First compile writes the cache, later ones consume it
+	assert.strictEqual(compile().cachedDataRejected, undefined);
+	assert.strictEqual(files().length, 1);
+	assert.ok(files()[0].endsWith('.cache'));
+	// Keyed by a SHA-256 of the source, so distinct sources can't share a cache
+	assert.ok(files()[0].startsWith(crypto.createHash('sha256').update(code, 'latin1').digest('hex')));
+	assert.strictEqual(compile().cachedDataRejected, false);
+
+	// Rejected caches are replaced
+	const file = path.join(codeCacheDir, files()[0]);
+	fs.writeFileSync(file, 'garbage');
+	assert.strictEqual(compile().cachedDataRejected, true);
+	assert.strictEqual(compile().cachedDataRejected, false);
+
+	// Explicit `produceCachedData` still works alongside the directory
+	const isolate = new ivm.Isolate({ codeCacheDir });
+	const script = await isolate.compileScript('1 + 1', { produceCachedData: true });
+	assert.ok(script.cachedData instanceof ivm.ExternalCopy);
+	assert.strictEqual((await isolate.compileScript('1 + 1')).cachedDataRejected, false);
+
+	// Modules and large streamed sources are cached too
+	const moduleCode = 'export default 1;';
+	await isolate.compileModule(moduleCode);
+	assert.strictEqual((await isolate.compileModule(moduleCode)).cachedDataRejected, false);
+	const large = Array(20000).fill().map((_, ii) => `function fn${ii}() { return ${ii}; }`).join('\n');
+	await isolate.compileScript(large);
+	const cached = await isolate.compileScript(large);
+	assert.strictEqual(cached.cachedDataRejected, false);
+	const largeKey = crypto.createHash('sha256').update(large, 'latin1').digest('hex');
+	assert.ok(files().some(name => name.startsWith(largeKey)));
+	assert.strictEqual(await cached.run(await isolate.createContext()), undefined);
+
+	// No temporary files are left behind
+	assert.strictEqual(files().length, 4);
+	assert.ok(files().every(name => name.endsWith('.cache')));
+	console.log('pass');
+})().catch(console.error).finally(() => fs.rmSync(codeCacheDir, { recursive: true, force: true }));
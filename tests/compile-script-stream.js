@@ -0,0 +1,69 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	const isolate = new ivm.Isolate;
+	const context = await isolate.createContext();
+
+	// Chunks may be strings, buffers, or ExternalCopy instances and may split multi-byte characters
+	const snowman = Buffer.from("'☃'");
+	async function* source() {
+		yield 'const value = ';
+		yield snowman.subarray(0, 2);
+		await new Promise(resolve => setTimeout(resolve, 10));
+		yield snowman.subarray(2);
+		yield new ivm.ExternalCopy(' + 1;\n');
+		yield '';
+		yield new ivm.ExternalCopy(new TextEncoder().encode('value').buffer);
+	}
+	const script = await isolate.compileScriptStream(source(), { produceCachedData: true });
+	assert.strictEqual(await script.run(context), '☃1');
+	assert.ok(script.cachedData);
+
+	// Plain iterables work too
+	const fns = Array(2000).fill().map((_, ii) => `function fn${ii}() { return ${ii}; }\n`);
+	const large = await isolate.compileScriptStream([ ...fns, 'fn1999()' ]);
+	assert.strictEqual(await large.run(context), 1999);
+
+	// Syntax errors are annotated like any other compile
+	await assert.rejects(isolate.compileScriptStream([ '1 +\n', ')' ], { filename: 'stream.js' }), /SyntaxError.*stream\.js:2/s);
+
+	// Errors from the source iterator reject the compile
+	async function* broken() {
+		yield 'let a = 1;';
+		throw new Error('read failed');
+	}
+	await assert.rejects(isolate.compileScriptStream(broken()), /read failed/);
+	await assert.rejects(isolate.compileScriptStream([ 1 ]), /Source chunks must be/);
+	await assert.rejects(isolate.compileScriptStream({}), /must be an iterable/);
+	await assert.rejects(isolate.compileScriptStream([], { cachedData: script.cachedData }), /`cachedData` is not supported/);
+
+	// Streams waiting on the host don't hold up v8's platform workers, which node uses to compile wasm
+	let release;
+	const stalled = new Promise(resolve => release = resolve);
+	const waiting = Array(16).fill().map(() => isolate.compileScriptStream((async function*() {
+		yield 'let a = 1;';
+		await stalled;
+	})()));
+	await new Promise(resolve => setTimeout(resolve, 50));
+	const wasm = new Uint8Array([ 0, 0x61, 0x73, 0x6d, 1, 0, 0, 0, 1, 4, 1, 0x60, 0, 0, 3, 2, 1, 0, 10, 4, 1, 2, 0, 0x0b ]);
+	const compiled = await Promise.race([
+		WebAssembly.compile(wasm),
+		new Promise(resolve => setTimeout(resolve, 2000)),
+	]);
+	assert.ok(compiled instanceof WebAssembly.Module);
+	release();
+	await Promise.all(waiting);
+
+	// A stream which never ends doesn't outlive the isolate
+	const other = new ivm.Isolate;
+	const pending = other.compileScriptStream((async function*() {
+		yield 'let a = 1;';
+		await new Promise(resolve => setTimeout(resolve, 50));
+		yield 'let b = 2;';
+	})());
+	other.dispose();
+	await assert.rejects(pending, /disposed/);
+	console.log('pass');
+})().catch(console.error);
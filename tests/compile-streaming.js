@@ -0,0 +1,38 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Large enough to be compiled on a worker thread
+const body = Array(20000).fill().map((_, ii) => `function fn${ii}() { return ${ii}; }`).join('\n');
+
+(async function() {
+	const isolate = new ivm.Isolate;
+	const context = await isolate.createContext();
+
+	const script = await isolate.compileScript(`${body}\nfn19999() + fn1();`, { produceCachedData: true });
+	assert.strictEqual(await script.run(context), 20000);
+	assert.ok(script.cachedData);
+
+	const twoByte = await isolate.compileScript(`${body}\n'☃' + fn2();`);
+	assert.strictEqual(await twoByte.run(context), '☃2');
+
+	await assert.rejects(isolate.compileScript(`${body}\n)`, { filename: 'big.js' }), /SyntaxError.*big\.js:20001/s);
+
+	const module = await isolate.compileModule(`${body}\nexport default fn3();`);
+	await module.instantiate(context, () => {});
+	await module.evaluate();
+	assert.strictEqual(await module.namespace.get('default'), 3);
+
+	// Disposing mid-compile settles instead of crashing. Whether it resolves depends on how far the
+	// compile got.
+	for (let ii = 0; ii < 10; ++ii) {
+		const other = new ivm.Isolate;
+		const pending = other.compileScript(body);
+		if (ii % 2) {
+			await new Promise(resolve => setTimeout(resolve, ii));
+		}
+		other.dispose();
+		await pending.catch(() => {});
+	}
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,28 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	const isolate = new ivm.Isolate;
+	const context = await isolate.createContext();
+	const fn = await context.eval('value => { if (value % 7 === 0) throw new Error(String(value)); return value; }', { reference: true });
+
+	// Many completions arrive in the same wake, they still settle in order and continuations run
+	const order = [];
+	const ticks = [];
+	const calls = [];
+	for (let ii = 1; ii <= 1000; ++ii) {
+		calls.push(fn.apply(undefined, [ ii ]).then(value => {
+			order.push(value);
+			process.nextTick(() => ticks.push(value));
+		}, error => {
+			order.push(Number(error.message));
+			assert.ok(/completion-batch\.js/.test(error.stack));
+		}));
+	}
+	await Promise.all(calls);
+	await new Promise(resolve => setImmediate(resolve));
+	assert.deepStrictEqual(order, Array.from({ length: 1000 }, (_, ii) => ii + 1));
+	assert.strictEqual(ticks.length, 1000 - Math.floor(1000 / 7));
+	console.log('pass');
+})().catch(console.error);
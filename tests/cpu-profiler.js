@@ -116,11 +116,52 @@ const testEmpty = async () => {
 	assert.ok(profiles.length === 0, 'profiles should have length 0');
 };
 
+const testLockCycles = async () => {
+	const isolate = new ivm.Isolate();
+	const context = await isolate.createContext();
+	await context.eval(`
+		function spin(ms) {
+			const until = Date.now() + ms;
+			let value = 0;
+			do {
+				for (let ii = 0; ii < 1e4; ++ii) {
+					value += Math.sqrt(ii);
+				}
+			} while (Date.now() < until);
+			return value;
+		}
+	`, { filename: 'spin.js' });
+	const spin = await context.global.get('spin', { reference: true });
+
+	isolate.startCpuProfiler('cycles');
+	// Each call is a separate lock of the isolate, alternating between a pool thread and this one
+	for (let ii = 0; ii < 10; ++ii) {
+		await spin.apply(undefined, [ 10 ]);
+		spin.applySync(undefined, [ 10 ]);
+		await new Promise(resolve => setTimeout(resolve, 5));
+	}
+	const profiles = await isolate.stopCpuProfiler('cycles');
+
+	const threads = new Set(profiles.map(({ threadId }) => threadId));
+	assert.strictEqual(threads.size, profiles.length, 'there should be one profile per thread');
+	profiles.forEach(({ profile }, idx) => {
+		checkProfile(profile, idx);
+		const ids = new Set(profile.nodes.map(node => node.id));
+		assert.ok(profile.samples.every(id => ids.has(id)), 'samples should point at nodes in the same profile');
+		const spinNodes = profile.nodes.filter(node => node.callFrame.functionName === 'spin');
+		assert.ok(spinNodes.length <= 1, 'the same call path should merge into one node');
+	});
+	// One 10ms call is sampled at most ~10 times at the default 1ms interval, and v8 drops samples
+	// taken while the thread doesn't hold the isolate
+	const mostSamples = Math.max(...profiles.map(({ profile }) => profile.samples.length));
+	assert.ok(mostSamples > 15, `expected samples from several lock cycles, got ${mostSamples}`);
+	isolate.dispose();
+};
 
 Promise.all([
 	testEmpty(),
 	testSync(),
 	testAsync(),
-]).then(() => {
+]).then(testLockCycles).then(() => {
 	console.log('pass');
 });
@@ -0,0 +1,52 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const spin = '{ const until = Date.now() + 10; while (Date.now() < until); }';
+
+async function runTasks(isolate) {
+	const context = await isolate.createContext();
+	const start = Date.now();
+	await Promise.all(Array(10).fill().map(() => context.eval(spin)));
+	return Date.now() - start;
+}
+
+(async function() {
+	// 10ms of CPU per 100ms window, so 100ms of work has to be spread out
+	{
+		const isolate = new ivm.Isolate;
+		const unthrottled = await runTasks(isolate);
+		isolate.dispose();
+		const throttled = new ivm.Isolate({ cpuQuota: { ms: 10, windowMs: 100 } });
+		assert.ok(await runTasks(throttled) >= Math.max(500, unthrottled));
+		throttled.dispose();
+	}
+
+	// Hard budget disposes the isolate
+	{
+		const isolate = new ivm.Isolate({ cpuQuota: { budgetMs: 50 } });
+		const context = await isolate.createContext();
+		await assert.rejects(context.eval('for (;;);'), /due to CPU limit/);
+		assert.ok(isolate.isDisposed);
+	}
+
+	// Budget also covers code which runs straight from the task loop, like message handlers
+	{
+		const isolate = new ivm.Isolate({ cpuQuota: { budgetMs: 50 } });
+		const context = await isolate.createContext();
+		const { port1, port2 } = new ivm.MessageChannel();
+		await context.global.set('port', port2);
+		await context.eval('port.onmessage = () => { for (;;); }');
+		// Let the watchdog armed by `eval` run out
+		await new Promise(resolve => setTimeout(resolve, 100));
+		port1.postMessage('spin');
+		for (let ii = 0; ii < 100 && !isolate.isDisposed; ++ii) {
+			await new Promise(resolve => setTimeout(resolve, 20));
+		}
+		assert.ok(isolate.isDisposed);
+		port1.close();
+	}
+
+	assert.throws(() => new ivm.Isolate({ cpuQuota: { ms: -1 } }), RangeError);
+	console.log('pass');
+})().catch(console.error);
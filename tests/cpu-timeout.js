@@ -0,0 +1,25 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+
+// Busy loop is canceled once it has used up its CPU time
+assert.throws(() => context.evalSync('for (;;);', { cpuTimeout: 50 }), /timed out/);
+
+// Time spent blocked in the host doesn't count against the guest
+context.global.setSync('sleep', new ivm.Reference(ms => {
+	const until = Date.now() + ms;
+	while (Date.now() < until);
+}));
+assert.strictEqual(context.evalSync('sleep.applySync(undefined, [ 200 ]); 1', { cpuTimeout: 50 }), 1);
+
+// Both limits together, the earlier one wins
+assert.throws(() => context.evalSync('for (;;);', { timeout: 2000, cpuTimeout: 20 }), /timed out/);
+
+(async function() {
+	const fn = await context.eval('(function() { for (;;); })', { reference: true });
+	await assert.rejects(fn.apply(undefined, [], { cpuTimeout: 20 }), /timed out/);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,55 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const code = `${Array(200).fill().map((_, ii) => `function fn${ii}() { return ${ii}; }`).join('\n')}
+function warmup() { let sum = 0; ${Array(200).fill().map((_, ii) => `sum += fn${ii}();`).join(' ')} return sum; }`;
+
+(async function() {
+	const isolate = new ivm.Isolate;
+	const context = await isolate.createContext();
+
+	// Cache created after running includes the lazily compiled functions
+	const script = await isolate.compileScript(code, { produceCachedData: true });
+	await script.run(context);
+	assert.strictEqual(await context.eval('warmup()'), 19900);
+	const warm = await script.createCachedData();
+	assert.ok(warm instanceof ivm.ExternalCopy);
+	assert.ok(warm.copy().byteLength > script.cachedData.copy().byteLength);
+	assert.ok(script.createCachedDataSync().copy().byteLength > 0);
+
+	const other = new ivm.Isolate;
+	const otherContext = await other.createContext();
+	const cached = await other.compileScript(code, { cachedData: warm });
+	assert.strictEqual(cached.cachedDataRejected, false);
+	await cached.run(otherContext);
+	assert.strictEqual(await otherContext.eval('warmup()'), 19900);
+
+	// Modules too
+	const module = await isolate.compileModule(`${code}\nexport default warmup();`);
+	await module.instantiate(context, () => {});
+	await module.evaluate();
+	const moduleCache = await module.createCachedData();
+	const cachedModule = await other.compileModule(`${code}\nexport default warmup();`, { cachedData: moduleCache });
+	assert.strictEqual(cachedModule.cachedDataRejected, false);
+
+	const broken = await isolate.compileModule('throw new Error("nope")');
+	await broken.instantiate(context, () => {});
+	await assert.rejects(broken.evaluate());
+	await assert.rejects(broken.createCachedData(), /evaluation failed/);
+
+	// v8 won't serialize asm.js
+	const asm = 'function Asm() { "use asm"; function fn() { return 1; } return { fn: fn }; } Asm().fn();';
+	const asmScript = await isolate.compileScript(asm);
+	await asmScript.run(context);
+	await assert.rejects(asmScript.createCachedData(), /could not be created/);
+	assert.throws(() => asmScript.createCachedDataSync(), /could not be created/);
+	const asmModule = await isolate.compileModule(`${asm}\nexport default 1;`);
+	await asmModule.instantiate(context, () => {});
+	await asmModule.evaluate();
+	await assert.rejects(asmModule.createCachedData(), /could not be created/);
+
+	script.release();
+	assert.throws(() => script.createCachedDataSync(), /released/);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,29 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+// Each isolate gets a private view of the same shared memory
+const source = new Uint8Array(4 * 1024 * 1024).fill(7);
+const copy = new ivm.ExternalCopy(source.buffer, { copyOnWrite: true });
+source[0] = 0;
+const contexts = [ new ivm.Isolate({ memoryLimit: 8 }), new ivm.Isolate({ memoryLimit: 8 }) ].map(isolate => isolate.createContextSync());
+for (const context of contexts) {
+	context.global.setSync('data', copy.copyInto());
+}
+contexts[0].evalSync('new Uint8Array(data)[0] = 1');
+assert.strictEqual(contexts[0].evalSync('new Uint8Array(data)[0]'), 1);
+assert.strictEqual(contexts[1].evalSync('new Uint8Array(data)[0]'), 7);
+assert.strictEqual(contexts[1].evalSync('new Uint8Array(data).reduce((sum, value) => sum + value, 0)'), 7 * 4 * 1024 * 1024);
+assert.strictEqual(new Uint8Array(copy.copy())[0], 7);
+
+// Views are writable, so each one is charged in full
+const limited = new ivm.Isolate({ memoryLimit: 8 }).createContextSync();
+assert.throws(() => {
+	for (let ii = 0; ii < 4; ++ii) {
+		limited.global.setSync(`data${ii}`, copy.copyInto());
+	}
+}, /allocation failed|memory limit/);
+
+assert.strictEqual(new ivm.ExternalCopy(new ArrayBuffer(0), { copyOnWrite: true }).copy().byteLength, 0);
+assert.throws(() => new ivm.ExternalCopy('string', { copyOnWrite: true }), /requires an ArrayBuffer/);
+console.log('pass');
@@ -0,0 +1,72 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'ivm-'));
+try {
+	// Snapshots round trip through a file
+	const snapshotFile = path.join(dir, 'snapshot.bin');
+	ivm.Isolate.createSnapshot([ { code: 'function hello() { return "hello"; }' } ]).writeFile(snapshotFile);
+	const snapshot = ivm.ExternalCopy.fromFile(snapshotFile);
+	for (let ii = 0; ii < 2; ++ii) {
+		const isolate = new ivm.Isolate({ snapshot });
+		assert.strictEqual(isolate.createContextSync().evalSync('hello()'), 'hello');
+		isolate.dispose();
+	}
+
+	// So does code cache
+	const cacheFile = path.join(dir, 'cache.bin');
+	const code = 'function add(a, b) { return a + b; } add(1, 2)';
+	new ivm.Isolate().compileScriptSync(code, { produceCachedData: true }).cachedData.writeFile(cacheFile);
+	const script = new ivm.Isolate().compileScriptSync(code, { cachedData: ivm.ExternalCopy.fromFile(cacheFile) });
+	assert.strictEqual(script.cachedDataRejected, false);
+
+	// Mapped copies are private, so writing to a transferred buffer leaves the file alone
+	const dataFile = path.join(dir, 'data.bin');
+	fs.writeFileSync(dataFile, Buffer.from([ 1, 2, 3 ]));
+	const copy = ivm.ExternalCopy.fromFile(dataFile);
+	const buffer = new Uint8Array(copy.copy({ transferIn: true }));
+	buffer[0] = 9;
+	assert.deepStrictEqual([ ...fs.readFileSync(dataFile) ], [ 1, 2, 3 ]);
+	fs.writeFileSync(path.join(dir, 'empty.bin'), '');
+	assert.strictEqual(ivm.ExternalCopy.fromFile(path.join(dir, 'empty.bin')).copy().byteLength, 0);
+
+	// With `mmap` each isolate gets its own copy-on-write mapping of the file
+	const largeFile = path.join(dir, 'large.bin');
+	fs.writeFileSync(largeFile, Buffer.alloc(4 * 1024 * 1024, 7));
+	const mapped = ivm.ExternalCopy.fromFile(largeFile, { mmap: true });
+	const contexts = [ new ivm.Isolate, new ivm.Isolate ].map(isolate => isolate.createContextSync());
+	for (const context of contexts) {
+		context.global.setSync('data', mapped.copyInto());
+	}
+	contexts[0].evalSync('new Uint8Array(data)[0] = 1');
+	assert.strictEqual(contexts[0].evalSync('new Uint8Array(data)[0]'), 1);
+	assert.strictEqual(contexts[1].evalSync('new Uint8Array(data).reduce((sum, value) => sum + value, 0)'), 7 * 4 * 1024 * 1024);
+	assert.strictEqual(fs.readFileSync(largeFile)[0], 7);
+	assert.strictEqual(mapped.copy().byteLength, 4 * 1024 * 1024);
+
+	// Mapped copies are writable, so they're charged their full length even before they're touched
+	const hugeFile = path.join(dir, 'huge.bin');
+	fs.closeSync(fs.openSync(hugeFile, 'w'));
+	fs.truncateSync(hugeFile, 64 * 1024 * 1024);
+	const huge = ivm.ExternalCopy.fromFile(hugeFile, { mmap: true });
+	const limited = new ivm.Isolate({ memoryLimit: 16 }).createContextSync();
+	assert.throws(() => limited.global.setSync('data', huge.copyInto()), /allocation failed/);
+
+	// Writing over a mapped file replaces it instead of truncating the pages under the mapping
+	const replaced = ivm.ExternalCopy.fromFile(dataFile, { mmap: true });
+	new ivm.ExternalCopy(new Uint8Array([ 4, 5 ]).buffer).writeFile(dataFile);
+	assert.deepStrictEqual([ ...new Uint8Array(replaced.copy()) ], [ 1, 2, 3 ]);
+	assert.deepStrictEqual([ ...fs.readFileSync(dataFile) ], [ 4, 5 ]);
+	assert.deepStrictEqual(fs.readdirSync(dir).filter(name => name.endsWith('.tmp')), []);
+	assert.throws(() => snapshot.writeFile(path.join(dir, 'missing', 'snapshot.bin')), /Failed to write/);
+
+	assert.throws(() => ivm.ExternalCopy.fromFile(path.join(dir, 'missing.bin')), /Failed to read/);
+	assert.throws(() => new ivm.ExternalCopy('string').writeFile(dataFile), /Only copies of an ArrayBuffer/);
+	console.log('pass');
+} finally {
+	fs.rmSync(dir, { recursive: true, force: true });
+}
@@ -0,0 +1,59 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate({ memoryLimit: 32 });
+const context = isolate.createContextSync();
+const { port1, port2 } = new ivm.MessageChannel();
+assert(port1 instanceof ivm.MessagePort);
+assert.strictEqual(port1.onmessage, null);
+
+// Sandbox echoes messages back, batched or not
+context.global.setSync('port', port2);
+context.evalSync(`
+	let count = 0;
+	port.onmessage = event => {
+		++count;
+		port.postMessage({ echo: event.data, count });
+	};
+`);
+assert.strictEqual(context.evalSync('typeof port.onmessage'), 'function');
+
+// Messages posted before `onmessage` is set are queued
+const received = [];
+for (let ii = 0; ii < 100; ++ii) {
+	port1.postMessage(ii);
+}
+port1.postMessage(new ivm.Reference({ hello: 'world' }));
+port1.onmessage = event => {
+	received.push(event.data);
+	if (received.length === 101) {
+		assert.deepStrictEqual(received.slice(0, 100).map(message => message.echo), Array.from({ length: 100 }, (_, ii) => ii));
+		assert.deepStrictEqual(received.slice(0, 100).map(message => message.count), Array.from({ length: 100 }, (_, ii) => ii + 1));
+		assert.strictEqual(received[100].count, 101);
+		assert.strictEqual(received[100].echo.typeof, 'object');
+
+		// Messages after close are dropped
+		port1.close();
+		port1.postMessage('dropped');
+		assert.strictEqual(port1.onmessage, null);
+		setTimeout(() => {
+			assert.strictEqual(context.evalSync('count'), 101);
+			checkCopyInError();
+		}, 10);
+	}
+};
+
+// Messages which can't be copied into nodejs are reported as uncaught exceptions
+function checkCopyInError() {
+	const { port1, port2 } = new ivm.MessageChannel();
+	context.global.setSync('errorPort', port2);
+	port1.onmessage = () => assert.fail('message should not be delivered');
+	process.once('uncaughtException', error => {
+		assert.ok(/Cannot dereference/.test(error.message));
+		port1.close();
+		console.log('pass');
+	});
+	context.global.setSync('guestObject', context.evalSync('({})', { reference: true }));
+	context.evalSync('errorPort.postMessage(guestObject.derefInto())');
+}
@@ -0,0 +1,67 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const compile = (filename, code) => isolate.compileModuleSync(code, { filename });
+
+const registry = new ivm.ModuleRegistry({
+	imports: {
+		'math': 'file:///lib/math.js',
+		'lib/': 'file:///lib/',
+	},
+});
+registry.set('file:///lib/math.js', compile('file:///lib/math.js', 'export const add = (a, b) => a + b;'));
+registry.set('file:///lib/two.js', compile('file:///lib/two.js', 'export default 2;'));
+registry.set('file:///app/dep.js', compile('file:///app/dep.js', 'export { default as two } from "lib/two.js";'));
+registry.set('file:///app/lazy.js', compile('file:///app/lazy.js', 'await 0; export const lazy = "lazy";'));
+const main = compile('file:///app/main.js', `
+	import { add } from 'math';
+	import { two } from './sub/../dep.js';
+	export const value = add(two, 1);
+	export const lazy = import('./lazy.js').then(ns => ns.lazy);
+	export const missing = import('./missing.js').catch(err => err.message);
+`);
+registry.set('file:///app/main.js', main);
+
+// Static imports are resolved without a callback
+main.instantiateSync(context, registry);
+main.evaluateSync();
+assert.strictEqual(main.namespace.getSync('value'), 3);
+
+(async function() {
+	// Dynamic `import()` from modules and scripts
+	context.global.setSync('ns', main.namespace.derefInto());
+	assert.strictEqual(await context.eval('ns.lazy', { promise: true }), 'lazy');
+	assert.ok(/Cannot find module/.test(await context.eval('ns.missing', { promise: true })));
+	assert.strictEqual(await context.eval('import("math").then(ns => ns.add(1, 1))', { promise: true }), 2);
+
+	// The imported module runs after `import()` returns
+	registry.set('file:///app/side.js', compile('file:///app/side.js', 'globalThis.log.push("module body");'));
+	assert.strictEqual(await context.eval(`
+		globalThis.log = [];
+		const promise = import("file:///app/side.js");
+		log.push("after import()");
+		promise.then(() => log.join(" | "));
+	`, { promise: true }), 'after import() | module body');
+
+	// Top-level await failures reject the import
+	registry.set('file:///app/throws.js', compile('file:///app/throws.js', 'await 0; throw new Error("tla failed");'));
+	await assert.rejects(context.eval('import("file:///app/throws.js")', { promise: true }), /tla failed/);
+
+	// A module registered under several names resolves relative imports against any of them
+	const alias = compile('file:///a/alias.js', 'export { default } from "./sibling.js";');
+	registry.set('file:///a/alias.js', alias);
+	registry.set('file:///b/alias.js', alias);
+	registry.set('file:///b/sibling.js', compile('file:///b/sibling.js', 'export default "sibling";'));
+	assert.strictEqual(await context.eval('import("file:///a/alias.js").then(ns => ns.default)', { promise: true }), 'sibling');
+
+	// Unresolvable static import
+	const broken = compile('file:///app/broken.js', 'import "./nothing.js";');
+	await assert.rejects(broken.instantiate(context, registry), /Cannot find module '.\/nothing.js'/);
+	assert.strictEqual(registry.delete('file:///lib/two.js'), true);
+	assert.strictEqual(registry.delete('file:///lib/two.js'), false);
+	assert.throws(() => main.instantiateSync(context, {}), TypeError);
+	console.log('pass');
+})().catch(console.error);
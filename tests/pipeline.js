@@ -0,0 +1,67 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+const global = context.global;
+
+(async function() {
+	// Later operations can use the results of earlier ones
+	const pipeline = isolate.pipeline();
+	pipeline.set(global, 'config', { scale: 2 }, { copy: true });
+	const scale = pipeline.eval(context, 'config.scale');
+	const fn = pipeline.eval(context, '(function(a, b) { return { sum: a + b, self: this.name } })');
+	const self = pipeline.eval(context, '({ name: "self" })');
+	const result = pipeline.apply(fn, self, [ scale, 40 ], { result: { copy: true } });
+	const object = pipeline.get(global, 'config');
+	pipeline.set(object, 'result', result);
+	pipeline.delete(global, 'config');
+	const results = await pipeline.run();
+	assert.strictEqual(results.length, 8);
+	assert.strictEqual(results[1], 2);
+	assert.strictEqual(typeof results[2], 'function');
+	assert.deepStrictEqual(results[4], { sum: 42, self: 'self' });
+	assert.ok(results[5] instanceof ivm.Reference);
+	assert.deepStrictEqual(results[5].copySync(), { scale: 2, result: { sum: 42, self: 'self' } });
+	assert.strictEqual(context.evalSync('typeof config'), 'undefined');
+
+	// Pipelines only run once
+	assert.throws(() => pipeline.eval(context, '1'), /already been run/);
+	await assert.rejects(pipeline.run(), /already been run/);
+
+	// Sync variant, and errors reject the whole pipeline
+	const sync = isolate.pipeline();
+	sync.eval(context, 'globalThis.count = 1');
+	sync.eval(context, 'throw new Error("stop")');
+	sync.eval(context, 'globalThis.count = 2');
+	assert.throws(() => sync.runSync(), /stop/);
+	assert.strictEqual(context.evalSync('count'), 1);
+
+	// Results can't be used outside of their pipeline
+	const first = isolate.pipeline();
+	const value = first.eval(context, '1');
+	const second = isolate.pipeline();
+	assert.throws(() => second.get(value, 'key'), /different pipeline/);
+	second.eval(context, '1');
+	second.apply(global.getSync('Number', { reference: true }), undefined, [ value ]);
+	assert.throws(() => second.runSync(), /same pipeline/);
+
+	// Property operations on a primitive target reject instead of crashing
+	for (const operation of [
+		p => p.get(p.eval(context, 'undefined'), 'x'),
+		p => p.set(p.eval(context, '1'), 'x', 1),
+		p => p.delete(p.eval(context, '"string"'), 'x'),
+	]) {
+		const primitive = isolate.pipeline();
+		operation(primitive);
+		await assert.rejects(primitive.run(), /not an object/);
+	}
+
+	// Targets must belong to the pipeline's isolate
+	const other = new ivm.Isolate;
+	assert.throws(() => other.pipeline().get(global, 'key'), /different isolate/);
+	assert.throws(() => other.pipeline().eval(context, '1'), /different isolate/);
+	other.dispose();
+	console.log('pass');
+})().catch(console.error);
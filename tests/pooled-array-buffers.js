@@ -0,0 +1,39 @@
+// node-args: --expose-gc
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate({ memoryLimit: 32, pooledArrayBuffers: true });
+const context = isolate.createContextSync();
+
+// Recycled blocks must come back zeroed, for every size class and the mmap path
+const dirty = isolate.compileScriptSync(`
+	const sizes = [ 0, 1, 65, 100, 1000, 4096, 65536, 70000, 2 * 1024 * 1024 ];
+	for (let ii = 0; ii < 200; ++ii) {
+		for (const size of sizes) {
+			const array = new Uint8Array(size);
+			if (array.some(value => value !== 0)) {
+				throw new Error('Dirty buffer of size ' + size);
+			}
+			array.fill(0xff);
+		}
+	}
+`);
+dirty.runSync(context);
+
+// Accounting still enforces the memory limit
+assert.throws(() => isolate.compileScriptSync('new ArrayBuffer(64 * 1024 * 1024)').runSync(context), RangeError);
+
+// And allocated memory is released when buffers are collected
+const before = isolate.getHeapStatisticsSync().externally_allocated_size;
+context.evalSync(`globalThis.keep = Array(100).fill().map(() => new ArrayBuffer(4000))`);
+assert.ok(isolate.getHeapStatisticsSync().externally_allocated_size >= before + 400000);
+context.evalSync(`delete globalThis.keep`);
+// v8 may sweep array buffers concurrently, so give it a few collections to catch up
+let released = false;
+for (let ii = 0; ii < 10 && !released; ++ii) {
+	context.evalSync('gc()');
+	released = isolate.getHeapStatisticsSync().externally_allocated_size < before + 400000;
+}
+assert.ok(released);
+console.log('pass');
@@ -0,0 +1,82 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	const isolate = new ivm.Isolate;
+	const context = await isolate.createContext();
+	const global = context.global;
+	await context.eval(`
+		function* range(start, end) {
+			for (let ii = start; ii < end; ++ii) {
+				yield { ii };
+			}
+		}
+		async function* delayed(count) {
+			for (let ii = 0; ii < count; ++ii) {
+				await null;
+				yield ii;
+			}
+		}
+		function* fails() {
+			yield 1;
+			throw new Error('generator failed');
+		}
+		var closed = false;
+		function* closes() {
+			try {
+				for (let ii = 0; ; ++ii) {
+					yield ii;
+				}
+			} finally {
+				closed = true;
+			}
+		}
+		function *infinite() {
+			while (true) {}
+			yield;
+		}
+	`);
+
+	// Sync generators, values are copied in batches
+	const range = await global.get('range', { reference: true });
+	const values = [];
+	for await (const value of range.applyIterator(undefined, [ 0, 25 ], { batchSize: 10 })) {
+		values.push(value.ii);
+	}
+	assert.deepStrictEqual(values, Array.from({ length: 25 }, (_, ii) => ii));
+
+	// Async generators
+	const delayed = await global.get('delayed', { reference: true });
+	const asyncValues = [];
+	for await (const value of delayed.applyIterator(undefined, [ 7 ], { batchSize: 3 })) {
+		asyncValues.push(value);
+	}
+	assert.deepStrictEqual(asyncValues, [ 0, 1, 2, 3, 4, 5, 6 ]);
+
+	// Any iterable works, empty results finish immediately
+	const identity = await context.eval('value => value', { reference: true });
+	const iterator = identity.applyIterator(undefined, [ new ivm.ExternalCopy([]).copyInto() ]);
+	assert.deepStrictEqual(await iterator.next(), { value: undefined, done: true });
+	await assert.rejects(identity.applyIterator(undefined, [ 1 ]).next(), /not iterable/);
+
+	// Errors surface from `next()` after the values before them
+	const failing = (await global.get('fails', { reference: true })).applyIterator();
+	assert.deepStrictEqual(await failing.next(), { value: 1, done: false });
+	await assert.rejects(failing.next(), /generator failed/);
+	assert.deepStrictEqual(await failing.next(), { value: undefined, done: true });
+
+	// Breaking out early calls `return()` on the guest generator
+	for await (const value of (await global.get('closes', { reference: true })).applyIterator(undefined, [], { batchSize: 2 })) {
+		if (value === 3) {
+			break;
+		}
+	}
+	assert.strictEqual(await global.get('closed'), true);
+
+	// Timeouts apply to each batch
+	await assert.rejects((await global.get('infinite', { reference: true })).applyIterator(undefined, [], { timeout: 20 }).next(), /timed out/);
+
+	assert.throws(() => range.applyIterator(undefined, [], { batchSize: 0 }), /batchSize/);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,60 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate;
+const context = isolate.createContextSync();
+context.evalSync(`
+	globalThis.api = {
+		db: {
+			open(name) {
+				return { name, query(sql) { return name + ': ' + sql; } };
+			},
+		},
+	};
+`);
+const api = context.global.getSync('api', { reference: true });
+
+(async function() {
+	// Each step is queued behind the one that produces its target, so the chain is one round trip
+	const db = api.getPending('db');
+	const connection = db.getPending('open').applyPending(db.derefInto(), [ 'main' ]);
+	const query = connection.getPending('query');
+	assert.strictEqual(await query.apply(connection.derefInto(), [ 'select 1' ]), 'main: select 1');
+	assert.strictEqual(await connection.get('name'), 'main');
+	assert.strictEqual(connection.typeof, 'object');
+	assert.strictEqual(query.typeof, 'function');
+
+	// Errors are thrown by whatever uses the result
+	const missing = api.getPending('missing').applyPending(undefined, []);
+	await assert.rejects(missing.get('anything'), /not a function/);
+	const thrown = context.global.getPending('eval').applyPending(undefined, [ 'throw new Error("nope")' ]);
+	await assert.rejects(thrown.copy(), /nope/);
+
+	// Sync access waits for the producer, however long it takes to run
+	context.evalIgnored('for (const end = Date.now() + 20; Date.now() < end;);');
+	const later = api.getPending('db');
+	assert.strictEqual(later.typeof, 'object');
+	assert.strictEqual(api.getPending('db').getPending('open').applySync(api.getPending('db').derefInto(), [ 'sync' ]).getSync('name'), 'sync');
+	const pipeline = isolate.pipeline();
+	const pipelineDb = api.getPending('db');
+	const pipelineConnection = pipeline.apply(pipeline.get(pipelineDb, 'open'), pipelineDb.derefInto(), [ 'pipeline' ]);
+	pipeline.get(pipelineConnection, 'name');
+	assert.strictEqual(pipeline.runSync()[2], 'pipeline');
+
+	// Inside the target isolate the producer can't run until the caller returns, so it throws
+	context.global.setSync('pending', api.getPending('db'));
+	context.global.setSync('db', api.getPending('db').derefInto());
+	assert.strictEqual(context.evalSync('typeof db.open'), 'function');
+	assert.strictEqual(context.evalSync('pending.typeof'), 'object');
+	assert.throws(() => context.evalSync('pending.getPending("open").typeof'), /still pending/);
+
+	// Producers which never run because the isolate was disposed reject
+	const doomed = new ivm.Isolate;
+	const doomedContext = doomed.createContextSync();
+	doomedContext.evalIgnored('for (;;);');
+	const orphan = doomedContext.global.getPending('Object');
+	doomed.dispose();
+	assert.throws(() => orphan.typeof, /disposed/);
+	console.log('pass');
+})().catch(console.error);
@@ -0,0 +1,49 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+const isolate = new ivm.Isolate({ memoryLimit: 16 });
+const context = isolate.createContextSync();
+const allocate = isolate.compileScriptSync(`
+	try {
+		globalThis.buffer = new ArrayBuffer(24 * 1024 * 1024);
+		true;
+	} catch (err) {
+		false;
+	}
+`);
+const allocateMore = isolate.compileScriptSync(`
+	try {
+		globalThis.more = new ArrayBuffer(48 * 1024 * 1024);
+		true;
+	} catch (err) {
+		false;
+	}
+`);
+
+// Too big for the initial limit
+assert.strictEqual(allocate.runSync(context), false);
+
+// Raise the limit and try again
+isolate.setMemoryLimit(64);
+assert.strictEqual(allocate.runSync(context), true);
+
+// The new limit is still enforced
+assert.strictEqual(allocateMore.runSync(context), false);
+assert.strictEqual(isolate.isDisposed, false);
+
+// Validated like the constructor option
+assert.throws(() => isolate.setMemoryLimit(4), /at least 8/);
+
+// Lowering the limit below what's retained disposes the isolate once it's applied
+isolate.setMemoryLimit(16);
+const timeout = Date.now() + 5000;
+(function poll() {
+	if (isolate.isDisposed) {
+		console.log('pass');
+	} else if (Date.now() > timeout) {
+		console.log('isolate was not disposed');
+	} else {
+		setTimeout(poll, 10);
+	}
+})();
@@ -0,0 +1,34 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	// Built on the thread pool while the event loop keeps running
+	const base = await ivm.Isolate.createSnapshotAsync([
+		{ code: 'function greet(name) { return `hello ${name}`; }' },
+		{ code: 'const shared = { version: 1 };' },
+	], 'greet("warmup")');
+	assert.ok(base instanceof ivm.ExternalCopy);
+
+	// Derived snapshots layer on top of the base without re-running it
+	const tenant = await ivm.Isolate.createSnapshotAsync([
+		{ code: 'function tenantGreet() { return greet("tenant") + shared.version; }' },
+	], undefined, { snapshot: base });
+	const derivedSync = ivm.Isolate.createSnapshot([ { code: 'var extra = greet("sync");' } ], undefined, { snapshot: tenant });
+
+	const check = async (snapshot, code, expected) => {
+		const isolate = new ivm.Isolate({ snapshot });
+		const context = await isolate.createContext();
+		assert.strictEqual(await context.eval(code), expected);
+		isolate.dispose();
+	};
+	await check(base, 'greet("base")', 'hello base');
+	await check(tenant, 'tenantGreet()', 'hello tenant1');
+	await check(derivedSync, 'extra + tenantGreet()', 'hello synchello tenant1');
+
+	// Errors reject with the annotated error
+	await assert.rejects(ivm.Isolate.createSnapshotAsync([ { code: '**', filename: 'broken.js' } ]), /SyntaxError.*broken\.js:1/s);
+	await assert.rejects(ivm.Isolate.createSnapshotAsync([ { code: 'throw new Error("nope")' } ]), /nope/);
+	await assert.rejects(ivm.Isolate.createSnapshotAsync([], undefined, { snapshot: {} }), /must be an ExternalCopy/);
+	console.log('pass');
+})().catch(console.error);
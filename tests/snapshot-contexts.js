@@ -0,0 +1,52 @@
+'use strict';
+const ivm = require('isolated-vm');
+const assert = require('assert');
+
+(async function() {
+	// Each named context runs its own prelude when the snapshot is built
+	const snapshot = await ivm.Isolate.createSnapshotAsync([
+		{ code: 'var flavour = "default";' },
+	], undefined, {
+		contexts: {
+			flavourA: [ { code: 'var flavour = "a"; function hello() { return `hello ${flavour}`; }' } ],
+			flavourB: [ { code: 'var flavour = "b";' }, { code: 'var counter = 0;' } ],
+		},
+	});
+
+	const isolate = new ivm.Isolate({ snapshot });
+	const plain = await isolate.createContext();
+	const contextA = await isolate.createContext({ snapshot: 'flavourA' });
+	const contextB = isolate.createContextSync({ snapshot: 'flavourB' });
+	assert.strictEqual(await plain.eval('flavour'), 'default');
+	assert.strictEqual(await contextA.eval('hello()'), 'hello a');
+	assert.strictEqual(await contextB.eval('typeof hello'), 'undefined');
+
+	// Contexts from the same snapshot entry don't share state
+	const otherB = await isolate.createContext({ snapshot: 'flavourB' });
+	assert.strictEqual(await contextB.eval('++counter'), 1);
+	assert.strictEqual(await otherB.eval('counter'), 0);
+
+	await assert.rejects(isolate.createContext({ snapshot: 'missing' }), /named `missing`/);
+	assert.throws(() => new ivm.Isolate().createContextSync({ snapshot: 'flavourA' }), /named `flavourA`/);
+
+	// Derived snapshots only contain their own named contexts
+	const derived = ivm.Isolate.createSnapshot([], undefined, { snapshot });
+	const derivedIsolate = new ivm.Isolate({ snapshot: derived });
+	assert.throws(() => derivedIsolate.createContextSync({ snapshot: 'flavourA' }), /named `flavourA`/);
+	assert.strictEqual(await (await derivedIsolate.createContext()).eval('flavour'), 'default');
+	assert.throws(() => ivm.Isolate.createSnapshot([], undefined, {
+		snapshot,
+		contexts: { flavourC: [ { code: 'var flavour = "c";' } ] },
+	}), /can't be combined/);
+	await assert.rejects(ivm.Isolate.createSnapshotAsync([], undefined, {
+		snapshot,
+		contexts: { flavourC: [] },
+	}), /can't be combined/);
+
+	// Errors in a named context's prelude fail the whole snapshot
+	await assert.rejects(ivm.Isolate.createSnapshotAsync([], undefined, {
+		contexts: { broken: [ { code: 'throw new Error("nope")' } ] },
+	}), /nope/);
+	assert.throws(() => ivm.Isolate.createSnapshot([], undefined, { contexts: { broken: {} } }), /script arrays/);
+	console.log('pass');
+})().catch(console.error);